@@ -48,6 +48,11 @@
 #include <string.h>
 #include <sys/prctl.h>
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <libintl.h>
 #define _(str) gettext(str) ///< gettext shortcut
 #define _N(str) str         ///< gettext_noop shortcut
@@ -63,6 +68,7 @@
 #include "iatomic.h" // portable atomic_t
 
 #include "audio.h"
+#include "audiodsp.h"
 #include "misc.h"
 #include "ringbuffer.h"
 
@@ -115,8 +121,17 @@ static int AudioSkip;                      ///< skip audio to sync to video
 
 static const int AudioBytesProSample = 2; ///< number of bytes per sample
 
+#define AUDIO_RENDER_SIZE (16 * 1024) ///< bytes of software volume render buffer
+
+static int16_t *AudioScratch;   ///< channel conversion buffer
+static size_t AudioScratchSize; ///< size of channel conversion buffer
+
 static int AudioBufferTime = 336; ///< audio buffer time in ms
 
+static char AudioAdaptiveBuffer;                    ///< flag adaptive buffer time
+static int AudioSource;                             ///< current audio source
+static int AudioSourceBufferTime[AUDIO_SOURCE_MAX]; ///< learned buffer time in ms
+
 #ifdef USE_AUDIO_THREAD
 static pthread_t AudioThread;         ///< audio play thread
 static pthread_mutex_t AudioMutex;    ///< audio condition mutex
@@ -125,6 +140,7 @@ static char AudioThreadStop;          ///< stop audio thread
 #else
 static const int AudioThread; ///< dummy audio thread
 #endif
+static int AudioWakeupFd = -1; ///< eventfd, signaled on new samples or command
 
 static char AudioSoftVolume;              ///< flag use soft volume
 static char AudioNormalize;               ///< flag use volume normalize
@@ -170,7 +186,8 @@ static const unsigned AudioRatesTable[AudioRatesMax] = {44100, 48000, 192000};
 //  filter
 //----------------------------------------------------------------------------
 
-static const int AudioNormSamples = 4096; ///< number of samples
+#define AudioNormShift 12                                  ///< log2 of number of samples
+static const int AudioNormSamples = 1 << AudioNormShift; ///< number of samples
 
 #define AudioNormMaxIndex 128 ///< number of average values
 /// average of n last sample blocks
@@ -202,12 +219,7 @@ static void AudioNormalizer(int16_t *samples, int count) {
             n = AudioNormSamples - AudioNormCounter;
         }
         avg = AudioNormAverage[AudioNormIndex];
-        for (i = 0; i < n; ++i) {
-            int t;
-
-            t = data[i];
-            avg += (t * t) / AudioNormSamples;
-        }
+        avg += AudioDspUsed->Power(data, n, AudioNormShift);
         AudioNormAverage[AudioNormIndex] = avg;
         AudioNormCounter += n;
         if (AudioNormCounter >= AudioNormSamples) {
@@ -246,17 +258,7 @@ static void AudioNormalizer(int16_t *samples, int count) {
     } while (l > 0);
 
     // apply normalize factor
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-        int t;
-
-        t = (samples[i] * AudioNormalizeFactor) / 1000;
-        if (t < INT16_MIN) {
-            t = INT16_MIN;
-        } else if (t > INT16_MAX) {
-            t = INT16_MAX;
-        }
-        samples[i] = t;
-    }
+    AudioDspUsed->Scale(samples, count / AudioBytesProSample, AudioNormalizeFactor);
 }
 
 /**
@@ -281,19 +283,10 @@ static void AudioResetNormalizer(void) {
 */
 static void AudioCompressor(int16_t *samples, int count) {
     int max_sample;
-    int i;
     int factor;
 
     // find loudest sample
-    max_sample = 0;
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-        int t;
-
-        t = abs(samples[i]);
-        if (t > max_sample) {
-            max_sample = t;
-        }
-    }
+    max_sample = AudioDspUsed->Peak(samples, count / AudioBytesProSample);
 
     // calculate compression factor
     if (max_sample > 0) {
@@ -314,17 +307,7 @@ static void AudioCompressor(int16_t *samples, int count) {
           AudioCompressionFactor / 1000.0);
 
     // apply compression factor
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-        int t;
-
-        t = (samples[i] * AudioCompressionFactor) / 1000;
-        if (t < INT16_MIN) {
-            t = INT16_MIN;
-        } else if (t > INT16_MAX) {
-            t = INT16_MAX;
-        }
-        samples[i] = t;
-    }
+    AudioDspUsed->Scale(samples, count / AudioBytesProSample, AudioCompressionFactor);
 }
 
 /**
@@ -340,31 +323,39 @@ static void AudioResetCompressor(void) {
 /**
 **	Audio software amplifier.
 **
-**	@param samples	sample buffer
+**	Samples already in the ring buffer are read only, the amplified
+**	samples are placed in a small render buffer just before they are
+**	written to the device.  Samples the device doesn't take, are
+**	rendered again from the ring buffer with the next call.
+**
+**	@param samples	samples from ring buffer
 **	@param count	number of bytes in sample buffer
+**	@param frame_size	number of bytes of one frame
+**
+**	@returns amplified samples, @a count is reduced to the full frames
+**	fitting into the render buffer.
 **
 **	@todo FIXME: this does hard clipping
 */
-static void AudioSoftAmplifier(int16_t *samples, int count) {
-    int i;
+static const int16_t *AudioSoftAmplifier(const void *samples, int *count, int frame_size) {
+    static int16_t render[AUDIO_RENDER_SIZE / sizeof(int16_t)];
+    int n;
+
+    n = *count;
+    if (n > (int)sizeof(render)) {
+        n = sizeof(render) - sizeof(render) % frame_size;
+    }
+    *count = n;
 
     // silence
     if (AudioMute || !AudioAmplifier) {
-        memset(samples, 0, count);
-        return;
+        memset(render, 0, n);
+        return render;
     }
 
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-        int t;
-
-        t = (samples[i] * AudioAmplifier) / 1000;
-        if (t < INT16_MIN) {
-            t = INT16_MIN;
-        } else if (t > INT16_MAX) {
-            t = INT16_MAX;
-        }
-        samples[i] = t;
-    }
+    memcpy(render, samples, n);
+    AudioDspUsed->Scale(render, n / AudioBytesProSample, AudioAmplifier);
+    return render;
 }
 
 #ifdef USE_AUDIO_MIXER
@@ -403,109 +394,6 @@ static void AudioStereo2Mono(const int16_t *in, int frames, int16_t *out) {
     }
 }
 
-/**
-**	Downmix surround to stereo.
-**
-**	ffmpeg L  R  C	Ls Rs		-> alsa L R  Ls Rs C
-**	ffmpeg L  R  C	LFE Ls Rs	-> alsa L R  Ls Rs C  LFE
-**	ffmpeg L  R  C	LFE Ls Rs Rl Rr	-> alsa L R  Ls Rs C  LFE Rl Rr
-**
-**	@param in	input sample buffer
-**	@param in_chan	nr. of input channels
-**	@param frames	number of frames in sample buffer
-**	@param out	output sample buffer
-*/
-static void AudioSurround2Stereo(const int16_t *in, int in_chan, int frames, int16_t *out) {
-    while (frames--) {
-        int l;
-        int r;
-
-        switch (in_chan) {
-            case 3:               // stereo or surround? =>stereo
-                l = in[0] * 600;  // L
-                r = in[1] * 600;  // R
-                l += in[2] * 400; // C
-                r += in[2] * 400;
-                break;
-            case 4:               // quad or surround? =>quad
-                l = in[0] * 600;  // L
-                r = in[1] * 600;  // R
-                l += in[2] * 400; // Ls
-                r += in[3] * 400; // Rs
-                break;
-            case 5:               // 5.0
-                l = in[0] * 500;  // L
-                r = in[1] * 500;  // R
-                l += in[2] * 200; // Ls
-                r += in[3] * 200; // Rs
-                l += in[4] * 300; // C
-                r += in[4] * 300;
-                break;
-            case 6:               // 5.1
-                l = in[0] * 400;  // L
-                r = in[1] * 400;  // R
-                l += in[2] * 200; // Ls
-                r += in[3] * 200; // Rs
-                l += in[4] * 300; // C
-                r += in[4] * 300;
-                l += in[5] * 100; // LFE
-                r += in[5] * 100;
-                break;
-            case 7:               // 7.0
-                l = in[0] * 400;  // L
-                r = in[1] * 400;  // R
-                l += in[2] * 200; // Ls
-                r += in[3] * 200; // Rs
-                l += in[4] * 300; // C
-                r += in[4] * 300;
-                l += in[5] * 100; // RL
-                r += in[6] * 100; // RR
-                break;
-            case 8:               // 7.1
-                l = in[0] * 400;  // L
-                r = in[1] * 400;  // R
-                l += in[2] * 150; // Ls
-                r += in[3] * 150; // Rs
-                l += in[4] * 250; // C
-                r += in[4] * 250;
-                l += in[5] * 100; // LFE
-                r += in[5] * 100;
-                l += in[6] * 100; // RL
-                r += in[7] * 100; // RR
-                break;
-            default:
-                abort();
-        }
-        in += in_chan;
-
-        out[0] = l / 1000;
-        out[1] = r / 1000;
-        out += 2;
-    }
-}
-
-/**
-**	Upmix @a in_chan channels to @a out_chan.
-**
-**	@param in	input sample buffer
-**	@param in_chan	nr. of input channels
-**	@param frames	number of frames in sample buffer
-**	@param out	output sample buffer
-**	@param out_chan	nr. of output channels
-*/
-static void AudioUpmix(const int16_t *in, int in_chan, int frames, int16_t *out, int out_chan) {
-    while (frames--) {
-        int i;
-
-        for (i = 0; i < in_chan; ++i) { // copy existing channels
-            *out++ = *in++;
-        }
-        for (; i < out_chan; ++i) { // silents missing channels
-            *out++ = 0;
-        }
-    }
-}
-
 /**
 **	Resample ffmpeg sample format to hardware format.
 **
@@ -546,13 +434,13 @@ static void AudioResample(const int16_t *in, int in_chan, int frames, int16_t *o
         case 6 * 8 + 2:
         case 7 * 8 + 2:
         case 8 * 8 + 2:
-            AudioSurround2Stereo(in, in_chan, frames, out);
+            AudioDspUsed->Downmix(in, in_chan, frames, out);
             break;
         case 5 * 8 + 6:
         case 3 * 8 + 8:
         case 5 * 8 + 8:
         case 6 * 8 + 8:
-            AudioUpmix(in, in_chan, frames, out, out_chan);
+            AudioDspUsed->Upmix(in, in_chan, frames, out, out_chan);
             break;
 
         default:
@@ -569,30 +457,69 @@ static void AudioResample(const int16_t *in, int in_chan, int frames, int16_t *o
 //  ring buffer
 //----------------------------------------------------------------------------
 
-#define AUDIO_RING_MAX 8 ///< number of audio ring buffers
+#define AUDIO_RING_MAX 64 ///< number of audio ring records
 
 /**
-**	Audio ring buffer.
+**	Audio ring record.
+**
+**	A record is a format change or a flush.  It is valid for all
+**	samples written into the sample ring after its position, the
+**	samples between two records form one chunk of the same format.
 */
 typedef struct _audio_ring_ring_ {
-    char FlushBuffers;      ///< flag: flush buffers
-    char Passthrough;       ///< flag: use pass-through (AC-3, ...)
-    int16_t PacketSize;     ///< packet size
-    unsigned HwSampleRate;  ///< hardware sample rate in Hz
-    unsigned HwChannels;    ///< hardware number of channels
-    unsigned InSampleRate;  ///< input sample rate in Hz
-    unsigned InChannels;    ///< input number of channels
-    int64_t PTS;            ///< pts clock
-    RingBuffer *RingBuffer; ///< sample ring buffer
+    char FlushBuffers;     ///< flag: flush buffers
+    char Passthrough;      ///< flag: use pass-through (AC-3, ...)
+    int16_t PacketSize;    ///< packet size
+    unsigned HwSampleRate; ///< hardware sample rate in Hz
+    unsigned HwChannels;   ///< hardware number of channels
+    unsigned InSampleRate; ///< input sample rate in Hz
+    unsigned InChannels;   ///< input number of channels
+    int64_t PTS;           ///< pts clock
+    size_t Position;       ///< sample ring write position of record
 } AudioRingRing;
 
-/// ring of audio ring buffers
+/// ring of audio records, read = playing format, write = enqueue format
 static AudioRingRing AudioRing[AUDIO_RING_MAX];
 static int AudioRingWrite;           ///< audio ring write pointer
 static int AudioRingRead;            ///< audio ring read pointer
 static atomic_t AudioRingFilled;     ///< how many of the ring is used
+static atomic_t AudioRingFlush;      ///< flush records in the ring
 static unsigned AudioStartThreshold; ///< start play, if filled
 
+static RingBuffer *AudioSampleRing;        ///< samples of all records
+static size_t AudioSampleWritePos;         ///< bytes written to sample ring
+static volatile size_t AudioSampleReadPos; ///< bytes read from sample ring
+
+/**
+**	Wait for a free record in the audio ring.
+**
+**	The play thread removes records without samples between them at
+**	once, wake it up to make room.
+**
+**	@retval 0	record free
+**	@retval -1	timeout, play thread hangs
+*/
+static int AudioRingWaitFree(void) {
+    int i;
+
+    for (i = 0; atomic_read(&AudioRingFilled) >= AUDIO_RING_MAX - 1; ++i) {
+        if (i == 1000) {
+            return -1;
+        }
+#ifdef USE_AUDIO_THREAD
+        if (AudioThread && !AudioRunning) {
+            AudioRunning = 1;
+            pthread_cond_signal(&AudioStartCond);
+        }
+#endif
+        usleep(1 * 1000); // avoid hot polling
+    }
+    if (i) {
+        Debug(3, "audio: waited %dms for free ring record\n", i);
+    }
+    return 0;
+}
+
 /**
 **	Add sample-rate, number of channels change to ring.
 **
@@ -626,8 +553,7 @@ found:
         return -1; // unsupported nr. of channels
     }
 
-    if (atomic_read(&AudioRingFilled) == AUDIO_RING_MAX) { // no free slot
-        // FIXME: can wait for ring buffer empty
+    if (AudioRingWaitFree()) { // no free slot
         Error(_("audio: out of ring buffers\n"));
         return -1;
     }
@@ -641,7 +567,7 @@ found:
     AudioRing[AudioRingWrite].HwSampleRate = sample_rate;
     AudioRing[AudioRingWrite].HwChannels = AudioChannelMatrix[u][channels];
     AudioRing[AudioRingWrite].PTS = AV_NOPTS_VALUE;
-    RingBufferReset(AudioRing[AudioRingWrite].RingBuffer);
+    AudioRing[AudioRingWrite].Position = AudioSampleWritePos;
 
     Debug(3, "audio: %d ring buffer prepared\n", atomic_read(&AudioRingFilled) + 1);
 
@@ -660,16 +586,195 @@ found:
 }
 
 /**
-**	Setup audio ring.
+**	Write samples of the current write record into the sample ring.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+**
+**	@returns number of bytes written.
 */
-static void AudioRingInit(void) {
-    int i;
+static size_t AudioRingWriteSamples(const void *samples, size_t count) {
+    size_t n;
 
-    for (i = 0; i < AUDIO_RING_MAX; ++i) {
-        // ~2s 8ch 16bit
-        AudioRing[i].RingBuffer = RingBufferNew(AudioRingBufferSize);
+    n = RingBufferWrite(AudioSampleRing, samples, count);
+    AudioSampleWritePos += n;
+    return n;
+}
+
+/**
+**	Get the write region of the sample ring.
+**
+**	@param[out] wp	write pointer into the sample ring
+**
+**	@returns number of bytes, which can be written contiguous at wp.
+*/
+static size_t AudioRingWritePointer(void **wp) { return RingBufferGetWritePointer(AudioSampleRing, wp); }
+
+/**
+**	Commit samples of the current write record, placed at the write
+**	pointer of the sample ring.
+**
+**	@param count	number of bytes written
+**
+**	@returns number of bytes committed.
+*/
+static size_t AudioRingWriteAdvance(size_t count) {
+    size_t n;
+
+    n = RingBufferWriteAdvance(AudioSampleRing, count);
+    AudioSampleWritePos += n;
+    return n;
+}
+
+/**
+**	Get number of buffered bytes of the current write record.
+*/
+static size_t AudioRingWriteUsed(void) {
+    size_t used;
+    size_t n;
+
+    used = RingBufferUsedBytes(AudioSampleRing);
+    n = AudioSampleWritePos - AudioRing[AudioRingWrite].Position;
+    return n < used ? n : used;
+}
+
+/**
+**	Skip the oldest buffered bytes of the current write record.
+**
+**	Only allowed, while the play thread isn't running.  Nothing is
+**	skipped, while samples of older records are still buffered.
+**
+**	@param skip	number of bytes to skip
+**
+**	@returns number of bytes skipped.
+*/
+static size_t AudioRingWriteSkip(size_t skip) {
+    size_t used;
+
+    if ((ssize_t)(AudioSampleReadPos - AudioRing[AudioRingWrite].Position) < 0) {
+        return 0;
+    }
+    used = AudioRingWriteUsed();
+    if (skip > used) {
+        skip = used;
+    }
+    RingBufferReadAdvance(AudioSampleRing, skip);
+    AudioSampleReadPos += skip;
+    return skip;
+}
+
+/**
+**	Get number of buffered bytes of the current read record.
+*/
+static size_t AudioRingReadUsed(void) {
+    size_t used;
+
+    used = RingBufferUsedBytes(AudioSampleRing);
+    if (atomic_read(&AudioRingFilled)) {
+        size_t n;
+
+        // only until the next record
+        n = AudioRing[(AudioRingRead + 1) % AUDIO_RING_MAX].Position - AudioSampleReadPos;
+        if (n < used) {
+            used = n;
+        }
+    }
+    return used;
+}
+
+/**
+**	Get read pointer of the current read record.
+**
+**	@param[out] p	pointer to the samples
+**
+**	@returns number of bytes, which can be read.
+*/
+static size_t AudioRingGetReadPointer(const void **p) {
+    size_t n;
+    size_t used;
+
+    n = RingBufferGetReadPointer(AudioSampleRing, p);
+    used = AudioRingReadUsed();
+    return n < used ? n : used;
+}
+
+/**
+**	Advance read pointer of the current read record.
+**
+**	@param n	number of bytes played
+*/
+static void AudioRingReadAdvance(size_t n) {
+    RingBufferReadAdvance(AudioSampleRing, n);
+    AudioSampleReadPos += n;
+}
+
+/**
+**	Switch read side to the next record.
+**
+**	Following records without samples in between are removed too,
+**	only the last of them is used.
+**
+**	@returns true, if a flush record was passed.
+*/
+static int AudioRingNext(void) {
+    int flush;
+
+    flush = 0;
+    do {
+        AudioRingRead = (AudioRingRead + 1) % AUDIO_RING_MAX;
+        if (AudioRing[AudioRingRead].FlushBuffers) {
+            AudioRing[AudioRingRead].FlushBuffers = 0;
+            atomic_dec(&AudioRingFlush);
+            flush = 1;
+        }
+        atomic_dec(&AudioRingFilled);
+    } while (atomic_read(&AudioRingFilled) &&
+             (ssize_t)(AudioRing[(AudioRingRead + 1) % AUDIO_RING_MAX].Position - AudioSampleReadPos) <= 0);
+
+    return flush;
+}
+
+/**
+**	Drop all samples until the last flush record.
+**
+**	@retval 0	no flush record in the ring
+**	@retval 1	samples dropped, read side at the next record
+*/
+static int AudioRingDrop(void) {
+    int flush;
+    int filled;
+    int read;
+
+    // negative, if the flush record was passed before it was counted
+    if ((flush = atomic_read(&AudioRingFlush)) <= 0) {
+        return 0;
     }
+    // find the last flush record
+    filled = atomic_read(&AudioRingFilled);
+    read = AudioRingRead;
+    while (flush && filled--) {
+        read = (read + 1) % AUDIO_RING_MAX;
+        if (AudioRing[read].FlushBuffers) {
+            --flush;
+        }
+    }
+    Debug(3, "audio: flush %zd bytes\n", AudioRing[read].Position - AudioSampleReadPos);
+    AudioRingReadAdvance(AudioRing[read].Position - AudioSampleReadPos);
+
+    // all records until the flush record are without samples now
+    return AudioRingNext();
+}
+
+/**
+**	Setup audio ring.
+*/
+static void AudioRingInit(void) {
+    // ~2s 8ch 16bit
+    AudioSampleRing = RingBufferNew(AudioRingBufferSize);
+    AudioSampleWritePos = 0;
+    AudioSampleReadPos = 0;
     atomic_set(&AudioRingFilled, 0);
+    atomic_set(&AudioRingFlush, 0);
 }
 
 /**
@@ -678,18 +783,202 @@ static void AudioRingInit(void) {
 static void AudioRingExit(void) {
     int i;
 
+    if (AudioSampleRing) {
+        RingBufferDel(AudioSampleRing);
+        AudioSampleRing = NULL;
+    }
     for (i = 0; i < AUDIO_RING_MAX; ++i) {
-        if (AudioRing[i].RingBuffer) {
-            RingBufferDel(AudioRing[i].RingBuffer);
-            AudioRing[i].RingBuffer = NULL;
-        }
         AudioRing[i].HwSampleRate = 0; // checked for valid setup
         AudioRing[i].InSampleRate = 0;
+        AudioRing[i].FlushBuffers = 0;
     }
     AudioRingRead = 0;
     AudioRingWrite = 0;
 }
 
+//----------------------------------------------------------------------------
+//  jitter buffer
+//----------------------------------------------------------------------------
+
+#define AUDIO_JITTER_WINDOW 10000 ///< jitter measure window in ms
+#define AUDIO_JITTER_MARGIN 48    ///< ms added to peak jitter (2 periods)
+#define AUDIO_JITTER_MIN 96       ///< minimal adaptive buffer time in ms
+#define AUDIO_JITTER_MAX 1000     ///< maximal adaptive buffer time in ms
+
+static uint32_t AudioJitterWindow;       ///< start of measure window in ms
+static uint32_t AudioJitterTick;         ///< arrival time of media time 0 in ms
+static uint64_t AudioJitterMedia;        ///< media time of arrived samples in us
+static int AudioJitterPeak;              ///< latest arrival in window in ms
+static int AudioJitterHeadroom;          ///< lowest hw+sw buffer in window in ms
+static volatile char AudioJitterStarved; ///< thread ran out of samples
+static volatile char AudioJitterRestart; ///< restart measure with next samples
+
+/**
+**	Get buffer time of current audio source.
+**
+**	@returns buffer time in ms, learned one in adaptive mode.
+*/
+static int AudioGetBufferTime(void) {
+    if (AudioAdaptiveBuffer && AudioSourceBufferTime[AudioSource]) {
+        return AudioSourceBufferTime[AudioSource];
+    }
+    return AudioBufferTime;
+}
+
+/**
+**	Change learned buffer time of current audio source.
+**
+**	@param delay	new buffer time in ms
+*/
+static void AudioJitterSetBufferTime(int delay) {
+    if (delay < AUDIO_JITTER_MIN) {
+        delay = AUDIO_JITTER_MIN;
+    } else if (delay > AUDIO_JITTER_MAX) {
+        delay = AUDIO_JITTER_MAX;
+    }
+    if (delay != AudioSourceBufferTime[AudioSource]) {
+        Debug(3, "audio/jitter: source %d buffer time %dms -> %dms\n", AudioSource, AudioGetBufferTime(), delay);
+    }
+    AudioSourceBufferTime[AudioSource] = delay;
+}
+
+/**
+**	Restart the jitter measurement.
+**
+**	Called for a new stream, samples before it tell nothing about the
+**	arrival of the new samples.  The measure belongs to the thread
+**	enqueuing the samples, it is only flagged here and restarted with
+**	the next samples.
+*/
+static void AudioJitterReset(void) { AudioJitterRestart = 1; }
+
+/**
+**	Measure arrival jitter of enqueued samples.
+**
+**	The arrival time of every sample buffer is compared with its media
+**	time.  The earliest arrival is the reference, the peak lateness
+**	against it and the lowest buffered time reported by the output
+**	module are collected for a window.  At the end of the window the
+**	buffer time of the source grows at once to cover the peak, or
+**	shrinks slowly toward it.
+**
+**	@param count	number of bytes of enqueued samples
+*/
+static void AudioJitterArrival(int count) {
+    uint32_t tick;
+    int late;
+    int buffered;
+    int need;
+    int delay;
+
+    if (!count) { // wakeup only, no samples
+        return;
+    }
+    if (AudioJitterRestart) {
+        AudioJitterRestart = 0;
+        AudioJitterWindow = 0;
+        AudioJitterStarved = 0;
+    }
+    tick = GetMsTicks();
+    if (!AudioJitterWindow) { // start new window
+        AudioJitterWindow = tick;
+        AudioJitterTick = tick;
+        AudioJitterMedia = 0;
+        AudioJitterPeak = 0;
+        AudioJitterHeadroom = INT32_MAX;
+    }
+    if (AudioJitterStarved) { // samples arrived too late for the buffer
+        AudioJitterStarved = 0;
+        if (AudioAdaptiveBuffer) {
+            Debug(3, "audio/jitter: underrun, source %d\n", AudioSource);
+            AudioJitterSetBufferTime(AudioGetBufferTime() + AUDIO_JITTER_MARGIN);
+        }
+    }
+
+    late = (int32_t)(tick - AudioJitterTick) - (int)(AudioJitterMedia / 1000);
+    if (late < 0) { // earlier than all before, new reference
+        AudioJitterTick += late;
+        late = 0;
+    }
+    if (late > AudioJitterPeak) {
+        AudioJitterPeak = late;
+    }
+    AudioJitterMedia += ((uint64_t)count * 1000 * 1000) /
+                        (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                         AudioBytesProSample);
+
+    // hw (alsa) delay + ring buffer, zero while not running
+    if (AudioAdaptiveBuffer && (buffered = AudioGetDelay() / 90) && buffered < AudioJitterHeadroom) {
+        AudioJitterHeadroom = buffered;
+    }
+
+    if (tick - AudioJitterWindow < AUDIO_JITTER_WINDOW) {
+        return;
+    }
+    // end of window, clock drift doesn't sum up over windows
+    AudioJitterWindow = 0;
+    if (!AudioAdaptiveBuffer) {
+        return;
+    }
+    Debug(4, "audio/jitter: peak %dms headroom %dms\n", AudioJitterPeak,
+          AudioJitterHeadroom == INT32_MAX ? -1 : AudioJitterHeadroom);
+
+    need = AudioJitterPeak + AUDIO_JITTER_MARGIN;
+    if (AudioJitterHeadroom < AUDIO_JITTER_MARGIN) { // nearly run dry
+        need += AUDIO_JITTER_MARGIN - AudioJitterHeadroom;
+    }
+    delay = AudioGetBufferTime();
+    if (need > delay) {
+        AudioJitterSetBufferTime(need);
+    } else {
+        AudioJitterSetBufferTime(delay - (delay - need) / 4);
+    }
+}
+
+//----------------------------------------------------------------------------
+//  thread wakeup
+//----------------------------------------------------------------------------
+
+/**
+**	Wakeup audio thread waiting for the output device.
+**
+**	Called for new samples, flush, pause and play.
+*/
+static void AudioWakeup(void) {
+    static const uint64_t one = 1;
+
+    if (AudioWakeupFd >= 0 && write(AudioWakeupFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        Error(_("audio: can't wakeup play thread: %s\n"), strerror(errno));
+    }
+}
+
+/**
+**	Clear pending wakeups.
+*/
+static void AudioWakeupClear(void) {
+    uint64_t count;
+
+    if (AudioWakeupFd >= 0 && read(AudioWakeupFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        Error(_("audio: can't read wakeup: %s\n"), strerror(errno));
+    }
+}
+
+/**
+**	Wait for wakeup or timeout.
+**
+**	@param timeout	max. time to wait in ms
+*/
+static void AudioWakeupWait(int timeout) {
+    struct pollfd fds[1];
+
+    fds[0].fd = AudioWakeupFd; // negative fd only sleeps
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    if (poll(fds, 1, timeout) > 0) {
+        AudioWakeupClear();
+    }
+}
+
 //============================================================================
 //  A L S A
 //============================================================================
@@ -702,6 +991,12 @@ static snd_pcm_t *AlsaPCMHandle; ///< alsa pcm handle
 static char AlsaCanPause;        ///< hw supports pause
 static int AlsaUseMmap;          ///< use mmap
 
+static unsigned AlsaBufferTime = 96; ///< alsa buffer time in ms
+static unsigned AlsaPeriodTime;      ///< alsa period time in ms, 0 default
+static unsigned AlsaPeriodMs = 24;   ///< current period time in ms
+
+#define ALSA_POLL_MAX 8 ///< max. number of pcm poll descriptors
+
 static snd_mixer_t *AlsaMixer;          ///< alsa mixer handle
 static snd_mixer_elem_t *AlsaMixerElem; ///< alsa pcm mixer element
 static int AlsaRatio;                   ///< internal -> mixer ratio * 1000
@@ -759,14 +1054,14 @@ static int AlsaPlayRingbuffer(void) {
                             Error(_("audio/alsa: snd_pcm_start(): %s\n"), snd_strerror(err));
                         }
                     }
-                    usleep(5 * 1000);
+                    AudioWakeupWait(5);
                 }
             }
             Debug(4, "audio/alsa: break state '%s'\n", snd_pcm_state_name(snd_pcm_state(AlsaPCMHandle)));
             break;
         }
 
-        n = RingBufferGetReadPointer(AudioRing[AudioRingRead].RingBuffer, &p);
+        n = AudioRingGetReadPointer(&p);
         if (!n) {        // ring buffer empty
             if (first) { // only error on first loop
                 Debug(4, "audio/alsa: empty buffers %d\n", avail);
@@ -784,9 +1079,7 @@ static int AlsaPlayRingbuffer(void) {
         }
         // muting pass-through AC-3, can produce disturbance
         if (AudioMute || (AudioSoftVolume && !AudioRing[AudioRingRead].Passthrough)) {
-            // FIXME: quick&dirty cast
-            AudioSoftAmplifier((int16_t *)p, avail);
-            // FIXME: if not all are written, we double amplify them
+            p = AudioSoftAmplifier(p, &avail, snd_pcm_frames_to_bytes(AlsaPCMHandle, 1));
         }
         frames = snd_pcm_bytes_to_frames(AlsaPCMHandle, avail);
 #ifdef DEBUG
@@ -826,7 +1119,7 @@ static int AlsaPlayRingbuffer(void) {
             }
             break;
         }
-        RingBufferReadAdvance(AudioRing[AudioRingRead].RingBuffer, avail);
+        AudioRingReadAdvance(avail);
         first = 0;
     }
     return 0;
@@ -863,39 +1156,57 @@ static void AlsaFlushBuffers(void) {
 /**
 **	Alsa thread
 **
-**	Play some samples and return.
+**	Wait until a period of the kernel buffer is free or a command
+**	arrives, then play some samples and return.
 **
 **	@retval	-1	error
 **	@retval 0	underrun
 **	@retval	1	running
 */
 static int AlsaThread(void) {
+    struct pollfd fds[1 + ALSA_POLL_MAX];
+    unsigned short revents;
+    int n;
     int err;
 
     if (!AlsaPCMHandle) {
-        usleep(24 * 1000);
+        AudioWakeupWait(24);
         return -1;
     }
-    for (;;) {
-        if (AudioPaused) {
+    if (AudioPaused) {
+        return 1;
+    }
+    // wait for free period in kernel buffers or command
+    fds[0].fd = AudioWakeupFd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    if ((n = snd_pcm_poll_descriptors(AlsaPCMHandle, fds + 1, ALSA_POLL_MAX)) < 0) {
+        Error(_("audio/alsa: snd_pcm_poll_descriptors(): %s\n"), snd_strerror(n));
+        AudioWakeupWait(24);
+        return -1;
+    }
+    if ((err = poll(fds, 1 + n, AlsaBufferTime)) < 0) {
+        if (errno == EINTR) {
             return 1;
         }
-        // wait for space in kernel buffers
-        if ((err = snd_pcm_wait(AlsaPCMHandle, 24)) < 0) {
-            Warning(_("audio/alsa: wait underrun error? '%s'\n"), snd_strerror(err));
-            err = snd_pcm_recover(AlsaPCMHandle, err, 0);
-            if (err >= 0) {
-                continue;
-            }
-            Error(_("audio/alsa: snd_pcm_wait(): %s\n"), snd_strerror(err));
-            usleep(24 * 1000);
-            return -1;
-        }
-        break;
+        Error(_("audio/alsa: poll(): %s\n"), strerror(errno));
+        AudioWakeupWait(24);
+        return -1;
+    }
+    if (fds[0].revents & POLLIN) {
+        AudioWakeupClear();
     }
     if (!err || AudioPaused) { // timeout or some commands
         return 1;
     }
+    if ((err = snd_pcm_poll_descriptors_revents(AlsaPCMHandle, fds + 1, n, &revents)) < 0) {
+        Error(_("audio/alsa: snd_pcm_poll_descriptors_revents(): %s\n"), snd_strerror(err));
+        return -1;
+    }
+    // underrun errors are recovered by play ringbuffer
+    if (!(revents & (POLLOUT | POLLERR))) {
+        return 1;
+    }
 
     if ((err = AlsaPlayRingbuffer())) { // empty or error
         snd_pcm_state_t state;
@@ -910,7 +1221,7 @@ static int AlsaThread(void) {
             return 0;
         }
 
-        usleep(24 * 1000); // let fill/empty the buffers
+        AudioWakeupWait(AlsaPeriodMs); // wait for new samples
     }
     return 1;
 }
@@ -1113,6 +1424,79 @@ static int64_t AlsaGetDelay(void) {
     return pts;
 }
 
+/**
+**	Set alsa hardware and software parameters with explicit period.
+**
+**	Like snd_pcm_set_params(), but the period time isn't fixed to a
+**	quarter of the buffer time.
+**
+**	@param channels		number of channels
+**	@param freq		sample frequency
+**	@param buffer_time	buffer time in us
+**	@param period_time	period time in us
+**
+**	@returns 0 or negative alsa error code.
+*/
+static int AlsaSetParams(unsigned channels, unsigned freq, unsigned buffer_time, unsigned period_time) {
+    snd_pcm_hw_params_t *hw_params;
+    snd_pcm_sw_params_t *sw_params;
+    snd_pcm_uframes_t buffer_size;
+    snd_pcm_uframes_t period_size;
+    unsigned rate;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw_params);
+    if ((err = snd_pcm_hw_params_any(AlsaPCMHandle, hw_params)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params_set_rate_resample(AlsaPCMHandle, hw_params, 1)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params_set_access(AlsaPCMHandle, hw_params,
+                                            AlsaUseMmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED
+                                                        : SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params_set_format(AlsaPCMHandle, hw_params, SND_PCM_FORMAT_S16)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params_set_channels(AlsaPCMHandle, hw_params, channels)) < 0) {
+        return err;
+    }
+    rate = freq;
+    if ((err = snd_pcm_hw_params_set_rate_near(AlsaPCMHandle, hw_params, &rate, NULL)) < 0) {
+        return err;
+    }
+    if (rate != freq) {
+        return -EINVAL;
+    }
+    if ((err = snd_pcm_hw_params_set_buffer_time_near(AlsaPCMHandle, hw_params, &buffer_time, NULL)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params_set_period_time_near(AlsaPCMHandle, hw_params, &period_time, NULL)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_hw_params(AlsaPCMHandle, hw_params)) < 0) {
+        return err;
+    }
+    snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_size);
+    snd_pcm_hw_params_get_period_size(hw_params, &period_size, NULL);
+
+    // start with full buffer, wakeup for each free period
+    snd_pcm_sw_params_alloca(&sw_params);
+    if ((err = snd_pcm_sw_params_current(AlsaPCMHandle, sw_params)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_sw_params_set_start_threshold(AlsaPCMHandle, sw_params,
+                                                     (buffer_size / period_size) * period_size)) < 0) {
+        return err;
+    }
+    if ((err = snd_pcm_sw_params_set_avail_min(AlsaPCMHandle, sw_params, period_size)) < 0) {
+        return err;
+    }
+    return snd_pcm_sw_params(AlsaPCMHandle, sw_params);
+}
+
 /**
 **	Setup alsa audio for requested format.
 **
@@ -1156,9 +1540,15 @@ static int AlsaSetup(int *freq, int *channels, int passthrough) {
     }
 
     for (;;) {
-        if ((err = snd_pcm_set_params(AlsaPCMHandle, SND_PCM_FORMAT_S16,
-                                      AlsaUseMmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED,
-                                      *channels, *freq, 1, 96 * 1000))) {
+        if (AlsaPeriodTime) {
+            err = AlsaSetParams(*channels, *freq, AlsaBufferTime * 1000, AlsaPeriodTime * 1000);
+        } else {
+            // alsa uses 4 periods, avail_min is one period
+            err = snd_pcm_set_params(AlsaPCMHandle, SND_PCM_FORMAT_S16,
+                                     AlsaUseMmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED,
+                                     *channels, *freq, 1, AlsaBufferTime * 1000);
+        }
+        if (err) {
             // try reduced buffer size (needed for sunxi)
             // FIXME: alternativ make this configurable
             if ((err =
@@ -1217,9 +1607,13 @@ static int AlsaSetup(int *freq, int *channels, int passthrough) {
           snd_pcm_frames_to_bytes(AlsaPCMHandle, period_size) * 1000 / (*freq * *channels * AudioBytesProSample));
     Debug(3, "audio/alsa: state %s\n", snd_pcm_state_name(snd_pcm_state(AlsaPCMHandle)));
 
+    AlsaPeriodMs = (period_size * 1000) / *freq;
+    if (!AlsaPeriodMs) {
+        AlsaPeriodMs = 1;
+    }
     AudioStartThreshold = snd_pcm_frames_to_bytes(AlsaPCMHandle, period_size);
     // buffer time/delay in ms
-    delay = AudioBufferTime;
+    delay = AudioGetBufferTime();
     if (VideoAudioDelay > 0) {
         delay += VideoAudioDelay / 90;
     }
@@ -1413,12 +1807,12 @@ static int AudioNextRing(void) {
     AudioResetCompressor();
     AudioResetNormalizer();
 
+    used = AudioRingReadUsed();
     Debug(3, "audio: a/v next buf(%d,%4zdms)\n", atomic_read(&AudioRingFilled),
-          (RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer) * 1000) /
-              (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample));
+          (used * 1000) /
+              (AudioRing[AudioRingRead].HwSampleRate * AudioRing[AudioRingRead].HwChannels * AudioBytesProSample));
 
     // stop, if not enough in next buffer
-    used = RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer);
     if (AudioStartThreshold * 4 < used || (AudioVideoIsReady && AudioStartThreshold < used)) {
         return 0;
     }
@@ -1458,43 +1852,23 @@ static void *AudioPlayHandlerThread(void *dummy) {
             AudioUsedBytes());
 
         do {
-            int filled;
-            int read;
-            int flush;
             int err;
-            int i;
 
             // check if we should stop the thread
             if (AudioThreadStop) {
                 Debug(3, "audio: play thread stopped\n");
                 return PTHREAD_CANCELED;
             }
-            // look if there is a flush command in the queue
-            flush = 0;
-            filled = atomic_read(&AudioRingFilled);
-            read = AudioRingRead;
-            i = filled;
-            while (i--) {
-                read = (read + 1) % AUDIO_RING_MAX;
-                if (AudioRing[read].FlushBuffers) {
-                    AudioRing[read].FlushBuffers = 0;
-                    AudioRingRead = read;
-                    // handle all flush in queue
-                    flush = filled - i;
-                }
-            }
-
-            if (flush) {
-                Debug(3, "audio: flush %d ring buffer(s)\n", flush);
+            // flush commands are counted, no need to look into the queue
+            if (AudioRingDrop()) {
                 AudioUsedModule->FlushBuffers();
-                atomic_sub(flush, &AudioRingFilled);
                 if (AudioNextRing()) {
                     break;
                 }
             }
             // try to play some samples
             err = 0;
-            if (RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer)) {
+            if (AudioRingReadUsed()) {
                 err = AudioUsedModule->Thread();
             }
             // underrun, check if new ring buffer is available
@@ -1509,16 +1883,23 @@ static void *AudioPlayHandlerThread(void *dummy) {
                 // underrun, and no new ring buffer, goto sleep.
                 if (!atomic_read(&AudioRingFilled)) {
                     Debug(3, "audio: HandlerThread Underrun with no new data\n");
+                    AudioJitterStarved = 1;
                     break;
                 }
+                // samples of the current record not yet played
+                if (AudioRingReadUsed()) {
+                    continue;
+                }
 
                 Debug(3, "audio: next ring buffer\n");
                 old_passthrough = AudioRing[AudioRingRead].Passthrough;
                 old_sample_rate = AudioRing[AudioRingRead].HwSampleRate;
                 old_channels = AudioRing[AudioRingRead].HwChannels;
 
-                atomic_dec(&AudioRingFilled);
-                AudioRingRead = (AudioRingRead + 1) % AUDIO_RING_MAX;
+                if (AudioRingNext()) { // flush between both records
+                    AudioUsedModule->FlushBuffers();
+                    old_sample_rate = 0;
+                }
 
                 passthrough = AudioRing[AudioRingRead].Passthrough;
                 sample_rate = AudioRing[AudioRingRead].HwSampleRate;
@@ -1552,6 +1933,9 @@ static void *AudioPlayHandlerThread(void *dummy) {
 */
 static void AudioInitThread(void) {
     AudioThreadStop = 0;
+    if ((AudioWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        Error(_("audio: can't create wakeup eventfd: %s\n"), strerror(errno));
+    }
     pthread_mutex_init(&AudioMutex, NULL);
     pthread_cond_init(&AudioStartCond, NULL);
     pthread_create(&AudioThread, NULL, AudioPlayHandlerThread, NULL);
@@ -1570,6 +1954,7 @@ static void AudioExitThread(void) {
         AudioThreadStop = 1;
         AudioRunning = 1; // wakeup thread, if needed
         pthread_cond_signal(&AudioStartCond);
+        AudioWakeup();
         if (pthread_join(AudioThread, &retval) || retval != PTHREAD_CANCELED) {
             Error(_("audio: can't cancel play thread\n"));
         }
@@ -1577,6 +1962,10 @@ static void AudioExitThread(void) {
         pthread_mutex_destroy(&AudioMutex);
         AudioThread = 0;
     }
+    if (AudioWakeupFd >= 0) {
+        close(AudioWakeupFd);
+        AudioWakeupFd = -1;
+    }
 }
 
 #endif
@@ -1606,11 +1995,72 @@ void AudioDelayms(int delayms) {
 
     if (delayms < 5000 && delayms > 0) { // not more than 5seconds
         p = calloc(1, count);
-        RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, p, count);
+        AudioRingWriteSamples(p, count);
         free(p);
     }
 }
 
+/**
+**	Check if samples can be placed unmodified in the audio output queue.
+**
+**	@returns true, if no compression, normalize or channel conversion
+**	must be applied to the samples.
+*/
+static int AudioEnqueueUnmodified(void) {
+    return AudioRing[AudioRingWrite].Passthrough ||
+           (!AudioCompression && !AudioNormalize &&
+            AudioRing[AudioRingWrite].InChannels == AudioRing[AudioRingWrite].HwChannels);
+}
+
+/**
+**	Start play-back and update audio clock after samples are enqueued.
+**
+**	@param count	number of bytes enqueued
+*/
+static void AudioEnqueueDone(int count) {
+    size_t n;
+
+    if (AudioRunning) { // thread may wait for samples
+        AudioWakeup();
+    }
+
+    if (!AudioRunning) { // check, if we can start the thread
+        int skip;
+
+        n = AudioRingWriteUsed();
+        skip = AudioSkip;
+        // FIXME: round to packet size
+
+        Debug(4, "audio: start? %4zdms skip %dms\n",
+              (n * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                            AudioBytesProSample),
+              (skip * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                               AudioBytesProSample));
+
+        if (skip) {
+            AudioSkip -= AudioRingWriteSkip(skip);
+            n = AudioRingWriteUsed();
+        }
+        // forced start or enough video + audio buffered
+        // for some exotic channels * 4 too small
+        if (AudioStartThreshold * 4 < n || (AudioVideoIsReady
+                                            //  if ((AudioVideoIsReady
+                                            && AudioStartThreshold < n)) {
+            // restart play-back
+            // no lock needed, can wakeup next time
+            AudioRunning = 1;
+            pthread_cond_signal(&AudioStartCond);
+            Debug(3, "Start on AudioEnque Threshold %d n %d\n", AudioStartThreshold, n);
+        }
+    }
+    // Update audio clock (stupid gcc developers thinks INT64_C is unsigned)
+    if (AudioRing[AudioRingWrite].PTS != (int64_t)AV_NOPTS_VALUE) {
+        AudioRing[AudioRingWrite].PTS +=
+            ((int64_t)count * 90 * 1000) /
+            (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
+    }
+}
+
 /**
 **	Place samples in audio output queue.
 **
@@ -1643,15 +2093,23 @@ void AudioEnqueue(const void *samples, int count) {
     }
     // audio sample modification allowed and needed?
     buffer = (void *)samples;
-    if (!AudioRing[AudioRingWrite].Passthrough &&
-        (AudioCompression || AudioNormalize ||
-         AudioRing[AudioRingWrite].InChannels != AudioRing[AudioRingWrite].HwChannels)) {
+    if (!AudioEnqueueUnmodified()) {
         int frames;
+        size_t size;
 
         // resample into ring-buffer is too complex in the case of a roundabout
-        // just use a temporary buffer
+        // just use the scratch buffer
         frames = count / (AudioRing[AudioRingWrite].InChannels * AudioBytesProSample);
-        buffer = alloca(frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
+        size = frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
+        if (size > AudioScratchSize) {
+            if (!(buffer = realloc(AudioScratch, size))) {
+                Error(_("audio: out of memory\n"));
+                return;
+            }
+            AudioScratch = buffer;
+            AudioScratchSize = size;
+        }
+        buffer = AudioScratch;
 #ifdef USE_AUDIO_MIXER
         // Convert / resample input to hardware format
         AudioResample(samples, AudioRing[AudioRingWrite].InChannels, frames, buffer,
@@ -1665,7 +2123,7 @@ void AudioEnqueue(const void *samples, int count) {
 #endif
         memcpy(buffer, samples, count);
 #endif
-        count = frames * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
+        count = size;
 
         if (AudioCompression) { // in place operation
             AudioCompressor(buffer, count);
@@ -1675,7 +2133,8 @@ void AudioEnqueue(const void *samples, int count) {
         }
     }
 
-    n = RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, buffer, count);
+    AudioJitterArrival(count);
+    n = AudioRingWriteSamples(buffer, count);
     if (n != (size_t)count) {
         Error(_("audio: can't place %d samples in ring buffer\n"), count);
         // too many bytes are lost
@@ -1683,46 +2142,57 @@ void AudioEnqueue(const void *samples, int count) {
         // FIXME: should skip more, longer skip, but less often?
         // FIXME: round to channel + sample border
     }
+    AudioEnqueueDone(count);
+}
 
-    if (!AudioRunning) { // check, if we can start the thread
-        int skip;
-
-        n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
-        skip = AudioSkip;
-        // FIXME: round to packet size
+/**
+**	Get buffer to place samples directly in audio output queue.
+**
+**	Only possible, if the samples are enqueued unmodified.  The
+**	samples must be committed with AudioEnqueueCommit().
+**
+**	@param[out] count	number of bytes, which can be placed in buffer
+**
+**	@returns pointer into audio output queue, NULL if samples must be
+**	placed with AudioEnqueue().
+*/
+void *AudioEnqueueGetBuffer(int *count) {
+    void *p;
+    size_t n;
+    int frame_size;
 
-        Debug(4, "audio: start? %4zdms skip %dms\n",
-              (n * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-                            AudioBytesProSample),
-              (skip * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-                               AudioBytesProSample));
+    *count = 0;
+    if (!AudioRing[AudioRingWrite].HwSampleRate || !AudioEnqueueUnmodified()) {
+        return NULL;
+    }
+    frame_size = AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
+    n = AudioRingWritePointer(&p);
+    n -= n % frame_size; // only complete frames
+    if (!n) {
+        return NULL;
+    }
+    *count = n;
+    return p;
+}
 
-        if (skip) {
-            if (n < (unsigned)skip) {
-                skip = n;
-            }
-            AudioSkip -= skip;
-            RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
-            n = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
-        }
-        // forced start or enough video + audio buffered
-        // for some exotic channels * 4 too small
-        if (AudioStartThreshold * 4 < n || (AudioVideoIsReady
-                                            //  if ((AudioVideoIsReady
-                                            && AudioStartThreshold < n)) {
-            // restart play-back
-            // no lock needed, can wakeup next time
-            AudioRunning = 1;
-            pthread_cond_signal(&AudioStartCond);
-            Debug(3, "Start on AudioEnque Threshold %d n %d\n", AudioStartThreshold, n);
-        }
+/**
+**	Commit samples placed in buffer returned by AudioEnqueueGetBuffer().
+**
+**	@param count	number of bytes placed in buffer
+*/
+void AudioEnqueueCommit(int count) {
+    if (!AudioRing[AudioRingWrite].HwSampleRate || count <= 0) {
+        return;
     }
-    // Update audio clock (stupid gcc developers thinks INT64_C is unsigned)
-    if (AudioRing[AudioRingWrite].PTS != (int64_t)AV_NOPTS_VALUE) {
-        AudioRing[AudioRingWrite].PTS +=
-            ((int64_t)count * 90 * 1000) /
-            (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
+    // save packet size
+    if (!AudioRing[AudioRingWrite].PacketSize) {
+        AudioRing[AudioRingWrite].PacketSize = count;
+        Debug(3, "audio: a/v packet size %d bytes\n", count);
     }
+
+    AudioJitterArrival(count);
+    AudioRingWriteAdvance(count);
+    AudioEnqueueDone(count);
 }
 
 /**
@@ -1747,7 +2217,7 @@ void AudioVideoReady(int64_t pts) {
     }
     // Audio.PTS = next written sample time stamp
 
-    used = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
+    used = AudioRingWriteUsed();
     audio_pts = AudioRing[AudioRingWrite].PTS -
                 (used * 90 * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
                                       AudioBytesProSample);
@@ -1763,7 +2233,7 @@ void AudioVideoReady(int64_t pts) {
 
         // buffer ~15 video frames
         // FIXME: HDTV can use smaller video buffer
-        skip = pts - 0 * 20 * 90 - AudioBufferTime * 90 - audio_pts + VideoAudioDelay;
+        skip = pts - 0 * 20 * 90 - AudioGetBufferTime() * 90 - audio_pts + VideoAudioDelay;
 #ifdef DEBUG
         //	fprintf(stderr, "a/v-diff %dms a/v-delay %dms skip %dms	 Audiobuffer
         //%d\n", (int)(pts - audio_pts) / 90, VideoAudioDelay / 90, skip /
@@ -1774,17 +2244,14 @@ void AudioVideoReady(int64_t pts) {
             skip = (((int64_t)skip * AudioRing[AudioRingWrite].HwSampleRate) / (1000 * 90)) *
                    AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample;
             // FIXME: round to packet size
-            if ((unsigned)skip > used) {
-                AudioSkip = skip - used;
-                skip = used;
-            }
+            AudioSkip = skip - AudioRingWriteSkip(skip);
             Debug(3, "audio: sync advance %dms %d/%zd  Rest %d\n",
-                  (skip * 1000) / (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
-                                   AudioBytesProSample),
-                  skip, used, AudioSkip);
-            RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
+                  ((skip - AudioSkip) * 1000) /
+                      (AudioRing[AudioRingWrite].HwSampleRate * AudioRing[AudioRingWrite].HwChannels *
+                       AudioBytesProSample),
+                  skip - AudioSkip, used, AudioSkip);
 
-            used = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
+            used = AudioRingWriteUsed();
         } else {
             Debug(3, "No audio skip -> should skip %d\n", skip / 90);
         }
@@ -1807,38 +2274,31 @@ void AudioFlushBuffers(void) {
     int old;
     int i;
 
-    if (atomic_read(&AudioRingFilled) >= AUDIO_RING_MAX) {
-        // wait for space in ring buffer, should never happen
-        for (i = 0; i < 24 * 2; ++i) {
-            if (atomic_read(&AudioRingFilled) < AUDIO_RING_MAX) {
-                break;
-            }
-            Debug(3, "audio: flush out of ring buffers\n");
-            usleep(1 * 1000); // avoid hot polling
-        }
-        if (atomic_read(&AudioRingFilled) >= AUDIO_RING_MAX) {
-            // FIXME: We can set the flush flag in the last wrote ring buffer
-            Error(_("audio: flush out of ring buffers\n"));
-            return;
-        }
+    if (AudioRingWaitFree()) {
+        Error(_("audio: flush out of ring buffers\n"));
+        return;
     }
 
     old = AudioRingWrite;
     AudioRingWrite = (AudioRingWrite + 1) % AUDIO_RING_MAX;
     AudioRing[AudioRingWrite].FlushBuffers = 1;
     AudioRing[AudioRingWrite].Passthrough = AudioRing[old].Passthrough;
+    AudioRing[AudioRingWrite].PacketSize = AudioRing[old].PacketSize;
     AudioRing[AudioRingWrite].HwSampleRate = AudioRing[old].HwSampleRate;
     AudioRing[AudioRingWrite].HwChannels = AudioRing[old].HwChannels;
     AudioRing[AudioRingWrite].InSampleRate = AudioRing[old].InSampleRate;
     AudioRing[AudioRingWrite].InChannels = AudioRing[old].InChannels;
     AudioRing[AudioRingWrite].PTS = AV_NOPTS_VALUE;
-    RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer,
-                          RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer));
+    AudioRing[AudioRingWrite].Position = AudioSampleWritePos;
     Debug(3, "audio: reset video ready\n");
     AudioVideoIsReady = 0;
     AudioSkip = 0;
+    AudioJitterReset();
 
+    // record must be visible, before it is counted as flush
     atomic_inc(&AudioRingFilled);
+    atomic_inc(&AudioRingFlush);
+    AudioWakeup();
 
     // FIXME: wait for flush complete needed?
     for (i = 0; i < 24 * 2; ++i) {
@@ -1847,8 +2307,7 @@ void AudioFlushBuffers(void) {
             pthread_cond_signal(&AudioStartCond);
             Debug(3, "Start on Flush\n");
         }
-        // FIXME: waiting on zero isn't correct, but currently works
-        if (!atomic_read(&AudioRingFilled)) {
+        if (!atomic_read(&AudioRingFlush)) {
             break;
         }
         usleep(1 * 1000); // avoid hot polling
@@ -1867,16 +2326,27 @@ void AudioPoller(void) {
 **	Get free bytes in audio output.
 */
 int AudioFreeBytes(void) {
-    return AudioRing[AudioRingWrite].RingBuffer ? RingBufferFreeBytes(AudioRing[AudioRingWrite].RingBuffer)
-                                                : INT32_MAX;
+    return AudioSampleRing ? RingBufferFreeBytes(AudioSampleRing) : INT32_MAX;
 }
 
 /**
 **	Get used bytes in audio output.
 */
 int AudioUsedBytes(void) {
-    // FIXME: not correct, if multiple buffer are in use
-    return AudioRing[AudioRingWrite].RingBuffer ? RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer) : 0;
+    return AudioSampleRing ? RingBufferUsedBytes(AudioSampleRing) : 0;
+}
+
+/**
+**	Get cpu time used by the audio play thread.
+**
+**	@returns cpu time in ms, -1 if no thread is running.
+*/
+int64_t AudioGetCpuTime(void) {
+#ifdef USE_AUDIO_THREAD
+    return GetThreadCpuMs(AudioThread);
+#else
+    return -1;
+#endif
 }
 
 /**
@@ -1897,10 +2367,9 @@ int64_t AudioGetDelay(void) {
         return 0L; // multiple buffers, invalid delay
     }
     pts = AudioUsedModule->GetDelay();
-    pts += ((int64_t)RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer) * 90 * 1000) /
+    pts += ((int64_t)AudioRingReadUsed() * 90 * 1000) /
            (AudioRing[AudioRingRead].HwSampleRate * AudioRing[AudioRingRead].HwChannels * AudioBytesProSample);
-    Debug(4, "audio: hw+sw delay %zd %" PRId64 "ms\n", RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer),
-          pts / 90);
+    Debug(4, "audio: hw+sw delay %zd %" PRId64 "ms\n", AudioRingReadUsed(), pts / 90);
 
     return pts;
 }
@@ -1916,7 +2385,7 @@ void AudioSetClock(int64_t pts) {
               Timestamp2String(pts));
     }
     //  printf("Audiosetclock		   pts %#012" PRIx64 "
-    //  %d\n",pts,RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer));
+    //  %d\n",pts,AudioRingWriteUsed());
     AudioRing[AudioRingWrite].PTS = pts;
 }
 
@@ -1999,6 +2468,7 @@ void AudioPlay(void) {
     }
     Debug(3, "audio: resumed\n");
     AudioPaused = 0;
+    AudioJitterReset(); // the pause isn't arrival jitter
     AudioEnqueue(NULL, 0); // wakeup thread
 }
 
@@ -2012,6 +2482,8 @@ void AudioPause(void) {
     }
     Debug(3, "audio: paused\n");
     AudioPaused = 1;
+    AudioJitterReset();
+    AudioWakeup();
 }
 
 /**
@@ -2029,6 +2501,72 @@ void AudioSetBufferTime(int delay) {
     AudioBufferTime = delay;
 }
 
+/**
+**	Set alsa buffer and period time.
+**
+**	Smaller buffers lower the a/v latency, the play thread is woken
+**	for each free period.
+**
+**	@param times	"buffer[:period]" in ms, without period alsa uses a
+**			quarter of the buffer
+**
+**	@returns -1 for bad formated times, 0 for success.
+*/
+int AudioSetAlsaBuffer(const char *times) {
+    unsigned buffer;
+    unsigned period;
+
+    period = 0;
+    switch (sscanf(times, "%u:%u", &buffer, &period)) {
+        case 1:
+        case 2:
+            break;
+        default:
+            return -1;
+    }
+    if (buffer < 4 || buffer > 1000 || (period && (period < 1 || period > buffer / 2))) {
+        return -1;
+    }
+    AlsaBufferTime = buffer;
+    AlsaPeriodTime = period;
+    return 0;
+}
+
+/**
+**	Enable/disable adaptive buffer time.
+**
+**	The buffer time of each audio source is learned from the arrival
+**	jitter of its samples, AudioSetBufferTime() gives the start value.
+**
+**	@param onoff	-1 toggle, true turn on, false turn off
+*/
+void AudioSetAdaptiveBuffer(int onoff) {
+    if (onoff < 0) {
+        AudioAdaptiveBuffer ^= 1;
+    } else {
+        AudioAdaptiveBuffer = onoff;
+    }
+}
+
+/**
+**	Set audio source.
+**
+**	Each source has its own learned buffer time.
+**
+**	@param source	AUDIO_SOURCE_LIVE, AUDIO_SOURCE_NETWORK or
+**			AUDIO_SOURCE_REPLAY
+*/
+void AudioSetSource(int source) {
+    if (source < 0 || source >= AUDIO_SOURCE_MAX) {
+        source = AUDIO_SOURCE_LIVE;
+    }
+    if (source != AudioSource) {
+        Debug(3, "audio: source %d -> %d\n", AudioSource, source);
+        AudioSource = source;
+        AudioJitterReset();
+    }
+}
+
 /**
 **	Enable/disable software volume.
 **
@@ -2159,6 +2697,8 @@ void AudioInit(void) {
     int freq;
     int chan;
 
+    Info(_("audio: '%s' dsp kernels used\n"), AudioDspInit());
+
     name = "noop";
     name = "alsa";
     if (AudioModuleName) {
@@ -2353,6 +2893,9 @@ void AudioExit(void) {
     AudioUsedModule = &NoopModule;
     module->Exit();
     AudioRingExit();
+    free(AudioScratch);
+    AudioScratch = NULL;
+    AudioScratchSize = 0;
     AudioRunning = 0;
     AudioPaused = 0;
 }
@@ -23,16 +23,33 @@
 /// @addtogroup Audio
 /// @{
 
+//----------------------------------------------------------------------------
+//  Defines
+//----------------------------------------------------------------------------
+
+///
+/// Audio sources with own adaptive buffer time.
+///
+enum {
+    AUDIO_SOURCE_LIVE,    ///< live tv of a local tuner
+    AUDIO_SOURCE_NETWORK, ///< live tv over network (streamdev, iptv)
+    AUDIO_SOURCE_REPLAY,  ///< recording
+    AUDIO_SOURCE_MAX      ///< number of sources
+};
+
 //----------------------------------------------------------------------------
 //  Prototypes
 //----------------------------------------------------------------------------
 
 extern void AudioEnqueue(const void *, int); ///< buffer audio samples
+extern void *AudioEnqueueGetBuffer(int *);   ///< get buffer for audio samples
+extern void AudioEnqueueCommit(int);         ///< commit buffered audio samples
 extern void AudioFlushBuffers(void);         ///< flush audio buffers
 extern void AudioPoller(void);               ///< poll audio events/handling
 extern int AudioFreeBytes(void);             ///< free bytes in audio output
 extern int AudioUsedBytes(void);             ///< used bytes in audio output
 extern int64_t AudioGetDelay(void);          ///< get current audio delay
+extern int64_t AudioGetCpuTime(void);        ///< get audio thread cpu time
 extern void AudioSetClock(int64_t);          ///< set audio clock base
 extern int64_t AudioGetClock();              ///< get current audio clock
 extern void AudioSetVolume(int);             ///< set volume
@@ -42,6 +59,8 @@ extern void AudioPlay(void);  ///< play audio
 extern void AudioPause(void); ///< pause audio
 
 extern void AudioSetBufferTime(int);       ///< set audio buffer time
+extern void AudioSetAdaptiveBuffer(int);   ///< enable/disable adaptive buffer
+extern void AudioSetSource(int);           ///< set audio source
 extern void AudioSetSoftvol(int);          ///< enable/disable softvol
 extern void AudioSetNormalize(int, int);   ///< set normalize parameters
 extern void AudioSetCompression(int, int); ///< set compression parameters
@@ -49,6 +68,9 @@ extern void AudioSetStereoDescent(int);    ///< set stereo loudness descent
 
 extern void AudioSetDevice(const char *); ///< set PCM audio device
 
+/// set alsa buffer and period time
+extern int AudioSetAlsaBuffer(const char *);
+
 /// set pass-through device
 extern void AudioSetPassthroughDevice(const char *);
 extern void AudioSetChannel(const char *); ///< set mixer channel
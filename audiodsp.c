@@ -0,0 +1,1035 @@
+///
+/// @file audiodsp.c	@brief Audio DSP kernel module
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+/// @defgroup AudioDsp The audio DSP kernel module.
+///
+/// Sample loops of the audio filters and the channel mixer.
+///
+/// The plain C kernels are the reference, the SSE2, AVX2 and NEON
+/// kernels must give bit identical results.  The fastest kernel set
+/// supported by the cpu is selected at runtime by AudioDspInit().
+///
+/// A division by 1000 is done as multiplication with its reciprocal
+/// 0x10624DD3 / 2^38, which is exact for all 32 bit values.
+///
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_AUDIO_DSP_X86 ///< build SSE2 and AVX2 kernels
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#define USE_AUDIO_DSP_NEON ///< build NEON kernels
+#include <arm_neon.h>
+#endif
+
+#include "audiodsp.h"
+
+//----------------------------------------------------------------------------
+//  C
+//----------------------------------------------------------------------------
+
+/**
+**	Scale samples by factor / 1000 with clipping.
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor / 1000
+*/
+static void AudioDspScaleC(int16_t *samples, int n, int factor) {
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        int t;
+
+        t = (samples[i] * factor) / 1000;
+        if (t < INT16_MIN) {
+            t = INT16_MIN;
+        } else if (t > INT16_MAX) {
+            t = INT16_MAX;
+        }
+        samples[i] = t;
+    }
+}
+
+/**
+**	Sum of the squared samples.
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param shift	each square is shifted right by @a shift bits
+*/
+static uint32_t AudioDspPowerC(const int16_t *samples, int n, int shift) {
+    int i;
+    uint32_t sum;
+
+    sum = 0;
+    for (i = 0; i < n; ++i) {
+        int t;
+
+        t = samples[i];
+        sum += (t * t) >> shift;
+    }
+    return sum;
+}
+
+/**
+**	Find the loudest sample.
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**
+**	@returns absolute value of the loudest sample.
+*/
+static int AudioDspPeakC(const int16_t *samples, int n) {
+    int i;
+    int max_sample;
+
+    max_sample = 0;
+    for (i = 0; i < n; ++i) {
+        int t;
+
+        t = abs(samples[i]);
+        if (t > max_sample) {
+            max_sample = t;
+        }
+    }
+    return max_sample;
+}
+
+/**
+**	Downmix surround to stereo.
+**
+**	ffmpeg L  R  C	Ls Rs		-> alsa L R  Ls Rs C
+**	ffmpeg L  R  C	LFE Ls Rs	-> alsa L R  Ls Rs C  LFE
+**	ffmpeg L  R  C	LFE Ls Rs Rl Rr	-> alsa L R  Ls Rs C  LFE Rl Rr
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+*/
+static void AudioDspDownmixC(const int16_t *in, int in_chan, int frames, int16_t *out) {
+    while (frames-- > 0) {
+        int l;
+        int r;
+
+        switch (in_chan) {
+            case 3:               // stereo or surround? =>stereo
+                l = in[0] * 600;  // L
+                r = in[1] * 600;  // R
+                l += in[2] * 400; // C
+                r += in[2] * 400;
+                break;
+            case 4:               // quad or surround? =>quad
+                l = in[0] * 600;  // L
+                r = in[1] * 600;  // R
+                l += in[2] * 400; // Ls
+                r += in[3] * 400; // Rs
+                break;
+            case 5:               // 5.0
+                l = in[0] * 500;  // L
+                r = in[1] * 500;  // R
+                l += in[2] * 200; // Ls
+                r += in[3] * 200; // Rs
+                l += in[4] * 300; // C
+                r += in[4] * 300;
+                break;
+            case 6:               // 5.1
+                l = in[0] * 400;  // L
+                r = in[1] * 400;  // R
+                l += in[2] * 200; // Ls
+                r += in[3] * 200; // Rs
+                l += in[4] * 300; // C
+                r += in[4] * 300;
+                l += in[5] * 100; // LFE
+                r += in[5] * 100;
+                break;
+            case 7:               // 7.0
+                l = in[0] * 400;  // L
+                r = in[1] * 400;  // R
+                l += in[2] * 200; // Ls
+                r += in[3] * 200; // Rs
+                l += in[4] * 300; // C
+                r += in[4] * 300;
+                l += in[5] * 100; // RL
+                r += in[6] * 100; // RR
+                break;
+            case 8:               // 7.1
+                l = in[0] * 400;  // L
+                r = in[1] * 400;  // R
+                l += in[2] * 150; // Ls
+                r += in[3] * 150; // Rs
+                l += in[4] * 250; // C
+                r += in[4] * 250;
+                l += in[5] * 100; // LFE
+                r += in[5] * 100;
+                l += in[6] * 100; // RL
+                r += in[7] * 100; // RR
+                break;
+            default:
+                abort();
+        }
+        in += in_chan;
+
+        out[0] = l / 1000;
+        out[1] = r / 1000;
+        out += 2;
+    }
+}
+
+/**
+**	Upmix @a in_chan channels to @a out_chan.
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+**	@param out_chan	nr. of output channels
+*/
+static void AudioDspUpmixC(const int16_t *in, int in_chan, int frames, int16_t *out, int out_chan) {
+    while (frames-- > 0) {
+        int i;
+
+        for (i = 0; i < in_chan; ++i) { // copy existing channels
+            *out++ = *in++;
+        }
+        for (; i < out_chan; ++i) { // silents missing channels
+            *out++ = 0;
+        }
+    }
+}
+
+///
+///	Plain C audio dsp kernels.
+///
+static const AudioDsp AudioDspCKernels = {
+    .Name = "c",
+    .Scale = AudioDspScaleC,
+    .Power = AudioDspPowerC,
+    .Peak = AudioDspPeakC,
+    .Downmix = AudioDspDownmixC,
+    .Upmix = AudioDspUpmixC,
+};
+
+#if defined(USE_AUDIO_DSP_X86) || defined(USE_AUDIO_DSP_NEON)
+
+///
+///	Downmix weights / 1000 of the left and right output channel,
+///	indexed by the number of input channels.  Must match
+///	AudioDspDownmixC().
+///
+static const int16_t AudioDspDownmixWeights[9][2][8] = {
+    [3] = {{600, 0, 400}, {0, 600, 400}},
+    [4] = {{600, 0, 400, 0}, {0, 600, 0, 400}},
+    [5] = {{500, 0, 200, 0, 300}, {0, 500, 0, 200, 300}},
+    [6] = {{400, 0, 200, 0, 300, 100}, {0, 400, 0, 200, 300, 100}},
+    [7] = {{400, 0, 200, 0, 300, 100, 0}, {0, 400, 0, 200, 300, 0, 100}},
+    [8] = {{400, 0, 150, 0, 250, 100, 100, 0}, {0, 400, 0, 150, 250, 100, 0, 100}},
+};
+
+/**
+**	Number of frames, which can be read with full 8 sample vectors.
+**
+**	@param chan	nr. of channels
+**	@param frames	number of frames in sample buffer
+*/
+static inline int AudioDspVectorFrames(int chan, int frames) {
+    int n;
+
+    n = frames - (8 + chan - 1) / chan + 1;
+    return n < 0 ? 0 : n;
+}
+
+#endif
+
+#ifdef USE_AUDIO_DSP_X86
+
+//----------------------------------------------------------------------------
+//  SSE2
+//----------------------------------------------------------------------------
+
+/**
+**	Divide signed 32 bit values by 1000, rounding toward zero.
+*/
+static inline __attribute__((target("sse2"), always_inline)) __m128i AudioDspDiv1000Sse2(__m128i x) {
+    const __m128i magic = _mm_set1_epi32(0x10624DD3);
+    __m128i sign;
+    __m128i a;
+    __m128i even;
+    __m128i odd;
+    __m128i q;
+
+    // SSE2 has only an unsigned 32x32 -> 64 bit multiply
+    sign = _mm_srai_epi32(x, 31);
+    a = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+    even = _mm_srli_epi64(_mm_mul_epu32(a, magic), 38);
+    odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), magic), 38);
+    q = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+    return _mm_sub_epi32(_mm_xor_si128(q, sign), sign);
+}
+
+/**
+**	Horizontal sum of four vectors.
+**
+**	@returns sums of @a a, @a b, @a c and @a d as one vector.
+*/
+static inline __attribute__((target("sse2"), always_inline)) __m128i AudioDspSum4Sse2(__m128i a, __m128i b, __m128i c,
+                                                                                       __m128i d) {
+    __m128i ab;
+    __m128i cd;
+
+    ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+    return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+
+/**
+**	Scale samples by factor / 1000 with clipping (SSE2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor / 1000
+*/
+static __attribute__((target("sse2"))) void AudioDspScaleSse2(int16_t *samples, int n, int factor) {
+    __m128i f;
+    int i;
+
+    if (factor < 0 || factor > INT16_MAX) { // doesn't fit 16x16 multiply
+        AudioDspScaleC(samples, n, factor);
+        return;
+    }
+    f = _mm_set1_epi16(factor);
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i v;
+        __m128i lo;
+        __m128i hi;
+        __m128i p0;
+        __m128i p1;
+
+        v = _mm_loadu_si128((const __m128i *)(samples + i));
+        lo = _mm_mullo_epi16(v, f);
+        hi = _mm_mulhi_epi16(v, f);
+        p0 = AudioDspDiv1000Sse2(_mm_unpacklo_epi16(lo, hi));
+        p1 = AudioDspDiv1000Sse2(_mm_unpackhi_epi16(lo, hi));
+        // saturated pack is the clipping
+        _mm_storeu_si128((__m128i *)(samples + i), _mm_packs_epi32(p0, p1));
+    }
+    AudioDspScaleC(samples + i, n - i, factor);
+}
+
+/**
+**	Sum of the squared samples (SSE2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param shift	each square is shifted right by @a shift bits
+*/
+static __attribute__((target("sse2"))) uint32_t AudioDspPowerSse2(const int16_t *samples, int n, int shift) {
+    __m128i sum;
+    __m128i count;
+    uint32_t r[4];
+    int i;
+
+    sum = _mm_setzero_si128();
+    count = _mm_cvtsi32_si128(shift);
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i v;
+        __m128i lo;
+        __m128i hi;
+
+        v = _mm_loadu_si128((const __m128i *)(samples + i));
+        lo = _mm_mullo_epi16(v, v);
+        hi = _mm_mulhi_epi16(v, v);
+        // squares are positive, the unsigned sum wraps like the C version
+        sum = _mm_add_epi32(sum, _mm_srl_epi32(_mm_unpacklo_epi16(lo, hi), count));
+        sum = _mm_add_epi32(sum, _mm_srl_epi32(_mm_unpackhi_epi16(lo, hi), count));
+    }
+    _mm_storeu_si128((__m128i *)r, sum);
+    return r[0] + r[1] + r[2] + r[3] + AudioDspPowerC(samples + i, n - i, shift);
+}
+
+/**
+**	Find the loudest sample (SSE2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static __attribute__((target("sse2"))) int AudioDspPeakSse2(const int16_t *samples, int n) {
+    __m128i max;
+    __m128i min;
+    int16_t r[16];
+    int i;
+    int t;
+
+    max = _mm_setzero_si128();
+    min = _mm_setzero_si128();
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i v;
+
+        v = _mm_loadu_si128((const __m128i *)(samples + i));
+        max = _mm_max_epi16(max, v);
+        min = _mm_min_epi16(min, v);
+    }
+    // -INT16_MIN doesn't fit, search min and max separate
+    _mm_storeu_si128((__m128i *)r, max);
+    _mm_storeu_si128((__m128i *)(r + 8), min);
+    t = AudioDspPeakC(samples + i, n - i);
+    for (i = 0; i < 16; ++i) {
+        if (abs(r[i]) > t) {
+            t = abs(r[i]);
+        }
+    }
+    return t;
+}
+
+/**
+**	Downmix surround to stereo (SSE2).
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+*/
+static __attribute__((target("sse2"))) void AudioDspDownmixSse2(const int16_t *in, int in_chan, int frames,
+                                                                 int16_t *out) {
+    __m128i wl;
+    __m128i wr;
+    int n;
+    int i;
+
+    if (in_chan < 3 || in_chan > 8) {
+        AudioDspDownmixC(in, in_chan, frames, out);
+        return;
+    }
+    wl = _mm_loadu_si128((const __m128i *)AudioDspDownmixWeights[in_chan][0]);
+    wr = _mm_loadu_si128((const __m128i *)AudioDspDownmixWeights[in_chan][1]);
+
+    // each frame is loaded as 8 samples, unused channels have zero weight
+    n = AudioDspVectorFrames(in_chan, frames);
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i f0;
+        __m128i f1;
+        __m128i f2;
+        __m128i f3;
+        __m128i s01;
+        __m128i s23;
+
+        f0 = _mm_loadu_si128((const __m128i *)(in + 0 * in_chan));
+        f1 = _mm_loadu_si128((const __m128i *)(in + 1 * in_chan));
+        f2 = _mm_loadu_si128((const __m128i *)(in + 2 * in_chan));
+        f3 = _mm_loadu_si128((const __m128i *)(in + 3 * in_chan));
+        // l0 r0 l1 r1
+        s01 = AudioDspSum4Sse2(_mm_madd_epi16(f0, wl), _mm_madd_epi16(f0, wr), _mm_madd_epi16(f1, wl),
+                               _mm_madd_epi16(f1, wr));
+        // l2 r2 l3 r3
+        s23 = AudioDspSum4Sse2(_mm_madd_epi16(f2, wl), _mm_madd_epi16(f2, wr), _mm_madd_epi16(f3, wl),
+                               _mm_madd_epi16(f3, wr));
+        // weights sum up to 1000, the pack never saturates
+        _mm_storeu_si128((__m128i *)out, _mm_packs_epi32(AudioDspDiv1000Sse2(s01), AudioDspDiv1000Sse2(s23)));
+        in += 4 * in_chan;
+        out += 8;
+    }
+    AudioDspDownmixC(in, in_chan, frames - i, out);
+}
+
+/**
+**	Upmix @a in_chan channels to @a out_chan (SSE2).
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+**	@param out_chan	nr. of output channels
+*/
+static __attribute__((target("sse2"))) void AudioDspUpmixSse2(const int16_t *in, int in_chan, int frames,
+                                                               int16_t *out, int out_chan) {
+    __m128i mask;
+    int n;
+    int i;
+
+    if (in_chan < 1 || in_chan >= out_chan || out_chan > 8) {
+        AudioDspUpmixC(in, in_chan, frames, out, out_chan);
+        return;
+    }
+    mask = _mm_cmpgt_epi16(_mm_set1_epi16(in_chan), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+
+    // the extra samples stored are overwritten by the next frame
+    n = AudioDspVectorFrames(in_chan, frames);
+    for (i = 0; i < n; ++i) {
+        _mm_storeu_si128((__m128i *)out, _mm_and_si128(_mm_loadu_si128((const __m128i *)in), mask));
+        in += in_chan;
+        out += out_chan;
+    }
+    AudioDspUpmixC(in, in_chan, frames - i, out, out_chan);
+}
+
+///
+///	SSE2 audio dsp kernels.
+///
+static const AudioDsp AudioDspSse2Kernels = {
+    .Name = "sse2",
+    .Scale = AudioDspScaleSse2,
+    .Power = AudioDspPowerSse2,
+    .Peak = AudioDspPeakSse2,
+    .Downmix = AudioDspDownmixSse2,
+    .Upmix = AudioDspUpmixSse2,
+};
+
+//----------------------------------------------------------------------------
+//  AVX2
+//----------------------------------------------------------------------------
+
+/**
+**	Divide signed 32 bit values by 1000, rounding toward zero.
+*/
+static inline __attribute__((target("avx2"), always_inline)) __m256i AudioDspDiv1000Avx2(__m256i x) {
+    const __m256i magic = _mm256_set1_epi32(0x10624DD3);
+    __m256i sign;
+    __m256i a;
+    __m256i even;
+    __m256i odd;
+    __m256i q;
+
+    sign = _mm256_srai_epi32(x, 31);
+    a = _mm256_sub_epi32(_mm256_xor_si256(x, sign), sign);
+    even = _mm256_srli_epi64(_mm256_mul_epu32(a, magic), 38);
+    odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), magic), 38);
+    q = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+    return _mm256_sub_epi32(_mm256_xor_si256(q, sign), sign);
+}
+
+/**
+**	Scale samples by factor / 1000 with clipping (AVX2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor / 1000
+*/
+static __attribute__((target("avx2"))) void AudioDspScaleAvx2(int16_t *samples, int n, int factor) {
+    __m256i f;
+    int i;
+
+    if (factor < 0 || factor > INT16_MAX) { // doesn't fit 16x16 multiply
+        AudioDspScaleC(samples, n, factor);
+        return;
+    }
+    f = _mm256_set1_epi16(factor);
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256i v;
+        __m256i lo;
+        __m256i hi;
+        __m256i p0;
+        __m256i p1;
+
+        v = _mm256_loadu_si256((const __m256i *)(samples + i));
+        lo = _mm256_mullo_epi16(v, f);
+        hi = _mm256_mulhi_epi16(v, f);
+        // unpack and pack work per 128 bit lane, the order is kept
+        p0 = AudioDspDiv1000Avx2(_mm256_unpacklo_epi16(lo, hi));
+        p1 = AudioDspDiv1000Avx2(_mm256_unpackhi_epi16(lo, hi));
+        _mm256_storeu_si256((__m256i *)(samples + i), _mm256_packs_epi32(p0, p1));
+    }
+    AudioDspScaleSse2(samples + i, n - i, factor);
+}
+
+/**
+**	Sum of the squared samples (AVX2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param shift	each square is shifted right by @a shift bits
+*/
+static __attribute__((target("avx2"))) uint32_t AudioDspPowerAvx2(const int16_t *samples, int n, int shift) {
+    __m256i sum;
+    __m128i count;
+    uint32_t r[8];
+    int i;
+
+    sum = _mm256_setzero_si256();
+    count = _mm_cvtsi32_si128(shift);
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256i v;
+        __m256i lo;
+        __m256i hi;
+
+        v = _mm256_loadu_si256((const __m256i *)(samples + i));
+        lo = _mm256_mullo_epi16(v, v);
+        hi = _mm256_mulhi_epi16(v, v);
+        sum = _mm256_add_epi32(sum, _mm256_srl_epi32(_mm256_unpacklo_epi16(lo, hi), count));
+        sum = _mm256_add_epi32(sum, _mm256_srl_epi32(_mm256_unpackhi_epi16(lo, hi), count));
+    }
+    _mm256_storeu_si256((__m256i *)r, sum);
+    return r[0] + r[1] + r[2] + r[3] + r[4] + r[5] + r[6] + r[7] + AudioDspPowerSse2(samples + i, n - i, shift);
+}
+
+/**
+**	Find the loudest sample (AVX2).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static __attribute__((target("avx2"))) int AudioDspPeakAvx2(const int16_t *samples, int n) {
+    __m256i max;
+    __m256i min;
+    int16_t r[32];
+    int i;
+    int t;
+
+    max = _mm256_setzero_si256();
+    min = _mm256_setzero_si256();
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256i v;
+
+        v = _mm256_loadu_si256((const __m256i *)(samples + i));
+        max = _mm256_max_epi16(max, v);
+        min = _mm256_min_epi16(min, v);
+    }
+    _mm256_storeu_si256((__m256i *)r, max);
+    _mm256_storeu_si256((__m256i *)(r + 16), min);
+    t = AudioDspPeakSse2(samples + i, n - i);
+    for (i = 0; i < 32; ++i) {
+        if (abs(r[i]) > t) {
+            t = abs(r[i]);
+        }
+    }
+    return t;
+}
+
+///
+///	AVX2 audio dsp kernels.
+///
+///	Frames of the channel mixer don't fit 256 bit vectors, it uses
+///	the SSE2 kernels.
+///
+static const AudioDsp AudioDspAvx2Kernels = {
+    .Name = "avx2",
+    .Scale = AudioDspScaleAvx2,
+    .Power = AudioDspPowerAvx2,
+    .Peak = AudioDspPeakAvx2,
+    .Downmix = AudioDspDownmixSse2,
+    .Upmix = AudioDspUpmixSse2,
+};
+
+#endif
+
+#ifdef USE_AUDIO_DSP_NEON
+
+//----------------------------------------------------------------------------
+//  NEON
+//----------------------------------------------------------------------------
+
+/**
+**	Divide signed 32 bit values by 1000, rounding toward zero.
+*/
+static inline int32x4_t AudioDspDiv1000Neon(int32x4_t x) {
+    const int32x2_t magic = vdup_n_s32(0x10624DD3);
+    int64x2_t lo;
+    int64x2_t hi;
+    int32x4_t q;
+
+    lo = vshrq_n_s64(vmull_s32(vget_low_s32(x), magic), 38);
+    hi = vshrq_n_s64(vmull_s32(vget_high_s32(x), magic), 38);
+    q = vcombine_s32(vmovn_s64(lo), vmovn_s64(hi));
+    // shift rounds down, correct negative values
+    return vsubq_s32(q, vshrq_n_s32(x, 31));
+}
+
+/**
+**	Horizontal sum of two vectors.
+**
+**	@returns sums of @a a and @a b.
+*/
+static inline int32x2_t AudioDspSum2Neon(int32x4_t a, int32x4_t b) {
+    return vpadd_s32(vpadd_s32(vget_low_s32(a), vget_high_s32(a)), vpadd_s32(vget_low_s32(b), vget_high_s32(b)));
+}
+
+/**
+**	Scale samples by factor / 1000 with clipping (NEON).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor / 1000
+*/
+static void AudioDspScaleNeon(int16_t *samples, int n, int factor) {
+    int16x4_t f;
+    int i;
+
+    if (factor < 0 || factor > INT16_MAX) { // doesn't fit 16x16 multiply
+        AudioDspScaleC(samples, n, factor);
+        return;
+    }
+    f = vdup_n_s16(factor);
+    for (i = 0; i + 8 <= n; i += 8) {
+        int16x8_t v;
+        int32x4_t p0;
+        int32x4_t p1;
+
+        v = vld1q_s16(samples + i);
+        p0 = AudioDspDiv1000Neon(vmull_s16(vget_low_s16(v), f));
+        p1 = AudioDspDiv1000Neon(vmull_s16(vget_high_s16(v), f));
+        vst1q_s16(samples + i, vcombine_s16(vqmovn_s32(p0), vqmovn_s32(p1)));
+    }
+    AudioDspScaleC(samples + i, n - i, factor);
+}
+
+/**
+**	Sum of the squared samples (NEON).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param shift	each square is shifted right by @a shift bits
+*/
+static uint32_t AudioDspPowerNeon(const int16_t *samples, int n, int shift) {
+    uint32x4_t sum;
+    int32x4_t count;
+    uint32_t r[4];
+    int i;
+
+    sum = vdupq_n_u32(0);
+    count = vdupq_n_s32(-shift);
+    for (i = 0; i + 8 <= n; i += 8) {
+        int16x8_t v;
+        uint32x4_t lo;
+        uint32x4_t hi;
+
+        v = vld1q_s16(samples + i);
+        lo = vreinterpretq_u32_s32(vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        hi = vreinterpretq_u32_s32(vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+        sum = vaddq_u32(sum, vshlq_u32(lo, count));
+        sum = vaddq_u32(sum, vshlq_u32(hi, count));
+    }
+    vst1q_u32(r, sum);
+    return r[0] + r[1] + r[2] + r[3] + AudioDspPowerC(samples + i, n - i, shift);
+}
+
+/**
+**	Find the loudest sample (NEON).
+**
+**	@param samples	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static int AudioDspPeakNeon(const int16_t *samples, int n) {
+    int16x8_t max;
+    int16x8_t min;
+    int16_t r[16];
+    int i;
+    int t;
+
+    max = vdupq_n_s16(0);
+    min = vdupq_n_s16(0);
+    for (i = 0; i + 8 <= n; i += 8) {
+        int16x8_t v;
+
+        v = vld1q_s16(samples + i);
+        max = vmaxq_s16(max, v);
+        min = vminq_s16(min, v);
+    }
+    vst1q_s16(r, max);
+    vst1q_s16(r + 8, min);
+    t = AudioDspPeakC(samples + i, n - i);
+    for (i = 0; i < 16; ++i) {
+        if (abs(r[i]) > t) {
+            t = abs(r[i]);
+        }
+    }
+    return t;
+}
+
+/**
+**	Downmix surround to stereo (NEON).
+**
+**	@param in	input sample buffer
+**	@param in_chan	nr. of input channels
+**	@param frames	number of frames in sample buffer
+**	@param out	output sample buffer
+*/
+static void AudioDspDownmixNeon(const int16_t *in, int in_chan, int frames, int16_t *out) {
+    int16x8_t wl;
+    int16x8_t wr;
+    int n;
+    int i;
+
+    if (in_chan < 3 || in_chan > 8) {
+        AudioDspDownmixC(in, in_chan, frames, out);
+        return;
+    }
+    wl = vld1q_s16(AudioDspDownmixWeights[in_chan][0]);
+    wr = vld1q_s16(AudioDspDownmixWeights[in_chan][1]);
+
+    n = AudioDspVectorFrames(in_chan, frames);
+    for (i = 0; i + 4 <= n; i += 4) {
+        int32x2_t s[4];
+        int j;
+
+        for (j = 0; j < 4; ++j) {
+            int16x8_t f;
+            int32x4_t l;
+            int32x4_t r;
+
+            f = vld1q_s16(in + j * in_chan);
+            l = vmlal_s16(vmull_s16(vget_low_s16(f), vget_low_s16(wl)), vget_high_s16(f), vget_high_s16(wl));
+            r = vmlal_s16(vmull_s16(vget_low_s16(f), vget_low_s16(wr)), vget_high_s16(f), vget_high_s16(wr));
+            s[j] = AudioDspSum2Neon(l, r);
+        }
+        vst1q_s16(out, vcombine_s16(vqmovn_s32(AudioDspDiv1000Neon(vcombine_s32(s[0], s[1]))),
+                                    vqmovn_s32(AudioDspDiv1000Neon(vcombine_s32(s[2], s[3])))));
+        in += 4 * in_chan;
+        out += 8;
+    }
+    AudioDspDownmixC(in, in_chan, frames - i, out);
+}
+
+///
+///	NEON audio dsp kernels.
+///
+static const AudioDsp AudioDspNeonKernels = {
+    .Name = "neon",
+    .Scale = AudioDspScaleNeon,
+    .Power = AudioDspPowerNeon,
+    .Peak = AudioDspPeakNeon,
+    .Downmix = AudioDspDownmixNeon,
+    .Upmix = AudioDspUpmixC,
+};
+
+#endif
+
+//----------------------------------------------------------------------------
+//  Kernel selection
+//----------------------------------------------------------------------------
+
+const AudioDsp *AudioDspUsed = &AudioDspCKernels; ///< selected audio dsp kernels
+
+/**
+**	Select the fastest audio dsp kernels supported by the cpu.
+**
+**	Setting the environment variable SOFTHD_AUDIO_DSP to "c" forces
+**	the plain C kernels.
+**
+**	@returns name of the selected kernel set.
+*/
+const char *AudioDspInit(void) {
+    const char *env;
+
+    AudioDspUsed = &AudioDspCKernels;
+    env = getenv("SOFTHD_AUDIO_DSP");
+    if (env && !strcmp(env, "c")) {
+        return AudioDspUsed->Name;
+    }
+#ifdef USE_AUDIO_DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        AudioDspUsed = &AudioDspAvx2Kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        AudioDspUsed = &AudioDspSse2Kernels;
+    }
+#endif
+#ifdef USE_AUDIO_DSP_NEON
+    AudioDspUsed = &AudioDspNeonKernels;
+#endif
+    return AudioDspUsed->Name;
+}
+
+#ifdef AUDIODSP_TEST
+
+//----------------------------------------------------------------------------
+//  Test
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+
+/**
+**	Fill buffer with random samples, including the extreme values.
+*/
+static void AudioDspTestFill(int16_t *samples, int n) {
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        switch (random() % 8) {
+            case 0:
+                samples[i] = INT16_MIN;
+                break;
+            case 1:
+                samples[i] = INT16_MAX;
+                break;
+            case 2:
+                samples[i] = random() % 64 - 32;
+                break;
+            default:
+                samples[i] = random();
+                break;
+        }
+    }
+}
+
+/**
+**	Compare a kernel set with the plain C kernels.
+**
+**	@param dsp	kernel set to check
+**
+**	@returns number of found differences.
+*/
+static int AudioDspTestCompare(const AudioDsp *dsp) {
+    static const int factors[] = {0, 1, 500, 999, 1000, 1001, 2000, 10000, INT16_MAX, 40000};
+    int16_t in[8 * 67 + 8];
+    int16_t ref[8 * 67 + 8];
+    int16_t out[8 * 67 + 8];
+    int errors;
+    int loop;
+
+    errors = 0;
+    for (loop = 0; loop < 2000; ++loop) {
+        int n;
+        int o;
+        int f;
+        int c;
+
+        n = random() % 67;
+        o = random() % 8; // unaligned buffers
+        AudioDspTestFill(in, sizeof(in) / sizeof(*in));
+
+        f = factors[random() % (sizeof(factors) / sizeof(*factors))];
+        memcpy(ref, in, sizeof(in));
+        memcpy(out, in, sizeof(in));
+        AudioDspCKernels.Scale(ref + o, n, f);
+        dsp->Scale(out + o, n, f);
+        if (memcmp(ref, out, sizeof(out))) {
+            printf("%s: scale %d samples by %d differs\n", dsp->Name, n, f);
+            errors++;
+        }
+
+        if (AudioDspCKernels.Power(in + o, n, 12) != dsp->Power(in + o, n, 12)) {
+            printf("%s: power of %d samples differs\n", dsp->Name, n);
+            errors++;
+        }
+        if (AudioDspCKernels.Peak(in + o, n) != dsp->Peak(in + o, n)) {
+            printf("%s: peak of %d samples differs\n", dsp->Name, n);
+            errors++;
+        }
+
+        for (c = 3; c <= 8; ++c) {
+            memset(ref, 0x55, sizeof(ref));
+            memset(out, 0x55, sizeof(out));
+            AudioDspCKernels.Downmix(in + o, c, n, ref);
+            dsp->Downmix(in + o, c, n, out);
+            if (memcmp(ref, out, sizeof(out))) {
+                printf("%s: downmix %d frames of %d channels differs\n", dsp->Name, n, c);
+                errors++;
+            }
+        }
+
+        for (c = 1; c < 8; ++c) {
+            int d;
+
+            d = c + 1 + random() % (8 - c);
+            memset(ref, 0x55, sizeof(ref));
+            memset(out, 0x55, sizeof(out));
+            AudioDspCKernels.Upmix(in + o, c, n, ref, d);
+            dsp->Upmix(in + o, c, n, out, d);
+            if (memcmp(ref, out, sizeof(out))) {
+                printf("%s: upmix %d frames of %d to %d channels differs\n", dsp->Name, n, c, d);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+/**
+**	Time the 7.1 downmix and the normalizer of a kernel set.
+**
+**	@param dsp	kernel set to measure
+*/
+static void AudioDspTestBench(const AudioDsp *dsp) {
+    static int16_t in[8 * 1536 * 8];
+    static int16_t out[2 * 1536 * 8];
+    struct timespec start;
+    struct timespec end;
+    uint32_t power;
+    int loop;
+
+    srandom(1); // same samples for all kernel sets
+    AudioDspTestFill(in, sizeof(in) / sizeof(*in));
+    power = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (loop = 0; loop < 1000; ++loop) {
+        dsp->Downmix(in, 8, sizeof(out) / sizeof(*out) / 2, out);
+        power += dsp->Power(out, sizeof(out) / sizeof(*out), 12);
+        dsp->Scale(out, sizeof(out) / sizeof(*out), 1500);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-5s: 7.1 downmix + normalize %6.3f ms per 1000 frames (%08x)\n", dsp->Name,
+           ((end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0) /
+               (sizeof(out) / sizeof(*out) / 2),
+           power);
+}
+
+/**
+**	Check and benchmark all kernel sets, which the cpu supports.
+**
+**	@param argc	number of arguments
+**	@param argv	arguments vector
+*/
+int main(int argc, char *const argv[]) {
+    const AudioDsp *dsps[4];
+    int errors;
+    int n;
+    int i;
+
+    (void)argc;
+    (void)argv;
+
+    n = 0;
+    dsps[n++] = &AudioDspCKernels;
+#ifdef USE_AUDIO_DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        dsps[n++] = &AudioDspSse2Kernels;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        dsps[n++] = &AudioDspAvx2Kernels;
+    }
+#endif
+#ifdef USE_AUDIO_DSP_NEON
+    dsps[n++] = &AudioDspNeonKernels;
+#endif
+    printf("selected: %s\n", AudioDspInit());
+
+    errors = 0;
+    for (i = 1; i < n; ++i) {
+        errors += AudioDspTestCompare(dsps[i]);
+    }
+    for (i = 0; i < n; ++i) {
+        AudioDspTestBench(dsps[i]);
+    }
+    if (errors) {
+        printf("%d differences\n", errors);
+        return 1;
+    }
+    printf("all kernels match\n");
+    return 0;
+}
+
+#endif
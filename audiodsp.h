@@ -0,0 +1,61 @@
+///
+/// @file audiodsp.h	@brief Audio DSP kernel module headerfile
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+/// @addtogroup AudioDsp
+/// @{
+
+//----------------------------------------------------------------------------
+//  Typedefs
+//----------------------------------------------------------------------------
+
+///
+///	Audio DSP kernel set.
+///
+///	All kernels work on interleaved signed 16 bit samples and give
+///	the same results as the plain C versions.
+///
+typedef struct _audio_dsp_ {
+    const char *Name; ///< kernel set name
+
+    /// scale samples by factor / 1000 with clipping
+    void (*const Scale)(int16_t *, int, int);
+    /// sum of the squared samples, each shifted right
+    uint32_t (*const Power)(const int16_t *, int, int);
+    /// absolute value of the loudest sample
+    int (*const Peak)(const int16_t *, int);
+    /// downmix 3 - 8 channels to stereo
+    void (*const Downmix)(const int16_t *, int, int, int16_t *);
+    /// upmix channels, missing channels are silent
+    void (*const Upmix)(const int16_t *, int, int, int16_t *, int);
+} AudioDsp;
+
+//----------------------------------------------------------------------------
+//  Variables
+//----------------------------------------------------------------------------
+
+extern const AudioDsp *AudioDspUsed; ///< selected audio dsp kernels
+
+//----------------------------------------------------------------------------
+//  Prototypes
+//----------------------------------------------------------------------------
+
+extern const char *AudioDspInit(void); ///< select kernels for this cpu
+
+/// @}
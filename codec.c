@@ -84,6 +84,12 @@ static pthread_mutex_t CodecLockMutex;
 
 /// Flag prefer fast channel switch
 char CodecUsePossibleDefectFrames;
+
+/// Software decoder use: 0 hw only, 1 fallback if the hw decoder can't decode the stream, 2 always
+char CodecSoftwareDecoder = 1;
+
+/// Software decoder frame threads (0 = all cpus)
+int CodecSoftwareThreads;
 AVBufferRef *hw_device_ctx;
 
 //----------------------------------------------------------------------------
@@ -213,6 +219,7 @@ void CodecVideoOpen(VideoDecoder *decoder, int codec_id) {
     const AVCodec *video_codec;
 #endif
     const char *name;
+    int software;
     int ret;
 
     Debug(3, "***************codec: Video Open using video codec ID %#06x (%s)\n", codec_id,
@@ -222,9 +229,12 @@ void CodecVideoOpen(VideoDecoder *decoder, int codec_id) {
         Error(_("codec: missing close\n"));
     }
 
+    software = CodecSoftwareDecoder == 2 || decoder->SoftwareFallback == 2;
+    decoder->SoftwareFallback = 0;
+
     name = "NULL";
 #ifdef CUVID
-    if (!strcasecmp(VideoGetDriverName(), "cuvid")) {
+    if (!strcasecmp(VideoGetDriverName(), "cuvid") && !software) {
         switch (codec_id) {
             case AV_CODEC_ID_MPEG2VIDEO:
                 name = "mpeg2_cuvid";
@@ -253,13 +263,17 @@ void CodecVideoOpen(VideoDecoder *decoder, int codec_id) {
         Fatal(_("codec: can't allocate video codec context\n"));
     }
 
-    if (!HwDeviceContext) {
+    if (HwDeviceContext && !software) {
+        decoder->VideoCtx->hw_device_ctx = av_buffer_ref(HwDeviceContext);
+        decoder->VideoCtx->thread_count = 1;
+    } else if (HwDeviceContext || !strcasecmp(VideoGetDriverName(), "noop")) {
+        // software decoder: frame threads, frames are uploaded by the video module
+        Info(_("codec: using software decoder with %d threads\n"), CodecSoftwareThreads);
+        decoder->VideoCtx->thread_count = CodecSoftwareThreads;
+        decoder->VideoCtx->thread_type = FF_THREAD_FRAME;
+    } else {
         Fatal("codec: no hw device context to be used");
     }
-    decoder->VideoCtx->hw_device_ctx = av_buffer_ref(HwDeviceContext);
-
-    // FIXME: for software decoder use all cpus, otherwise 1
-    decoder->VideoCtx->thread_count = 1;
 
     decoder->VideoCtx->pkt_timebase.num = 1;
     decoder->VideoCtx->pkt_timebase.den = 90000;
@@ -443,6 +457,25 @@ void DisplayPts(AVCodecContext * video_ctx, AVFrame * frame)
 
 #endif
 
+/**
+**  Reopen video decoder as software decoder.
+**
+**  The hw decoder can't decode the stream, the software decoder is
+**  opened with frame threads.  Called before the first frame is
+**  received, the packet which selected the format is decoded again.
+**
+**  @param decoder  video decoder data
+*/
+static void CodecVideoReopenSoftware(VideoDecoder *decoder) {
+    int codec_id;
+
+    codec_id = decoder->VideoCtx->codec_id;
+    Info(_("codec: hw decoder can't decode the stream, reopen as software decoder\n"));
+    CodecVideoClose(decoder);
+    decoder->SoftwareFallback = 2;
+    CodecVideoOpen(decoder, codec_id);
+}
+
 /**
 **  Decode a video packet.
 **
@@ -450,6 +483,9 @@ void DisplayPts(AVCodecContext * video_ctx, AVFrame * frame)
 **  @param avpkt    video packet
 */
 extern int CuvidTestSurfaces();
+extern int CuvidWaitSurfaces(int);
+
+#define CODEC_SURFACE_WAIT 20 ///< max. ms to wait for a free surface
 
 #if defined YADIF || defined(VAAPI)
 extern int init_filters(AVCodecContext *dec_ctx, void *decoder, AVFrame *frame);
@@ -461,29 +497,39 @@ void CodecVideoDecode(VideoDecoder *decoder, const AVPacket *avpkt) {
     AVCodecContext *video_ctx = decoder->VideoCtx;
    int consumed = 0;
 
+    if (video_ctx->codec_type != AVMEDIA_TYPE_VIDEO) {
+        return;
+    }
+
 next_try:
-    if (video_ctx->codec_type == AVMEDIA_TYPE_VIDEO && CuvidTestSurfaces()) {
+    if (CuvidTestSurfaces()) {
         int ret;
         const AVPacket *pkt;
         AVFrame *frame;
 
         pkt = avpkt; // use copy
         ret = avcodec_send_packet(video_ctx, pkt);
+        if (decoder->SoftwareFallback == 1) { // hw can't decode the stream
+            CodecVideoReopenSoftware(decoder);
+            video_ctx = decoder->VideoCtx;
+            goto next_try;
+        }
         if (ret != AVERROR(EAGAIN)) {
             consumed = 1;
         }   
 
-        if (!CuvidTestSurfaces())
-            usleep(1000);
+        if (!consumed) { // decoder full, wait until we can get frames
+            CuvidWaitSurfaces(CODEC_SURFACE_WAIT);
+        }
 
         ret = 0;
         while (ret >= 0 && CuvidTestSurfaces()) {
-            frame = av_frame_alloc();
+            frame = VideoGetFrame(decoder->HwDecoder);
             ret = avcodec_receive_frame(video_ctx, frame);
             //printf("Got Frame %d Video PTS %#012" PRIx64 " \n",ret,frame->pts);
             if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                 Debug(4, "codec: receiving video frame failed");
-                av_frame_free(&frame);
+                VideoPutFrame(decoder->HwDecoder, frame);
                 break;
             }
             if (ret >= 0) {
@@ -506,14 +552,15 @@ next_try:
                 }
                 VideoRenderFrame(decoder->HwDecoder, video_ctx, frame);
             } else {
-                av_frame_free(&frame);
+                VideoPutFrame(decoder->HwDecoder, frame);
                 break;
             }
         }
     }
     
     if (!consumed) {
-        usleep(50000);
+        // retry, as soon as the display frees a surface
+        CuvidWaitSurfaces(CODEC_SURFACE_WAIT);
         goto next_try;
     }
 }
@@ -537,6 +584,10 @@ next_part:
     got_frame = 0;
 
     ret1 = avcodec_send_packet(video_ctx, pkt);
+    if (decoder->SoftwareFallback == 1) { // hw can't decode the stream
+        CodecVideoReopenSoftware(decoder);
+        goto next_part;
+    }
 
     // first_time = GetusTicks();
 
@@ -544,15 +595,16 @@ next_part:
         consumed = 1;
     }
 
-    if (!CuvidTestSurfaces())
-        usleep(1000);
+    if (!consumed) { // decoder full, wait until we can get frames
+        CuvidWaitSurfaces(CODEC_SURFACE_WAIT);
+    }
 
     //     printf("send packet to decode %s %04x\n",consumed?"ok":"Full",ret1);
 
     if ((ret1 == AVERROR(EAGAIN) || ret1 == AVERROR_EOF || ret1 >= 0) && CuvidTestSurfaces()) {
         ret = 0;
         while ((ret >= 0) && CuvidTestSurfaces()) { // get frames until empty snd Surfaces avail.
-            frame = av_frame_alloc();
+            frame = VideoGetFrame(decoder->HwDecoder);
             ret = avcodec_receive_frame(video_ctx, frame); // get new frame
             if (ret >= 0) {                                // one is avail.
                 // first_time = frame->pts;
@@ -586,18 +638,17 @@ next_part:
                 VideoRenderFrame(decoder->HwDecoder, video_ctx, frame);
                 // av_frame_unref(frame);
             } else {
-                av_frame_free(&frame);
+                VideoPutFrame(decoder->HwDecoder, frame);
                 // printf("codec: got no frame %d  send %d\n",ret,ret1);
             }
         }
-        if (!CuvidTestSurfaces()) {
-            usleep(1000);
-        }
     } else {
         // consumed = 1;
     }
 
     if (!consumed) {
+        // retry, as soon as the display frees a surface
+        CuvidWaitSurfaces(CODEC_SURFACE_WAIT);
         goto next_part; // try again to stuff decoder
     }
 }
@@ -645,6 +696,8 @@ struct _audio_decoder_ {
 
     AVFrame *Frame;       ///< decoded audio frame buffer
     SwrContext *Resample; ///< ffmpeg software resample context
+    uint8_t *Buffer;      ///< resample output buffer
+    unsigned BufferSize;  ///< size of resample output buffer
 
     uint16_t Spdif[24576 / 2]; ///< SPDIF output buffer
     int SpdifIndex;            ///< index into SPDIF output buffer
@@ -710,6 +763,7 @@ AudioDecoder *CodecAudioNewDecoder(void) {
 */
 void CodecAudioDelDecoder(AudioDecoder *decoder) {
     av_frame_free(&decoder->Frame); // callee does checks
+    av_freep(&decoder->Buffer);
     free(decoder);
 }
 
@@ -1287,19 +1341,39 @@ void CodecAudioDecode(AudioDecoder *audio_decoder, const AVPacket *avpkt) {
             }
 
             if (audio_decoder->Resample) {
-                uint8_t outbuf[8192 * 2 * 8];
+                int frame_size;
+                int samples;
+                int count;
                 uint8_t *out[1];
 
-                out[0] = outbuf;
-                ret = swr_convert(audio_decoder->Resample, out, sizeof(outbuf) / (2 * audio_decoder->HwChannels),
+                frame_size = 2 * audio_decoder->HwChannels;
+                samples = swr_get_out_samples(audio_decoder->Resample, frame->nb_samples);
+                if (samples <= 0) {
+                    samples = frame->nb_samples;
+                }
+                // resample directly into the audio ring buffer, if possible
+                out[0] = AudioEnqueueGetBuffer(&count);
+                if (!out[0] || count < samples * frame_size) {
+                    av_fast_malloc(&audio_decoder->Buffer, &audio_decoder->BufferSize, samples * frame_size);
+                    if (!audio_decoder->Buffer) {
+                        Error(_("codec/audio: out of memory\n"));
+                        return;
+                    }
+                    out[0] = audio_decoder->Buffer;
+                    count = audio_decoder->BufferSize;
+                }
+                ret = swr_convert(audio_decoder->Resample, out, count / frame_size,
                                   (const uint8_t **)frame->extended_data, frame->nb_samples);
 
                 if (ret > 0) {
                     if (!(audio_decoder->Passthrough & CodecPCM)) {
-                        CodecReorderAudioFrame((int16_t *)outbuf, ret * 2 * audio_decoder->HwChannels,
-                                               audio_decoder->HwChannels);
+                        CodecReorderAudioFrame((int16_t *)out[0], ret * frame_size, audio_decoder->HwChannels);
+                    }
+                    if (out[0] == audio_decoder->Buffer) {
+                        AudioEnqueue(out[0], ret * frame_size);
+                    } else {
+                        AudioEnqueueCommit(ret * frame_size);
                     }
-                    AudioEnqueue(outbuf, ret * 2 * audio_decoder->HwChannels);
                 }
                 return;
             }
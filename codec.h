@@ -69,6 +69,8 @@ struct _video_decoder_ {
 
     int filter; // flag for deint filter
 
+    int SoftwareFallback; ///< 1 hw can't decode stream, 2 reopen as software decoder
+
     /* hwaccel options */
     enum HWAccelID hwaccel_id;
     char *hwaccel_device;
@@ -118,6 +120,12 @@ extern AVBufferRef *HwDeviceContext;
 /// Flag prefer fast xhannel switch
 extern char CodecUsePossibleDefectFrames;
 
+/// Software decoder use: 0 hw only, 1 fallback, 2 always
+extern char CodecSoftwareDecoder;
+
+/// Software decoder frame threads (0 = all cpus)
+extern int CodecSoftwareThreads;
+
 //----------------------------------------------------------------------------
 //  Prototypes
 //----------------------------------------------------------------------------
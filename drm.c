@@ -484,6 +484,68 @@ void InitBo(int bpp) {
     assert(eglSurface != NULL);
 }
 
+static pthread_mutex_t drm_mode_mutex = PTHREAD_MUTEX_INITIALIZER;
+static drmModeModeInfo drm_next_mode; ///< mode for the next swap
+static int drm_need_mode;             ///< drm_next_mode is valid
+
+///
+/// Refresh rate of a DRM mode in mHz.
+///
+static unsigned drm_mode_rate(const drmModeModeInfo *mode) {
+    if (!mode->htotal || !mode->vtotal) {
+        return mode->vrefresh * 1000;
+    }
+    return (uint64_t)mode->clock * 1000000 / (mode->htotal * mode->vtotal);
+}
+
+///
+/// Switch the display refresh rate, keep the resolution.
+///
+/// The new mode is only searched here, it is set by the video
+/// thread with the next swap.
+///
+/// @param rate wanted refresh rate in mHz
+///
+/// @returns true if a mode within 0.5% of rate is available.
+///
+static int drm_set_refresh(unsigned rate) {
+    drmModeConnector *connector;
+    const drmModeModeInfo *best;
+    unsigned best_diff;
+    int i;
+
+    if (!(connector = drmModeGetConnector(render->fd_drm, render->connector_id))) {
+        return 0;
+    }
+    best = NULL;
+    best_diff = rate / 200;
+    for (i = 0; i < connector->count_modes; ++i) {
+        const drmModeModeInfo *mode;
+        unsigned diff;
+
+        mode = &connector->modes[i];
+        if (mode->hdisplay != render->mode.hdisplay || mode->vdisplay != render->mode.vdisplay ||
+            (mode->flags & DRM_MODE_FLAG_INTERLACE)) {
+            continue;
+        }
+        diff = abs((int)(drm_mode_rate(mode) - rate));
+        if (diff <= best_diff) {
+            best = mode;
+            best_diff = diff;
+        }
+    }
+    if (best) {
+        Debug(3, "video/drm: refresh %u.%03u Hz, mode %s\n", rate / 1000, rate % 1000, best->name);
+        pthread_mutex_lock(&drm_mode_mutex);
+        drm_next_mode = *best;
+        drm_need_mode = 1;
+        pthread_mutex_unlock(&drm_mode_mutex);
+    }
+    drmModeFreeConnector(connector);
+
+    return best != NULL;
+}
+
 static struct gbm_bo *previous_bo = NULL;
 static uint32_t previous_fb;
 static int has_modeset = 0;
@@ -507,6 +569,16 @@ static void drm_swap_buffers() {
                  &fb);
     //  drmModeSetCrtc (render->fd_drm, render->crtc_id, fb, 0, 0, &render->connector_id, 1, &render->mode);
 
+    if (drm_need_mode) { // refresh rate change requested
+        pthread_mutex_lock(&drm_mode_mutex);
+        if (memcmp(&render->mode, &drm_next_mode, sizeof(render->mode))) {
+            render->mode = drm_next_mode;
+            m_need_modeset = 1;
+        }
+        drm_need_mode = 0;
+        pthread_mutex_unlock(&drm_mode_mutex);
+    }
+
     if (m_need_modeset) {
         drmModeAtomicReqPtr ModeReq;
         const uint32_t flags = DRM_MODE_ATOMIC_ALLOW_MODESET;
@@ -0,0 +1,525 @@
+///
+/// @file frameconv.c	@brief Software frame conversion module
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+/// @defgroup FrameConv The software frame conversion module.
+///
+/// Converts frames of the software decoder to NV12 (8 bit) or P010
+/// (10 bit and more), the layouts of the hardware surfaces.
+///
+/// The frame is cut into horizontal bands, each band is converted by
+/// its own swscale context as an independent picture.  The bands are
+/// spread over a small pool of worker threads, the calling thread
+/// converts the first band itself.  Band heights are a multiple of
+/// 16 lines, so no band splits a chroma line.
+///
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+
+#include "frameconv.h"
+
+//----------------------------------------------------------------------------
+//  Variables
+//----------------------------------------------------------------------------
+
+///
+/// Frame converter worker.
+///
+typedef struct _frame_conv_worker_ {
+    FrameConv *Conv;        ///< converter of this worker
+    int Index;              ///< band converted by this worker
+    pthread_t Thread;       ///< worker thread, not used for band 0
+    struct SwsContext *Sws; ///< swscale context of the band
+} FrameConvWorker;
+
+///
+/// Frame converter.
+///
+struct _frame_conv_ {
+    pthread_mutex_t Mutex;    ///< lock job
+    pthread_cond_t StartCond; ///< workers wait for new job
+    pthread_cond_t DoneCond;  ///< caller waits for all bands
+
+    int Threads;  ///< number of bands
+    unsigned Job; ///< job counter
+    int Pending;  ///< bands not yet converted
+    int Errors;   ///< bands failed
+    int Exit;     ///< stop workers
+
+    const AVFrame *Src; ///< frame to convert
+    AVFrame *Dst;       ///< converted frame
+    int BandHeight;     ///< lines per band
+
+    FrameConvWorker Worker[FRAME_CONV_THREADS_MAX]; ///< band workers
+};
+
+//----------------------------------------------------------------------------
+//  Functions
+//----------------------------------------------------------------------------
+
+/**
+**	Convert one band of the current job.
+**
+**	@param worker	band worker
+**
+**	@returns 0 on success, -1 on error.
+*/
+static int FrameConvBand(FrameConvWorker *worker) {
+    const FrameConv *conv;
+    const AVFrame *src;
+    AVFrame *dst;
+    const AVPixFmtDescriptor *desc;
+    const uint8_t *src_data[4];
+    uint8_t *dst_data[4];
+    int y;
+    int h;
+    int i;
+
+    conv = worker->Conv;
+    src = conv->Src;
+    dst = conv->Dst;
+    y = worker->Index * conv->BandHeight;
+    h = src->height - y;
+    if (h > conv->BandHeight) {
+        h = conv->BandHeight;
+    }
+    if (h <= 0) {
+        return 0;
+    }
+
+    worker->Sws = sws_getCachedContext(worker->Sws, src->width, h, src->format, dst->width, h, dst->format,
+                                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (!worker->Sws) {
+        return -1;
+    }
+
+    desc = av_pix_fmt_desc_get(src->format);
+    for (i = 0; i < 4; ++i) {
+        // plane 1 and 2 are the chroma planes
+        src_data[i] = src->data[i] ? src->data[i] + (y >> ((i == 1 || i == 2) ? desc->log2_chroma_h : 0)) *
+                                                        src->linesize[i]
+                                   : NULL;
+    }
+    // NV12 and P010 have the interleaved chroma with half height in plane 1
+    dst_data[0] = dst->data[0] + y * dst->linesize[0];
+    dst_data[1] = dst->data[1] + (y >> 1) * dst->linesize[1];
+    dst_data[2] = NULL;
+    dst_data[3] = NULL;
+
+    sws_scale(worker->Sws, src_data, src->linesize, 0, h, dst_data, dst->linesize);
+
+    return 0;
+}
+
+/**
+**	Worker thread, converts its band for each new job.
+**
+**	@param arg	band worker
+*/
+static void *FrameConvThread(void *arg) {
+    FrameConvWorker *worker;
+    FrameConv *conv;
+    unsigned job;
+
+    worker = arg;
+    conv = worker->Conv;
+
+    job = 0; // no job done yet
+    pthread_mutex_lock(&conv->Mutex);
+    for (;;) {
+        int err;
+
+        while (job == conv->Job && !conv->Exit) {
+            pthread_cond_wait(&conv->StartCond, &conv->Mutex);
+        }
+        if (conv->Exit) {
+            break;
+        }
+        job = conv->Job;
+        pthread_mutex_unlock(&conv->Mutex);
+
+        err = FrameConvBand(worker);
+
+        pthread_mutex_lock(&conv->Mutex);
+        if (err) {
+            conv->Errors++;
+        }
+        if (!--conv->Pending) {
+            pthread_cond_signal(&conv->DoneCond);
+        }
+    }
+    pthread_mutex_unlock(&conv->Mutex);
+
+    return NULL;
+}
+
+/**
+**	Allocate frame converter.
+**
+**	@param threads	number of bands converted in parallel, 0 uses
+**			half of the online cpus.
+**
+**	@returns frame converter, NULL on error.
+*/
+FrameConv *FrameConvNew(int threads) {
+    FrameConv *conv;
+    int i;
+
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN) / 2;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > FRAME_CONV_THREADS_MAX) {
+        threads = FRAME_CONV_THREADS_MAX;
+    }
+
+    if (!(conv = calloc(1, sizeof(*conv)))) {
+        return NULL;
+    }
+    pthread_mutex_init(&conv->Mutex, NULL);
+    pthread_cond_init(&conv->StartCond, NULL);
+    pthread_cond_init(&conv->DoneCond, NULL);
+
+    for (i = 0; i < threads; ++i) {
+        conv->Worker[i].Conv = conv;
+        conv->Worker[i].Index = i;
+    }
+    // band 0 is converted by the caller
+    for (conv->Threads = 1; conv->Threads < threads; ++conv->Threads) {
+        if (pthread_create(&conv->Worker[conv->Threads].Thread, NULL, FrameConvThread,
+                           &conv->Worker[conv->Threads])) {
+            break;
+        }
+    }
+
+    return conv;
+}
+
+/**
+**	Free frame converter.
+**
+**	@param conv	frame converter
+*/
+void FrameConvDel(FrameConv *conv) {
+    int i;
+
+    if (!conv) {
+        return;
+    }
+    pthread_mutex_lock(&conv->Mutex);
+    conv->Exit = 1;
+    pthread_cond_broadcast(&conv->StartCond);
+    pthread_mutex_unlock(&conv->Mutex);
+
+    for (i = 1; i < conv->Threads; ++i) {
+        pthread_join(conv->Worker[i].Thread, NULL);
+    }
+    for (i = 0; i < conv->Threads; ++i) {
+        sws_freeContext(conv->Worker[i].Sws);
+    }
+    pthread_cond_destroy(&conv->DoneCond);
+    pthread_cond_destroy(&conv->StartCond);
+    pthread_mutex_destroy(&conv->Mutex);
+    free(conv);
+}
+
+/**
+**	Get number of bands converted in parallel.
+**
+**	@param conv	frame converter
+*/
+int FrameConvThreads(const FrameConv *conv) { return conv->Threads; }
+
+/**
+**	Get output pixel format for a software pixel format.
+**
+**	@param format	pixel format of the software decoder
+**
+**	@returns AV_PIX_FMT_P010 for more than 8 bit, else AV_PIX_FMT_NV12.
+*/
+enum AVPixelFormat FrameConvFormat(enum AVPixelFormat format) {
+    const AVPixFmtDescriptor *desc;
+
+    desc = av_pix_fmt_desc_get(format);
+    if (desc && desc->comp[0].depth > 8) {
+        return AV_PIX_FMT_P010;
+    }
+    return AV_PIX_FMT_NV12;
+}
+
+/**
+**	Convert a software frame to NV12 or P010.
+**
+**	The buffers of @a dst are reused, if format and size still match.
+**
+**	@param conv	frame converter
+**	@param dst	converted frame
+**	@param src	software decoded frame
+**
+**	@returns 0 on success, -1 on error.
+*/
+int FrameConvConvert(FrameConv *conv, AVFrame *dst, const AVFrame *src) {
+    enum AVPixelFormat format;
+    int i;
+
+    format = FrameConvFormat(src->format);
+    if (dst->format != format || dst->width != src->width || dst->height != src->height) {
+        av_frame_unref(dst);
+    }
+    if (!dst->buf[0]) {
+        dst->format = format;
+        dst->width = src->width;
+        dst->height = src->height;
+        if (av_frame_get_buffer(dst, 0) < 0) {
+            return -1;
+        }
+    }
+    if (av_frame_copy_props(dst, src) < 0) {
+        return -1;
+    }
+
+    // bands of 16 lines multiple, workers without lines are idle
+    conv->BandHeight = ((src->height + conv->Threads - 1) / conv->Threads + 15) & ~15;
+
+    pthread_mutex_lock(&conv->Mutex);
+    conv->Src = src;
+    conv->Dst = dst;
+    conv->Errors = 0;
+    conv->Pending = conv->Threads - 1;
+    conv->Job++;
+    if (conv->Pending) {
+        pthread_cond_broadcast(&conv->StartCond);
+    }
+    pthread_mutex_unlock(&conv->Mutex);
+
+    i = FrameConvBand(&conv->Worker[0]);
+
+    pthread_mutex_lock(&conv->Mutex);
+    while (conv->Pending) {
+        pthread_cond_wait(&conv->DoneCond, &conv->Mutex);
+    }
+    if (i) {
+        conv->Errors++;
+    }
+    i = conv->Errors;
+    pthread_mutex_unlock(&conv->Mutex);
+
+    return i ? -1 : 0;
+}
+
+#ifdef FRAMECONV_TEST
+
+//----------------------------------------------------------------------------
+//  Test
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+
+/**
+**	Fill software frame with a pattern.
+**
+**	@param frame	frame with allocated buffers
+*/
+static void FrameConvTestFill(AVFrame *frame) {
+    const AVPixFmtDescriptor *desc;
+    int i;
+
+    desc = av_pix_fmt_desc_get(frame->format);
+    for (i = 0; i < 4 && frame->data[i]; ++i) {
+        int h;
+        int y;
+        int x;
+
+        h = (i == 1 || i == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        for (y = 0; y < h; ++y) {
+            if (desc->comp[0].depth > 8) {
+                uint16_t *p;
+
+                p = (uint16_t *)(frame->data[i] + y * frame->linesize[i]);
+                for (x = 0; x < frame->linesize[i] / 2; ++x) {
+                    p[x] = (x * 7 + y * 3 + i * 101 + random() % 4) & ((1 << desc->comp[0].depth) - 1);
+                }
+            } else {
+                uint8_t *p;
+
+                p = frame->data[i] + y * frame->linesize[i];
+                for (x = 0; x < frame->linesize[i]; ++x) {
+                    p[x] = x * 7 + y * 3 + i * 101 + random() % 4;
+                }
+            }
+        }
+    }
+}
+
+/**
+**	Compare two converted frames.
+**
+**	@returns the biggest sample difference.
+*/
+static int FrameConvTestCompare(const AVFrame *a, const AVFrame *b) {
+    int diff;
+    int i;
+
+    diff = 0;
+    for (i = 0; i < 2; ++i) {
+        int h;
+        int n;
+        int y;
+        int x;
+
+        h = i ? a->height / 2 : a->height;
+        n = a->width; // luma samples or interleaved chroma samples
+        for (y = 0; y < h; ++y) {
+            if (a->format == AV_PIX_FMT_P010) {
+                const uint16_t *p;
+                const uint16_t *q;
+
+                p = (const uint16_t *)(a->data[i] + y * a->linesize[i]);
+                q = (const uint16_t *)(b->data[i] + y * b->linesize[i]);
+                for (x = 0; x < n; ++x) {
+                    if (abs(p[x] - q[x]) > diff) {
+                        diff = abs(p[x] - q[x]);
+                    }
+                }
+            } else {
+                const uint8_t *p;
+                const uint8_t *q;
+
+                p = a->data[i] + y * a->linesize[i];
+                q = b->data[i] + y * b->linesize[i];
+                for (x = 0; x < n; ++x) {
+                    if (abs(p[x] - q[x]) > diff) {
+                        diff = abs(p[x] - q[x]);
+                    }
+                }
+            }
+        }
+    }
+    return diff;
+}
+
+/**
+**	Check and benchmark the converter for all band counts.
+**
+**	The single band conversion is the reference, more bands must
+**	give the same picture.	Only pure layout changes (4:2:0 input)
+**	must be identical, 4:2:2 input may differ a little at the band
+**	borders.
+**
+**	@param argc	number of arguments
+**	@param argv	arguments vector: [width height [frames]]
+*/
+int main(int argc, char *const argv[]) {
+    static const enum AVPixelFormat formats[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV444P,
+    };
+    int width;
+    int height;
+    int frames;
+    int errors;
+    int cpus;
+    unsigned f;
+
+    width = argc > 2 ? atoi(argv[1]) : 1920;
+    height = argc > 2 ? atoi(argv[2]) : 1080;
+    frames = argc > 3 ? atoi(argv[3]) : 100;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > FRAME_CONV_THREADS_MAX) {
+        cpus = FRAME_CONV_THREADS_MAX;
+    }
+
+    errors = 0;
+    for (f = 0; f < sizeof(formats) / sizeof(*formats); ++f) {
+        FrameConv *conv;
+        AVFrame *src;
+        AVFrame *ref;
+        int threads;
+
+        src = av_frame_alloc();
+        ref = av_frame_alloc();
+        src->format = formats[f];
+        src->width = width;
+        src->height = height;
+        if (av_frame_get_buffer(src, 0) < 0) {
+            printf("out of memory\n");
+            return 1;
+        }
+        FrameConvTestFill(src);
+
+        conv = FrameConvNew(1);
+        if (FrameConvConvert(conv, ref, src)) {
+            printf("%s: conversion failed\n", av_get_pix_fmt_name(src->format));
+            errors++;
+        }
+        FrameConvDel(conv);
+
+        for (threads = 1; threads <= cpus; ++threads) {
+            struct timespec start;
+            struct timespec end;
+            AVFrame *dst;
+            double ms;
+            int diff;
+            int i;
+
+            conv = FrameConvNew(threads);
+            dst = av_frame_alloc();
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < frames; ++i) {
+                if (FrameConvConvert(conv, dst, src)) {
+                    errors++;
+                    break;
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+            diff = FrameConvTestCompare(ref, dst);
+            if (diff && (src->format == AV_PIX_FMT_YUV420P || src->format == AV_PIX_FMT_YUV420P10LE)) {
+                printf("%s: %d bands differ by %d\n", av_get_pix_fmt_name(src->format), threads, diff);
+                errors++;
+            }
+            printf("%-12s -> %-4s %dx%d %d bands: %7.3f ms per frame %7.1f fps max diff %d\n",
+                   av_get_pix_fmt_name(src->format), av_get_pix_fmt_name(dst->format), width, height,
+                   FrameConvThreads(conv), ms / frames, frames / (ms / 1000.0), diff);
+
+            av_frame_free(&dst);
+            FrameConvDel(conv);
+        }
+        av_frame_free(&ref);
+        av_frame_free(&src);
+    }
+    printf("%d errors\n", errors);
+
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,56 @@
+///
+/// @file frameconv.h	@brief Software frame conversion module headerfile
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+/// @addtogroup FrameConv
+/// @{
+
+//----------------------------------------------------------------------------
+//  Defines
+//----------------------------------------------------------------------------
+
+#define FRAME_CONV_THREADS_MAX 8 ///< max. bands converted in parallel
+
+//----------------------------------------------------------------------------
+//  Typedefs
+//----------------------------------------------------------------------------
+
+/// Frame converter typedef.
+typedef struct _frame_conv_ FrameConv;
+
+//----------------------------------------------------------------------------
+//  Prototypes
+//----------------------------------------------------------------------------
+
+/// Allocate frame converter with worker threads.
+extern FrameConv *FrameConvNew(int);
+
+/// Free frame converter and stop its worker threads.
+extern void FrameConvDel(FrameConv *);
+
+/// Get number of bands converted in parallel.
+extern int FrameConvThreads(const FrameConv *);
+
+/// Get output pixel format (NV12 or P010) for a software pixel format.
+extern enum AVPixelFormat FrameConvFormat(enum AVPixelFormat);
+
+/// Convert a software frame to NV12 or P010.
+extern int FrameConvConvert(FrameConv *, AVFrame *, const AVFrame *);
+
+/// @}
@@ -26,7 +26,8 @@
 
 #include <stdarg.h>
 #include <syslog.h>
-#include <time.h> // clock_gettime
+#include <pthread.h> // pthread_getcpuclockid
+#include <time.h>    // clock_gettime
 
 //////////////////////////////////////////////////////////////////////////////
 //  Defines
@@ -170,4 +171,21 @@ static inline uint64_t GetusTicks(void) {
 #endif
 }
 
+/**
+**	Get cpu time used by a thread.
+**
+**	@param thread	thread handle
+**
+**	@returns cpu time in ms, -1 if unknown.
+*/
+static inline int64_t GetThreadCpuMs(pthread_t thread) {
+    clockid_t clock;
+    struct timespec tspec;
+
+    if (!thread || pthread_getcpuclockid(thread, &clock) || clock_gettime(clock, &tspec)) {
+        return -1;
+    }
+    return (int64_t)tspec.tv_sec * 1000 + tspec.tv_nsec / (1000 * 1000);
+}
+
 /// @}
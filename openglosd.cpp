@@ -1,6 +1,7 @@
 #define __STL_CONFIG_H
 #include "openglosd.h"
 #include <algorithm>
+#include <time.h>
 
 /****************************************************************************************
  * Helpers
@@ -252,33 +253,233 @@ bool cShader::CheckCompileErrors(GLuint object, bool program) {
 
 #define KERNING_UNKNOWN (-10000)
 
+/****************************************************************************************
+ * cOglGlyphAtlas
+ ****************************************************************************************/
+cOglGlyphAtlas::cOglGlyphAtlas(void) {
+    size = 0;
+    cellWidth = 0;
+    cellHeight = 0;
+    cellsPerRow = 0;
+    cellsPerPage = 0;
+    nextCell = 0;
+}
+
+cOglGlyphAtlas::~cOglGlyphAtlas(void) {
+    for (int i = 0; i < pages.Size(); i++) {
+        GLuint texture = pages[i];
+
+        glDeleteTextures(1, &texture);
+    }
+}
+
+///
+/// Set the cell size, must be called before the first glyph is inserted.
+///
+/// Each cell keeps a one pixel gap to its neighbors, so linear filtering
+/// doesn't pick up parts of other glyphs.
+///
+void cOglGlyphAtlas::SetCellSize(GLint width, GLint height) {
+    cellWidth = width + 1;
+    cellHeight = height + 1;
+}
+
+bool cOglGlyphAtlas::Setup(void) {
+    GLint maxTextureSize = 0;
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    size = std::min(maxTextureSize, OGL_GLYPH_ATLAS_SIZE);
+    if (size <= 0 || cellWidth <= 1 || cellHeight <= 1)
+        return false;
+    cellsPerRow = size / cellWidth;
+    cellsPerPage = cellsPerRow * (size / cellHeight);
+    return true;
+}
+
+bool cOglGlyphAtlas::NewPage(void) {
+    GLuint texture;
+    // cleared, unused cells must not show garbage
+    uint8_t *zero = (uint8_t *)calloc(size, size);
+
+    if (!zero)
+        return false;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, size, size, 0, GL_RED, GL_UNSIGNED_BYTE, zero);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    free(zero);
+
+    pages.Append(texture);
+    return true;
+}
+
+///
+/// Check if all cells of all pages are used.
+///
+bool cOglGlyphAtlas::Full(void) const {
+    if (!cellsPerPage) // nothing inserted yet
+        return false;
+    return !freeCells.Size() && nextCell >= cellsPerPage * OGL_GLYPH_ATLAS_PAGES;
+}
+
+///
+/// Copy a glyph bitmap into a free cell of the atlas.
+///
+/// @param ftGlyph      rendered glyph
+/// @param[out] texture atlas page of the glyph
+/// @param[out] texCoords   left, top, right, bottom texture coordinates
+///
+/// @returns cell number, -1 if the glyph is blank, bigger than a cell or
+/// the atlas is full.
+///
+int cOglGlyphAtlas::Insert(FT_BitmapGlyph ftGlyph, GLuint &texture, GLfloat *texCoords) {
+    GLint width = ftGlyph->bitmap.width;
+    GLint height = ftGlyph->bitmap.rows;
+    int cell;
+
+    texture = 0;
+    texCoords[0] = texCoords[1] = texCoords[2] = texCoords[3] = 0.0f;
+    if (!width || !height) // blank, nothing to draw
+        return -1;
+    if (!size && !Setup())
+        return -1;
+    if (width >= cellWidth || height >= cellHeight)
+        return -1;
+
+    if (freeCells.Size()) {
+        cell = freeCells[freeCells.Size() - 1];
+        freeCells.Remove(freeCells.Size() - 1);
+    } else if (nextCell < pages.Size() * cellsPerPage ||
+               (pages.Size() < OGL_GLYPH_ATLAS_PAGES && cellsPerPage && NewPage())) {
+        cell = nextCell++;
+    } else {
+        return -1;
+    }
+
+    // whole cell is uploaded, this clears the rest of a reused cell
+    uint8_t *buf = (uint8_t *)calloc(cellWidth, cellHeight);
+
+    if (!buf) {
+        Release(cell);
+        return -1;
+    }
+    for (int y = 0; y < height; y++)
+        memcpy(buf + y * cellWidth, ftGlyph->bitmap.buffer + y * ftGlyph->bitmap.pitch, width);
+
+    GLint x = (cell % cellsPerPage) % cellsPerRow * cellWidth;
+    GLint y = (cell % cellsPerPage) / cellsPerRow * cellHeight;
+
+    texture = pages[cell / cellsPerPage];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cellWidth, cellHeight, GL_RED, GL_UNSIGNED_BYTE, buf);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    free(buf);
+
+    texCoords[0] = (GLfloat)x / size;
+    texCoords[1] = (GLfloat)y / size;
+    texCoords[2] = (GLfloat)(x + width) / size;
+    texCoords[3] = (GLfloat)(y + height) / size;
+    return cell;
+}
+
+///
+/// Give the cell of an evicted glyph back.
+///
+void cOglGlyphAtlas::Release(int cell) {
+    if (cell >= 0)
+        freeCells.Append(cell);
+}
+
 /****************************************************************************************
  * cOglGlyph
  ****************************************************************************************/
-cOglGlyph::cOglGlyph(FT_ULong charCode, FT_BitmapGlyph ftGlyph) {
+cOglGlyph::cOglGlyph(FT_ULong charCode, FT_BitmapGlyph ftGlyph, cOglGlyphAtlas *atlas) {
     this->charCode = charCode;
     bearingLeft = ftGlyph->left;
     bearingTop = ftGlyph->top;
     width = ftGlyph->bitmap.width;
     height = ftGlyph->bitmap.rows;
     advanceX = ftGlyph->root.advance.x >> 16; // value in 1/2^16 pixel
-    LoadTexture(ftGlyph);
+    kerningCache = NULL;
+    kerningSize = 0;
+    kerningCount = 0;
+    cell = atlas->Insert(ftGlyph, texture, texCoords);
+    if (cell < 0 && width && height) { // doesn't fit into a cell
+        LoadTexture(ftGlyph);
+    }
 }
 
-cOglGlyph::~cOglGlyph(void) {}
+cOglGlyph::~cOglGlyph(void) {
+    if (cell < 0 && texture)
+        glDeleteTextures(1, &texture);
+    free(kerningCache);
+}
 
+///
+/// Lookup kerning to previous symbol.
+///
+/// Open addressed hash table, prevSym 0 marks an empty slot.
+///
 int cOglGlyph::GetKerningCache(FT_ULong prevSym) {
-    for (int i = kerningCache.Size(); --i > 0;) {
+    if (!kerningSize)
+        return KERNING_UNKNOWN;
+    for (int i = (prevSym * 0x9E3779B1U) & (kerningSize - 1);; i = (i + 1) & (kerningSize - 1)) {
         if (kerningCache[i].prevSym == prevSym)
             return kerningCache[i].kerning;
+        if (!kerningCache[i].prevSym)
+            return KERNING_UNKNOWN;
     }
-    return KERNING_UNKNOWN;
 }
 
-void cOglGlyph::SetKerningCache(FT_ULong prevSym, int kerning) { kerningCache.Append(tKerning(prevSym, kerning)); }
+void cOglGlyph::SetKerningCache(FT_ULong prevSym, int kerning) {
+    int i;
+
+    // keep load factor below 1/2
+    if ((kerningCount + 1) * 2 > kerningSize) {
+        tKerning *old = kerningCache;
+        int oldSize = kerningSize;
+
+        kerningSize = kerningSize ? kerningSize * 2 : 8;
+        kerningCache = (tKerning *)calloc(kerningSize, sizeof(*kerningCache));
+        if (!kerningCache) {
+            kerningCache = old;
+            kerningSize = oldSize;
+            return;
+        }
+        for (int j = 0; j < oldSize; j++) {
+            if (!old[j].prevSym)
+                continue;
+            for (i = (old[j].prevSym * 0x9E3779B1U) & (kerningSize - 1); kerningCache[i].prevSym;
+                 i = (i + 1) & (kerningSize - 1))
+                ;
+            kerningCache[i] = old[j];
+        }
+        free(old);
+    }
+    for (i = (prevSym * 0x9E3779B1U) & (kerningSize - 1); kerningCache[i].prevSym; i = (i + 1) & (kerningSize - 1)) {
+        if (kerningCache[i].prevSym == prevSym) {
+            kerningCache[i].kerning = kerning;
+            return;
+        }
+    }
+    kerningCache[i].prevSym = prevSym;
+    kerningCache[i].kerning = kerning;
+    kerningCount++;
+}
 
 void cOglGlyph::BindTexture(void) { glBindTexture(GL_TEXTURE_2D, texture); }
 
+///
+/// Load a glyph too big for the atlas into its own texture.
+///
 void cOglGlyph::LoadTexture(FT_BitmapGlyph ftGlyph) {
     // Disable byte-alignment restriction
 
@@ -294,6 +495,10 @@ void cOglGlyph::LoadTexture(FT_BitmapGlyph ftGlyph) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    texCoords[0] = 0.0f;
+    texCoords[1] = 0.0f;
+    texCoords[2] = 1.0f;
+    texCoords[3] = 1.0f;
 }
 
 extern "C" void GlxInitopengl();
@@ -307,12 +512,15 @@ extern "C" void makejpg(uint8_t *data, int width, int height);
 FT_Library cOglFont::ftLib = 0;
 
 cList<cOglFont> *cOglFont::fonts = 0;
+cMutex cOglFont::fontsMutex;
 bool cOglFont::initiated = false;
 
 cOglFont::cOglFont(const char *fontName, int charHeight) : name(fontName) {
     size = charHeight;
     height = 0;
     bottom = 0;
+    glyphTable = NULL;
+    glyphTableSize = 0;
 
     int error = FT_New_Face(ftLib, fontName, 0, &face);
 
@@ -322,11 +530,24 @@ cOglFont::cOglFont(const char *fontName, int charHeight) : name(fontName) {
     FT_Set_Char_Size(face, 0, charHeight * 64, 0, 0);
     height = (face->size->metrics.ascender - face->size->metrics.descender + 63) / 64;
     bottom = abs((face->size->metrics.descender - 63) / 64);
+    // +2 for the stroked border
+    atlas.SetCellSize(height + 2, height + 2);
 }
 
-cOglFont::~cOglFont(void) { FT_Done_Face(face); }
+cOglFont::~cOglFont(void) {
+    free(glyphTable);
+    FT_Done_Face(face);
+}
 
+///
+/// Get font, creates it on first use.
+///
+/// Called by the drawing commands on creation, FT_New_Face() and
+/// FT_Done_Face() must be serialized with the OpenGL thread.
+///
 cOglFont *cOglFont::Get(const char *name, int charHeight) {
+    cMutexLock lock(&fontsMutex);
+
     if (!fonts)
         Init();
 
@@ -352,6 +573,8 @@ void cOglFont::Init(void) {
 }
 
 void cOglFont::Cleanup(void) {
+    cMutexLock lock(&fontsMutex);
+
     if (!initiated)
         return;
     delete fonts;
@@ -364,18 +587,125 @@ void cOglFont::Cleanup(void) {
     ftLib = 0;
 }
 
-cOglGlyph *cOglFont::Glyph(FT_ULong charCode) const {
+///
+/// Lookup glyph in the hash table (open addressing, linear probing).
+///
+cOglGlyph *cOglFont::LookupGlyph(FT_ULong charCode) const {
+    if (!glyphTableSize)
+        return NULL;
+    for (int i = (charCode * 0x9E3779B1U) & (glyphTableSize - 1); glyphTable[i]; i = (i + 1) & (glyphTableSize - 1)) {
+        if (glyphTable[i]->CharCode() == charCode)
+            return glyphTable[i];
+    }
+    return NULL;
+}
+
+void cOglFont::InsertGlyph(cOglGlyph *glyph) {
+    int i;
+
+    // keep load factor below 1/2
+    if ((glyphCache.Count() + 1) * 2 > glyphTableSize) {
+        cOglGlyph **old = glyphTable;
+        int oldSize = glyphTableSize;
+
+        glyphTableSize = glyphTableSize ? glyphTableSize * 2 : 256;
+        glyphTable = (cOglGlyph **)calloc(glyphTableSize, sizeof(*glyphTable));
+        if (!glyphTable) {
+            esyslog("[softhddev]out of memory for glyph cache\n");
+            glyphTable = old;
+            glyphTableSize = oldSize;
+            glyphCache.Ins(glyph);
+            return;
+        }
+        for (int j = 0; j < oldSize; j++) {
+            if (!old[j])
+                continue;
+            for (i = (old[j]->CharCode() * 0x9E3779B1U) & (glyphTableSize - 1); glyphTable[i];
+                 i = (i + 1) & (glyphTableSize - 1))
+                ;
+            glyphTable[i] = old[j];
+        }
+        free(old);
+    }
+    for (i = (glyph->CharCode() * 0x9E3779B1U) & (glyphTableSize - 1); glyphTable[i];
+         i = (i + 1) & (glyphTableSize - 1))
+        ;
+    glyphTable[i] = glyph;
+    glyphCache.Ins(glyph); // most recently used first
+}
+
+///
+/// Remove glyph from the hash table.
+///
+/// Following entries of the probe sequence are moved back, so no
+/// tombstones are needed.
+///
+void cOglFont::RemoveGlyph(cOglGlyph *glyph) {
+    int mask = glyphTableSize - 1;
+    int i;
+    int j;
+
+    if (!glyphTableSize)
+        return;
+    for (i = (glyph->CharCode() * 0x9E3779B1U) & mask; glyphTable[i] != glyph; i = (i + 1) & mask) {
+        if (!glyphTable[i])
+            return;
+    }
+    for (j = (i + 1) & mask; glyphTable[j]; j = (j + 1) & mask) {
+        int k = (glyphTable[j]->CharCode() * 0x9E3779B1U) & mask;
+
+        // entry can't be moved, if its home slot is cyclic in (i, j]
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        glyphTable[i] = glyphTable[j];
+        i = j;
+    }
+    glyphTable[i] = NULL;
+}
+
+///
+/// Drop least recently used glyph.
+///
+void cOglFont::EvictGlyph(void) {
+    cOglGlyph *glyph = glyphCache.Last();
+
+    if (!glyph)
+        return;
+    RemoveGlyph(glyph);
+    atlas.Release(glyph->Cell());
+    glyphCache.Del(glyph);
+}
+
+///
+/// Check if loading the glyph drops cached glyphs and reuses their atlas cells.
+///
+bool cOglFont::Evicts(FT_ULong charCode) const {
+    if (charCode == 0xA0)
+        charCode = 0x20;
+    return !LookupGlyph(charCode) && glyphCache.Count() &&
+           (glyphCache.Count() >= OGL_GLYPH_CACHE_MAX || atlas.Full());
+}
+
+cOglGlyph *cOglFont::Glyph(FT_ULong charCode) {
     // Non-breaking space:
     if (charCode == 0xA0)
         charCode = 0x20;
 
     // Lookup in cache:
-    for (cOglGlyph *g = glyphCache.First(); g; g = glyphCache.Next(g)) {
-        if (g->CharCode() == charCode) {
-            return g;
+    cOglGlyph *g = LookupGlyph(charCode);
+
+    if (g) {
+        if (g != glyphCache.First()) { // move to front of LRU list
+            glyphCache.Del(g, false);
+            glyphCache.Ins(g);
         }
+        return g;
     }
 
+    // make room for the new glyph
+    while (glyphCache.Count() && (glyphCache.Count() >= OGL_GLYPH_CACHE_MAX || atlas.Full()))
+        EvictGlyph();
+
     FT_UInt glyph_index = FT_Get_Char_Index(face, charCode);
 
     FT_Int32 loadFlags = FT_LOAD_NO_BITMAP;
@@ -421,9 +751,9 @@ cOglGlyph *cOglFont::Glyph(FT_ULong charCode) const {
         return NULL;
     }
 
-    cOglGlyph *Glyph = new cOglGlyph(charCode, (FT_BitmapGlyph)ftGlyph);
+    cOglGlyph *Glyph = new cOglGlyph(charCode, (FT_BitmapGlyph)ftGlyph, &atlas);
 
-    glyphCache.Add(Glyph);
+    InsertGlyph(Glyph);
     FT_Done_Glyph(ftGlyph);
 
     return Glyph;
@@ -581,6 +911,7 @@ cOglVb::cOglVb(int type) {
     sizeVertex1 = 0;
     sizeVertex2 = 0;
     numVertices = 0;
+    maxVertices = 0;
     drawMode = 0;
 }
 
@@ -630,6 +961,7 @@ bool cOglVb::Init(void) {
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * (sizeVertex1 + sizeVertex2) * numVertices, NULL, GL_DYNAMIC_DRAW);
+    maxVertices = numVertices;
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, sizeVertex1, GL_FLOAT, GL_FALSE, (sizeVertex1 + sizeVertex2) * sizeof(GLfloat),
@@ -678,7 +1010,13 @@ void cOglVb::SetVertexData(GLfloat *vertices, int count) {
     if (count == 0)
         count = numVertices;
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * (sizeVertex1 + sizeVertex2) * count, vertices);
+    if (count > maxVertices) { // batched text, grow buffer
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * (sizeVertex1 + sizeVertex2) * count, vertices,
+                     GL_DYNAMIC_DRAW);
+        maxVertices = count;
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * (sizeVertex1 + sizeVertex2) * count, vertices);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -689,9 +1027,258 @@ void cOglVb::DrawArrays(int count) {
     glFlush();
 }
 
+/****************************************************************************************
+ * cOglReadback
+ ****************************************************************************************/
+static cOglReadback *Readback;
+
+extern unsigned char *posd;
+
+///
+/// Monotonic time in us.
+///
+static uint64_t OglTimeUs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+cOglReadback::cOglReadback(void) {
+    for (int i = 0; i < OGL_READBACK_BUFFERS; i++) {
+        buffers[i].pbo = 0;
+        buffers[i].size = 0;
+        buffers[i].fence = 0;
+    }
+    first = 0;
+    pending = 0;
+    count = 0;
+    last = 0;
+    max = 0;
+    total = 0;
+}
+
+cOglReadback::~cOglReadback(void) {
+    // finish outstanding, posd must get the last state
+    while (pending)
+        Poll(-1);
+    for (int i = 0; i < OGL_READBACK_BUFFERS; i++) {
+        if (buffers[i].pbo)
+            glDeleteBuffers(1, &buffers[i].pbo);
+    }
+    if (count)
+        dsyslog("[softhddev]osd readback: %d flushes, avg %dus, max %dus", count, (int)(total / count), max);
+}
+
+///
+/// Start reading the changed part of the buffer into a pixel buffer object.
+///
+/// The copy into posd is done by Poll(), when the GPU signals the fence.
+///
+/// @param fb	    buffer framebuffer
+/// @param oFb	    output framebuffer
+/// @param x	    osd x position
+/// @param y	    osd y position
+/// @param rect	    changed part, empty for the whole framebuffer
+///
+bool cOglReadback::Start(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y, const cRect &rect) {
+    cRect r = rect.IsEmpty() ? cRect(0, 0, fb->Width(), fb->Height())
+                             : rect.Intersected(cRect(0, 0, fb->Width(), fb->Height()));
+    GLsizeiptr size = (GLsizeiptr)fb->Width() * fb->Height() * 4;
+
+    if (pending == OGL_READBACK_BUFFERS) // all in use, wait for oldest
+        Poll(-1);
+
+    tReadback *rb = &buffers[(first + pending) % OGL_READBACK_BUFFERS];
+
+    if (!rb->pbo)
+        glGenBuffers(1, &rb->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    if (rb->size < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        rb->size = size;
+    }
+    rb->rect = r;
+    rb->width = fb->Width();
+    rb->height = fb->Height();
+    rb->x = x;
+    rb->y = y;
+    rb->texture = oFb->texture;
+    rb->start = OglTimeUs();
+
+    if (!r.IsEmpty()) {
+        GLint y0 = fb->Height() - r.Y() - r.Height();
+
+        fb->BindRead();
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_PACK_ROW_LENGTH, fb->Width());
+        glReadPixels(r.X(), y0, r.Width(), r.Height(), GL_RGBA, GL_UNSIGNED_BYTE,
+                     (GLvoid *)(intptr_t)((y0 * fb->Width() + r.X()) * 4));
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    if (!rb->fence)
+        return false;
+    pending++;
+    return true;
+}
+
+///
+/// Copy a finished readback into posd and show it.
+///
+/// OSDMutex is only held for the copy of the changed rows, not while
+/// the GPU is working.
+///
+void cOglReadback::Finish(tReadback *rb) {
+    const cRect &r = rb->rect;
+
+    glDeleteSync(rb->fence);
+    rb->fence = 0;
+    if (!r.IsEmpty()) {
+        GLint y0 = rb->height - r.Y() - r.Height();
+        GLintptr offset = (GLintptr)y0 * rb->width * 4;
+        GLsizeiptr length = (GLsizeiptr)r.Height() * rb->width * 4;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+        const uint8_t *src = (const uint8_t *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset, length, GL_MAP_READ_BIT);
+
+        if (src) {
+            pthread_mutex_lock(&OSDMutex);
+            if (posd) {
+                for (int i = 0; i < r.Height(); i++) {
+                    memcpy(posd + ((y0 + i) * rb->width + r.X()) * 4, src + (i * rb->width + r.X()) * 4,
+                           r.Width() * 4);
+                }
+            }
+            pthread_mutex_unlock(&OSDMutex);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            esyslog("[softhddev]osd readback: can't map pixel buffer\n");
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    ActivateOsd(rb->texture, rb->x, rb->y, rb->width, rb->height);
+
+    int latency = OglTimeUs() - rb->start;
+
+    count++;
+    last = latency;
+    total += latency;
+    if (latency > max)
+        max = latency;
+}
+
+///
+/// Finish readbacks, whose GPU work is done.
+///
+/// @param timeout  ms to wait for the oldest readback, -1 wait until done
+///
+void cOglReadback::Poll(int timeout) {
+    while (pending) {
+        tReadback *rb = &buffers[first];
+        GLuint64 ns = timeout < 0 ? 1000ULL * 1000 * 1000 : (GLuint64)timeout * 1000 * 1000;
+        GLenum ret = glClientWaitSync(rb->fence, GL_SYNC_FLUSH_COMMANDS_BIT, ns);
+
+        if (ret == GL_TIMEOUT_EXPIRED) {
+            if (timeout < 0) // GPU hangs?
+                esyslog("[softhddev]osd readback: timeout\n");
+            else
+                return;
+        }
+        if (ret == GL_WAIT_FAILED)
+            esyslog("[softhddev]osd readback: wait failed\n");
+        Finish(rb);
+        first = (first + 1) % OGL_READBACK_BUFFERS;
+        pending--;
+        timeout = 0; // only wait for the first
+    }
+}
+
+///
+/// Get readback statistics.
+///
+/// @param[out] count	number of finished readbacks
+/// @param[out] last	latency of last readback in us
+/// @param[out] avg	average latency in us
+/// @param[out] max	maximal latency in us
+///
+void cOglReadback::GetStats(int *count, int *last, int *avg, int *max) const {
+    *count = this->count;
+    *last = this->last;
+    *avg = this->count ? (int)(total / this->count) : 0;
+    *max = this->max;
+}
+
 /****************************************************************************************
  * cOpenGLCmd
  ****************************************************************************************/
+
+//------------------ command arena --------------------
+// Commands are created by the VDR threads and deleted by the OpenGL
+// thread, the fixed size slots avoid a malloc/free pair for each.
+
+#define OGL_CMD_SLOT_SIZE 128                 ///< bytes for one command
+#define OGL_CMD_SLOTS (2 * OGL_CMDQUEUE_SIZE) ///< queued + in construction
+
+union tOglCmdSlot {
+    union tOglCmdSlot *next;
+    double align;
+    char data[OGL_CMD_SLOT_SIZE];
+};
+
+static tOglCmdSlot OglCmdSlots[OGL_CMD_SLOTS];
+static tOglCmdSlot *OglCmdFreeSlots;
+static int OglCmdUsedSlots;
+static cMutex OglCmdMutex;
+
+void *cOglCmd::operator new(size_t size) {
+    if (size <= sizeof(tOglCmdSlot)) {
+        cMutexLock lock(&OglCmdMutex);
+        tOglCmdSlot *slot = OglCmdFreeSlots;
+
+        if (slot) {
+            OglCmdFreeSlots = slot->next;
+            return slot;
+        }
+        if (OglCmdUsedSlots < OGL_CMD_SLOTS)
+            return &OglCmdSlots[OglCmdUsedSlots++];
+    }
+    // too big or arena exhausted
+    return ::operator new(size);
+}
+
+void cOglCmd::operator delete(void *cmd) {
+    tOglCmdSlot *slot = (tOglCmdSlot *)cmd;
+
+    if (slot >= OglCmdSlots && slot < OglCmdSlots + OGL_CMD_SLOTS) {
+        cMutexLock lock(&OglCmdMutex);
+
+        slot->next = OglCmdFreeSlots;
+        OglCmdFreeSlots = slot;
+        return;
+    }
+    ::operator delete(cmd);
+}
+
+
+///
+/// Restrict drawing into framebuffer to a rectangle.
+///
+/// @param fb	framebuffer
+/// @param clip	rectangle in OSD coordinates (top left origin), empty for no
+/// restriction
+///
+static void SetScissor(cOglFb *fb, const cRect &clip) {
+    if (clip.IsEmpty()) {
+        glDisable(GL_SCISSOR_TEST);
+        return;
+    }
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(clip.X(), fb->Height() - clip.Y() - clip.Height(), clip.Width(), clip.Height());
+}
+
 //------------------ cOglCmdInitOutputFb --------------------
 cOglCmdInitOutputFb::cOglCmdInitOutputFb(cOglOutputFb *oFb) : cOglCmd(NULL) { this->oFb = oFb; }
 
@@ -726,8 +1313,9 @@ bool cOglCmdDeleteFb::Execute(void) {
 
 //------------------ cOglCmdRenderFbToBufferFb --------------------
 cOglCmdRenderFbToBufferFb::cOglCmdRenderFbToBufferFb(cOglFb *fb, cOglFb *buffer, GLint x, GLint y, GLint transparency,
-                                                     GLint drawPortX, GLint drawPortY, bool alphablending)
-    : cOglCmd(fb) {
+                                                     GLint drawPortX, GLint drawPortY, bool alphablending,
+                                                     const cRect &clip)
+    : cOglCmd(fb), clip(clip) {
     this->buffer = buffer;
     this->x = (GLfloat)x;
     this->y = (GLfloat)y;
@@ -774,6 +1362,7 @@ bool cOglCmdRenderFbToBufferFb::Execute(void) {
 
     if (!fb->BindTexture())
         return false;
+    SetScissor(buffer, clip);
     if (!alphablending)
         VertexBuffers[vbTexture]->DisableBlending();
     VertexBuffers[vbTexture]->Bind();
@@ -782,30 +1371,67 @@ bool cOglCmdRenderFbToBufferFb::Execute(void) {
     VertexBuffers[vbTexture]->Unbind();
     if (!alphablending)
         VertexBuffers[vbTexture]->EnableBlending();
+    SetScissor(buffer, cRect::Null);
     buffer->Unbind();
 
     return true;
 }
 
 //------------------ cOglCmdCopyBufferToOutputFb --------------------
-cOglCmdCopyBufferToOutputFb::cOglCmdCopyBufferToOutputFb(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y)
-    : cOglCmd(fb) {
+cOglCmdCopyBufferToOutputFb::cOglCmdCopyBufferToOutputFb(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y,
+                                                         const cRect &damage)
+    : cOglCmd(fb), damage(damage) {
     this->oFb = oFb;
     this->x = x;
     this->y = y;
 }
 
-extern unsigned char *posd;
+///
+/// Merge an older, still queued copy of the same buffer.
+///
+/// The intermediate state is never shown, the readback of the union of
+/// both changed areas gives the same final picture.
+///
+bool cOglCmdCopyBufferToOutputFb::Merge(cOglCmd *cmd) {
+    cOglCmdCopyBufferToOutputFb *copy = dynamic_cast<cOglCmdCopyBufferToOutputFb *>(cmd);
+
+    if (!copy || copy->fb != fb || copy->oFb != oFb || copy->x != x || copy->y != y)
+        return false;
+    if (damage.IsEmpty() || copy->damage.IsEmpty()) // one is full
+        damage = cRect::Null;
+    else
+        damage.Combine(copy->damage);
+    return true;
+}
 
 bool cOglCmdCopyBufferToOutputFb::Execute(void) {
 
+    if (Readback && Readback->Start(fb, oFb, x, y, damage))
+        return true;
+
+    // synchronous fallback
+    if (Readback)
+        Readback->Poll(-1);
     pthread_mutex_lock(&OSDMutex);
     fb->BindRead();
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    if (posd)
-        glReadPixels(0, 0, fb->Width(), fb->Height(), GL_RGBA, GL_UNSIGNED_BYTE, posd);
+    if (posd) {
+        cRect r = damage.Intersected(cRect(0, 0, fb->Width(), fb->Height()));
+
+        if (damage.IsEmpty()) {
+            glReadPixels(0, 0, fb->Width(), fb->Height(), GL_RGBA, GL_UNSIGNED_BYTE, posd);
+        } else if (!r.IsEmpty()) {
+            // only the changed part, posd keeps the rest of the last flush
+            GLint y0 = fb->Height() - r.Y() - r.Height();
+
+            glPixelStorei(GL_PACK_ROW_LENGTH, fb->Width());
+            glReadPixels(r.X(), y0, r.Width(), r.Height(), GL_RGBA, GL_UNSIGNED_BYTE,
+                         posd + (y0 * fb->Width() + r.X()) * 4);
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        }
+    }
     glFlush();
 
     pthread_mutex_unlock(&OSDMutex);
@@ -814,14 +1440,34 @@ bool cOglCmdCopyBufferToOutputFb::Execute(void) {
 }
 
 //------------------ cOglCmdFill --------------------
-cOglCmdFill::cOglCmdFill(cOglFb *fb, GLint color) : cOglCmd(fb) { this->color = color; }
+cOglCmdFill::cOglCmdFill(cOglFb *fb, GLint color, const cRect &clip) : cOglCmd(fb), clip(clip) {
+    this->color = color;
+}
+
+cRect cOglCmdFill::Bounds(void) { return clip.IsEmpty() ? cRect(0, 0, fb->Width(), fb->Height()) : clip; }
+
+///
+/// Fill overwrites everything drawn before into its area.
+///
+bool cOglCmdFill::Covers(cOglCmd *cmd) {
+    if (cmd->Target() != fb)
+        return false;
+    if (clip.IsEmpty())
+        return true;
+
+    cRect r = cmd->Bounds();
+
+    return !r.IsEmpty() && clip.Contains(r);
+}
 
 bool cOglCmdFill::Execute(void) {
     glm::vec4 col;
     ConvertColor(color, col);
     fb->Bind();
+    SetScissor(fb, clip);
     glClearColor(col.r, col.g, col.b, col.a);
     glClear(GL_COLOR_BUFFER_BIT);
+    SetScissor(fb, cRect::Null);
     fb->Unbind();
     return true;
 }
@@ -1166,26 +1812,44 @@ bool cOglCmdDrawSlope::Execute(void) {
 }
 
 //------------------ cOglCmdDrawText --------------------
+///
+/// Draw the queued glyph quads of one atlas page.
+///
+static void DrawTextQuads(GLuint texture, GLfloat *vertices, int count) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    VertexBuffers[vbText]->SetVertexData(vertices, count);
+    VertexBuffers[vbText]->DrawArrays(count);
+}
+
 cOglCmdDrawText::cOglCmdDrawText(cOglFb *fb, GLint x, GLint y, unsigned int *symbols, GLint limitX, const char *name,
                                  int fontSize, tColor colorText)
-    : cOglCmd(fb), fontName(name) {
+    : cOglCmd(fb) {
     this->x = x;
     this->y = y;
     this->limitX = limitX;
     this->colorText = colorText;
-    this->fontSize = fontSize;
     this->symbols = symbols;
-    this->fontName = name;
+    // resolve once here, fonts live until the OpenGL thread ends
+    font = cOglFont::Get(name, fontSize);
 }
 
 cOglCmdDrawText::~cOglCmdDrawText(void) { free(symbols); }
 
 bool cOglCmdDrawText::Execute(void) {
-    cOglFont *f = cOglFont::Get(*fontName, fontSize);
+    cOglFont *f = font;
 
     if (!f || !symbols[0])
         return false;
 
+    int n = 0;
+
+    while (symbols[n])
+        n++;
+    // 6 vertices of 4 floats for each glyph, all drawn at once
+    GLfloat *vertices = new GLfloat[n * 24];
+    GLfloat *v = vertices;
+    GLuint texture = 0;
+
     VertexBuffers[vbText]->ActivateShader();
     VertexBuffers[vbText]->SetShaderColor(colorText);
     VertexBuffers[vbText]->SetShaderProjectionMatrix(fb->Width(), fb->Height());
@@ -1202,10 +1866,16 @@ bool cOglCmdDrawText::Execute(void) {
 
     for (int i = 0; symbols[i]; i++) {
         sym = symbols[i];
+        // new glyph may take the atlas cell of a queued one, draw what we have
+        if (v != vertices && f->Evicts(sym)) {
+            DrawTextQuads(texture, vertices, (v - vertices) / 4);
+            v = vertices;
+        }
         cOglGlyph *g = f->Glyph(sym);
 
         if (!g) {
             esyslog("[softhddev]ERROR: could not load glyph %lx", sym);
+            continue;
         }
 
         if (limitX && xGlyph + g->AdvanceX() > limitX) {
@@ -1215,33 +1885,47 @@ bool cOglCmdDrawText::Execute(void) {
         kerning = f->Kerning(g, prevSym);
         prevSym = sym;
 
-        GLfloat x1 = xGlyph + kerning + g->BearingLeft();         // left
-        GLfloat y1 = y + (fontHeight - bottom - g->BearingTop()); // top
-        GLfloat x2 = x1 + g->Width();                             // right
-        GLfloat y2 = y1 + g->Height();                            // bottom
-
-        GLfloat vertices[] = {
-            x1, y2, 0.0, 1.0, // left bottom
-            x1, y1, 0.0, 0.0, // left top
-            x2, y1, 1.0, 0.0, // right top
-
-            x1, y2, 0.0, 1.0, // left bottom
-            x2, y1, 1.0, 0.0, // right top
-            x2, y2, 1.0, 1.0  // right bottom
-        };
-
-        g->BindTexture();
-        VertexBuffers[vbText]->SetVertexData(vertices);
-        VertexBuffers[vbText]->DrawArrays();
+        if (g->Width() && g->Height()) {
+            // glyph on another atlas page, draw what we have
+            if (texture != g->Texture() && v != vertices) {
+                DrawTextQuads(texture, vertices, (v - vertices) / 4);
+                v = vertices;
+            }
+            texture = g->Texture();
+
+            GLfloat x1 = xGlyph + kerning + g->BearingLeft();         // left
+            GLfloat y1 = y + (fontHeight - bottom - g->BearingTop()); // top
+            GLfloat x2 = x1 + g->Width();                             // right
+            GLfloat y2 = y1 + g->Height();                            // bottom
+            const GLfloat *t = g->TexCoords();
+
+            GLfloat quad[] = {
+                x1, y2, t[0], t[3], // left bottom
+                x1, y1, t[0], t[1], // left top
+                x2, y1, t[2], t[1], // right top
+
+                x1, y2, t[0], t[3], // left bottom
+                x2, y1, t[2], t[1], // right top
+                x2, y2, t[2], t[3]  // right bottom
+            };
+
+            memcpy(v, quad, sizeof(quad));
+            v += 24;
+        }
 
         xGlyph += kerning + g->AdvanceX();
 
         if (xGlyph > fb->Width() - 1)
             break;
     }
+    if (v != vertices) {
+        DrawTextQuads(texture, vertices, (v - vertices) / 4);
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
     VertexBuffers[vbText]->Unbind();
     fb->Unbind();
+
+    delete[] vertices;
     return true;
 }
 
@@ -1417,13 +2101,14 @@ bool cOglCmdDropImage::Execute(void) {
  * cOglThread
  ******************************************************************************/
 cOglThread::cOglThread(cCondWait *startWait, int maxCacheSize) : cThread("oglThread") {
-    stalled = false;
     memCached = 0;
 
     this->maxCacheSize = maxCacheSize * 1024 * 1024;
     this->startWait = startWait;
-    wait = new cCondWait();
+    cmdFirst = 0;
+    cmdCount = 0;
     maxTextureSize = 0;
+    cpuClockValid = false;
     for (int i = 0; i < OGL_MAX_OSDIMAGES; i++) {
         imageCache[i].used = false;
         imageCache[i].texture = GL_NONE;
@@ -1435,9 +2120,12 @@ cOglThread::cOglThread(cCondWait *startWait, int maxCacheSize) : cThread("oglThr
 }
 
 cOglThread::~cOglThread() {
-    delete wait;
-
-    wait = NULL;
+    // commands never executed
+    while (cmdCount) {
+        delete commands[cmdFirst];
+        cmdFirst = (cmdFirst + 1) % OGL_CMDQUEUE_SIZE;
+        cmdCount--;
+    }
 }
 
 void cOglThread::Stop(void) {
@@ -1447,27 +2135,56 @@ void cOglThread::Stop(void) {
         }
     }
     Cancel(2);
-    stalled = false;
 }
 
-void cOglThread::DoCmd(cOglCmd *cmd) {
-    while (stalled)
-        cCondWait::SleepMs(10);
-
-    bool doSignal = false;
+///
+/// Drop or merge queued commands made redundant by a new command.
+///
+/// Commands at the end of the queue, which only draw into an area the
+/// new command overwrites, are dropped.  An older copy of the same buffer
+/// to the output is merged into the new one.
+///
+/// @note must be called with cmdMutex locked.
+///
+void cOglThread::Coalesce(cOglCmd *cmd) {
+    while (cmdCount) {
+        int last = (cmdFirst + cmdCount - 1) % OGL_CMDQUEUE_SIZE;
 
-    Lock();
-    if (commands.size() == 0)
-        doSignal = true;
-    commands.push(cmd);
-    Unlock();
+        if (commands[last] && !cmd->Covers(commands[last]))
+            break;
+        delete commands[last];
+        cmdCount--;
+    }
+    for (int i = 0; i < cmdCount; i++) {
+        int n = (cmdFirst + i) % OGL_CMDQUEUE_SIZE;
 
-    if (commands.size() > OGL_CMDQUEUE_SIZE) {
-        stalled = true;
+        if (commands[n] && cmd->Merge(commands[n])) {
+            delete commands[n];
+            commands[n] = NULL; // skipped by Action()
+        }
     }
+}
 
-    if (doSignal || stalled)
-        wait->Signal();
+///
+/// Queue a command for the OpenGL thread.
+///
+/// Blocks while the queue is full.
+///
+void cOglThread::DoCmd(cOglCmd *cmd) {
+    cMutexLock lock(&cmdMutex);
+
+    while (cmdCount >= OGL_CMDQUEUE_SIZE) {
+        if (!Active()) {
+            esyslog("[softhddev]OpenGL thread not running, %s dropped", cmd->Description());
+            delete cmd;
+            return;
+        }
+        cmdCond.TimedWait(cmdMutex, 100);
+    }
+    Coalesce(cmd);
+    commands[(cmdFirst + cmdCount) % OGL_CMDQUEUE_SIZE] = cmd;
+    cmdCount++;
+    cmdCond.Broadcast();
 }
 
 int cOglThread::StoreImage(const cImage &image) {
@@ -1587,7 +2304,17 @@ void cOglThread::DropImageData(int imageHandle) {
     ClearSlot(imageHandle);
 }
 
+long cOglThread::CpuTime(void) {
+    struct timespec tspec;
+
+    if (!cpuClockValid || clock_gettime(cpuClock, &tspec))
+        return -1;
+    return tspec.tv_sec * 1000 + tspec.tv_nsec / (1000 * 1000);
+}
+
 void cOglThread::Action(void) {
+    cpuClockValid = !pthread_getcpuclockid(pthread_self(), &cpuClock);
+
     if (!InitOpenGL()) {
         esyslog("[softhddev]Could not initiate OpenGL Context");
         Cleanup();
@@ -1620,37 +2347,44 @@ void cOglThread::Action(void) {
     }
     dsyslog("[softhddev]Vertex buffers initialized");
 
+    Readback = new cOglReadback();
+
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
     dsyslog("[softhddev]Maximum Pixmap size: %dx%dpx", maxTextureSize, maxTextureSize);
 
     // now Thread is ready to do his job
     startWait->Signal();
-    stalled = false;
 
     while (Running()) {
+        cOglCmd *cmd = NULL;
+
+        cmdMutex.Lock();
+        // idle, wait for outstanding osd readbacks below
+        if (!cmdCount && !Readback->Pending())
+            cmdCond.TimedWait(cmdMutex, 20);
+        if (cmdCount) {
+            cmd = commands[cmdFirst];
+            cmdFirst = (cmdFirst + 1) % OGL_CMDQUEUE_SIZE;
+            cmdCount--;
+            cmdCond.Broadcast();
+        }
+        cmdMutex.Unlock();
 
-        if (commands.empty()) {
-            wait->Wait(20);
+        if (!cmd) {
+            Readback->Poll(2);
             continue;
         }
-
-        Lock();
-        cOglCmd *cmd = commands.front();
-
-        commands.pop();
-        Unlock();
         // uint64_t start = cTimeMs::Now();
         cmd->Execute();
         // esyslog("[softhddev]\"%s\", %dms, %d commands left, time %" PRIu64 "",
-        // cmd->Description(), (int)(cTimeMs::Now() - start), commands.size(),
+        // cmd->Description(), (int)(cTimeMs::Now() - start), cmdCount,
         // cTimeMs::Now());
         delete cmd;
-
-        if (stalled && commands.size() < OGL_CMDQUEUE_SIZE / 2)
-            stalled = false;
+        Readback->Poll(0);
     }
 
     dsyslog("[softhddev]Cleaning up OpenGL stuff");
+    cpuClockValid = false;
     Cleanup();
     dsyslog("[softhddev]OpenGL Worker Thread Ended");
 }
@@ -1752,6 +2486,10 @@ void cOglThread::DeleteVertexBuffers(void) {
 
 void cOglThread::Cleanup(void) {
     esyslog("[softhddev]OglThread cleanup\n");
+    // finishes outstanding readbacks, which take OSDMutex
+    delete Readback;
+
+    Readback = NULL;
     pthread_mutex_lock(&OSDMutex);
     OsdClose();
 
@@ -2020,6 +2758,7 @@ void cOglPixmap::Pan(const cPoint &Dest, const cRect &Source) {
  * cOglOsd
  ******************************************************************************/
 cOglOutputFb *cOglOsd::oFb = NULL;
+cOglOsd *cOglOsd::lastFlushed = NULL;
 
 cOglOsd::cOglOsd(int Left, int Top, uint Level, std::shared_ptr<cOglThread> oglThread) : cOsd(Left, Top, Level) {
     this->oglThread = oglThread;
@@ -2050,6 +2789,8 @@ cOglOsd::cOglOsd(int Left, int Top, uint Level, std::shared_ptr<cOglThread> oglT
 }
 
 cOglOsd::~cOglOsd() {
+    if (lastFlushed == this)
+        lastFlushed = NULL;
     OsdClose();
     SetActive(false);
 
@@ -2072,6 +2813,7 @@ eOsdError cOglOsd::SetAreas(const tArea *Areas, int NumAreas) {
         DestroyPixmap(oglPixmaps[0]);
     }
     bFb = new cOglFb(r.Width(), r.Height(), r.Width(), r.Height());
+    damage = cRect(0, 0, r.Width(), r.Height()); // new buffer, redraw all
     cCondWait initiated;
 
     oglThread->DoCmd(new cOglCmdInitFb(bFb, &initiated));
@@ -2134,8 +2876,10 @@ void cOglOsd::DestroyPixmap(cPixmap *Pixmap) {
         start = 0;
     for (int i = start; i < oglPixmaps.Size(); i++) {
         if (oglPixmaps[i] == Pixmap) {
-            if (Pixmap->Layer() >= 0)
+            if (Pixmap->Layer() >= 0) {
                 oglPixmaps[0]->SetDirty();
+                damage.Combine(Pixmap->ViewPort());
+            }
             oglPixmaps[i] = NULL;
             cOsd::DestroyPixmap(Pixmap);
             return;
@@ -2147,19 +2891,26 @@ void cOglOsd::Flush(void) {
     if (!oglThread->Active())
         return;
     LOCK_PIXMAPS;
-    // check if any pixmap is dirty
-    bool dirty = false;
-
-    for (int i = 0; i < oglPixmaps.Size() && !dirty; i++)
-        if (oglPixmaps[i] && oglPixmaps[i]->Layer() >= 0 && oglPixmaps[i]->IsDirty())
-            dirty = true;
-    if (!dirty)
+    // collect changed areas of all pixmaps
+    for (int i = 0; i < oglPixmaps.Size(); i++) {
+        if (!oglPixmaps[i])
+            continue;
+        damage.Combine(oglPixmaps[i]->DirtyViewPort());
+        // dirty without known area
+        if (oglPixmaps[i]->Layer() >= 0 && oglPixmaps[i]->IsDirty() && oglPixmaps[i]->DirtyViewPort().IsEmpty())
+            damage.Combine(oglPixmaps[i]->ViewPort());
+    }
+    // pixmaps are moved to the top or the readback buffer holds another osd
+    if (!damage.IsEmpty() && (isSubtitleOsd || lastFlushed != this))
+        damage = cRect(0, 0, bFb->Width(), bFb->Height());
+    damage = damage.Intersected(cRect(0, 0, bFb->Width(), bFb->Height()));
+    if (damage.IsEmpty())
         return;
-    // clear buffer
     // uint64_t start = cTimeMs::Now();
     // dsyslog("[softhddev]Start Flush at %" PRIu64 "", cTimeMs::Now());
 
-    oglThread->DoCmd(new cOglCmdFill(bFb, clrTransparent));
+    // clear changed part of buffer
+    oglThread->DoCmd(new cOglCmdFill(bFb, clrTransparent, damage));
 
     // render pixmap textures blended to buffer
     for (int layer = 0; layer < MAXPIXMAPLAYERS; layer++) {
@@ -2168,16 +2919,22 @@ void cOglOsd::Flush(void) {
                 if (oglPixmaps[i]->Layer() == layer) {
                     bool alphablending =
                         layer == 0 ? false : true; // Decide wether to render (with alpha) or copy a pixmap
-                    oglThread->DoCmd(new cOglCmdRenderFbToBufferFb(
-                        oglPixmaps[i]->Fb(), bFb, oglPixmaps[i]->ViewPort().X(),
-                        (!isSubtitleOsd) ? oglPixmaps[i]->ViewPort().Y() : 0, oglPixmaps[i]->Alpha(),
-                        oglPixmaps[i]->DrawPort().X(), oglPixmaps[i]->DrawPort().Y(), alphablending));
-                    oglPixmaps[i]->SetDirty(false);
+                    if (isSubtitleOsd || oglPixmaps[i]->ViewPort().Intersects(damage))
+                        oglThread->DoCmd(new cOglCmdRenderFbToBufferFb(
+                            oglPixmaps[i]->Fb(), bFb, oglPixmaps[i]->ViewPort().X(),
+                            (!isSubtitleOsd) ? oglPixmaps[i]->ViewPort().Y() : 0, oglPixmaps[i]->Alpha(),
+                            oglPixmaps[i]->DrawPort().X(), oglPixmaps[i]->DrawPort().Y(), alphablending, damage));
                 }
             }
         }
     }
-    oglThread->DoCmd(new cOglCmdCopyBufferToOutputFb(bFb, oFb, Left(), Top()));
+    for (int i = 0; i < oglPixmaps.Size(); i++) {
+        if (oglPixmaps[i])
+            oglPixmaps[i]->SetDirty(false);
+    }
+    oglThread->DoCmd(new cOglCmdCopyBufferToOutputFb(bFb, oFb, Left(), Top(), damage));
+    damage = cRect::Null;
+    lastFlushed = this;
 
     // dsyslog("[softhddev]End Flush at %" PRIu64 ", duration %d", cTimeMs::Now(),
     // (int)(cTimeMs::Now()-start));
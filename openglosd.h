@@ -28,7 +28,6 @@ const struct
 } FT_Errors[] =
 #include FT_ERRORS_H
 #include <memory>
-#include <queue>
 #include <vdr/plugin.h>
 #include <vdr/osd.h>
 #include <vdr/thread.h>
@@ -83,19 +82,43 @@ class cShader {
     void SetMatrix4(const GLchar *name, const glm::mat4 &matrix);
 };
 
+/****************************************************************************************
+ * cOglGlyphAtlas
+ * Texture pages shared by all glyphs of one font, split into cells of equal size
+ ****************************************************************************************/
+#define OGL_GLYPH_ATLAS_SIZE 1024
+#define OGL_GLYPH_ATLAS_PAGES 4
+#define OGL_GLYPH_CACHE_MAX 2048
+
+class cOglGlyphAtlas {
+  private:
+    GLint size;
+    GLint cellWidth, cellHeight;
+    int cellsPerRow;
+    int cellsPerPage;
+    cVector<GLuint> pages;
+    cVector<int> freeCells;
+    int nextCell;
+    bool Setup(void);
+    bool NewPage(void);
+
+  public:
+    cOglGlyphAtlas(void);
+    virtual ~cOglGlyphAtlas(void);
+    void SetCellSize(GLint width, GLint height);
+    bool Full(void) const;
+    int Insert(FT_BitmapGlyph ftGlyph, GLuint &texture, GLfloat *texCoords);
+    void Release(int cell);
+};
+
 /****************************************************************************************
  * cOglGlyph
  ****************************************************************************************/
 class cOglGlyph : public cListObject {
   private:
     struct tKerning {
-      public:
-        tKerning(FT_ULong prevSym, GLfloat kerning = 0.0f) {
-            this->prevSym = prevSym;
-            this->kerning = kerning;
-        }
         FT_ULong prevSym;
-        GLfloat kerning;
+        int kerning;
     };
     FT_ULong charCode;
     int bearingLeft;
@@ -104,12 +127,16 @@ class cOglGlyph : public cListObject {
     int height;
     int advanceX;
 
-    cVector<tKerning> kerningCache;
+    tKerning *kerningCache;
+    int kerningSize;
+    int kerningCount;
+    int cell;
     GLuint texture;
+    GLfloat texCoords[4];
     void LoadTexture(FT_BitmapGlyph ftGlyph);
 
   public:
-    cOglGlyph(FT_ULong charCode, FT_BitmapGlyph ftGlyph);
+    cOglGlyph(FT_ULong charCode, FT_BitmapGlyph ftGlyph, cOglGlyphAtlas *atlas);
     virtual ~cOglGlyph();
     FT_ULong CharCode(void) { return charCode; }
     int AdvanceX(void) { return advanceX; }
@@ -119,6 +146,9 @@ class cOglGlyph : public cListObject {
     int Height(void) const { return height; }
     int GetKerningCache(FT_ULong prevSym);
     void SetKerningCache(FT_ULong prevSym, int kerning);
+    int Cell(void) const { return cell; }
+    GLuint Texture(void) const { return texture; }
+    const GLfloat *TexCoords(void) const { return texCoords; }
     void BindTexture(void);
 };
 
@@ -135,9 +165,17 @@ class cOglFont : public cListObject {
     static FT_Library ftLib;
     FT_Face face;
     static cList<cOglFont> *fonts;
-    mutable cList<cOglGlyph> glyphCache;
+    static cMutex fontsMutex;
+    cList<cOglGlyph> glyphCache;
+    cOglGlyph **glyphTable;
+    int glyphTableSize;
+    cOglGlyphAtlas atlas;
     cOglFont(const char *fontName, int charHeight);
     static void Init(void);
+    cOglGlyph *LookupGlyph(FT_ULong charCode) const;
+    void InsertGlyph(cOglGlyph *glyph);
+    void RemoveGlyph(cOglGlyph *glyph);
+    void EvictGlyph(void);
 
   public:
     virtual ~cOglFont(void);
@@ -147,7 +185,8 @@ class cOglFont : public cListObject {
     int Size(void) { return size; };
     int Bottom(void) { return bottom; };
     int Height(void) { return height; };
-    cOglGlyph *Glyph(FT_ULong charCode) const;
+    cOglGlyph *Glyph(FT_ULong charCode);
+    bool Evicts(FT_ULong charCode) const;
     int Kerning(cOglGlyph *glyph, FT_ULong prevSym) const;
 };
 
@@ -222,6 +261,7 @@ class cOglVb {
     int sizeVertex1;
     int sizeVertex2;
     int numVertices;
+    int maxVertices;
     GLuint drawMode;
 
   public:
@@ -240,6 +280,42 @@ class cOglVb {
     void DrawArrays(int count = 0);
 };
 
+/****************************************************************************************
+ * cOglReadback
+ * Asynchronous readback of the OSD buffer into posd with pixel buffer objects
+ ****************************************************************************************/
+#define OGL_READBACK_BUFFERS 3
+
+class cOglReadback {
+  private:
+    struct tReadback {
+        GLuint pbo;
+        GLsizeiptr size;
+        GLsync fence;
+        cRect rect;
+        GLint width, height;
+        GLint x, y;
+        GLuint texture;
+        uint64_t start;
+    };
+    tReadback buffers[OGL_READBACK_BUFFERS];
+    int first;
+    int pending;
+    int count;
+    int last;
+    int max;
+    uint64_t total;
+    void Finish(tReadback *rb);
+
+  public:
+    cOglReadback(void);
+    virtual ~cOglReadback(void);
+    bool Start(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y, const cRect &rect);
+    bool Pending(void) const { return pending > 0; }
+    void Poll(int timeout);
+    void GetStats(int *count, int *last, int *avg, int *max) const;
+};
+
 /****************************************************************************************
  * cOpenGLCmd
  ****************************************************************************************/
@@ -250,8 +326,18 @@ class cOglCmd {
   public:
     cOglCmd(cOglFb *fb) { this->fb = fb; };
     virtual ~cOglCmd(void) {};
+    static void *operator new(size_t size);
+    static void operator delete(void *cmd);
     virtual const char *Description(void) = 0;
     virtual bool Execute(void) = 0;
+    // framebuffer the command only draws into, NULL if it has other effects
+    virtual cOglFb *Target(void) { return NULL; }
+    // area drawn, empty if unknown
+    virtual cRect Bounds(void) { return cRect::Null; }
+    // can the queued command be dropped, because this one overwrites it
+    virtual bool Covers(cOglCmd *cmd) { return false; }
+    // merge a queued command into this one
+    virtual bool Merge(cOglCmd *cmd) { return false; }
 };
 
 class cOglCmdInitOutputFb : public cOglCmd {
@@ -291,36 +377,45 @@ class cOglCmdRenderFbToBufferFb : public cOglCmd {
     GLfloat drawPortX, drawPortY;
     GLint transparency;
     GLint alphablending;
+    cRect clip;
 
   public:
     cOglCmdRenderFbToBufferFb(cOglFb *fb, cOglFb *buffer, GLint x, GLint y, GLint transparency, GLint drawPortX,
-                              GLint drawPortY, bool alphablending);
+                              GLint drawPortY, bool alphablending, const cRect &clip = cRect::Null);
     virtual ~cOglCmdRenderFbToBufferFb(void) {};
     virtual const char *Description(void) { return "Render Framebuffer to Buffer"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return buffer; }
+    virtual cRect Bounds(void) { return clip; }
 };
 
 class cOglCmdCopyBufferToOutputFb : public cOglCmd {
   private:
     cOglOutputFb *oFb;
     GLint x, y;
+    cRect damage;
 
   public:
-    cOglCmdCopyBufferToOutputFb(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y);
+    cOglCmdCopyBufferToOutputFb(cOglFb *fb, cOglOutputFb *oFb, GLint x, GLint y, const cRect &damage = cRect::Null);
     virtual ~cOglCmdCopyBufferToOutputFb(void) {};
     virtual const char *Description(void) { return "Copy buffer to OutputFramebuffer"; }
     virtual bool Execute(void);
+    virtual bool Merge(cOglCmd *cmd);
 };
 
 class cOglCmdFill : public cOglCmd {
   private:
     GLint color;
+    cRect clip;
 
   public:
-    cOglCmdFill(cOglFb *fb, GLint color);
+    cOglCmdFill(cOglFb *fb, GLint color, const cRect &clip = cRect::Null);
     virtual ~cOglCmdFill(void) {};
     virtual const char *Description(void) { return "Fill"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void);
+    virtual bool Covers(cOglCmd *cmd);
 };
 
 class cOglCmdDrawRectangle : public cOglCmd {
@@ -334,6 +429,8 @@ class cOglCmdDrawRectangle : public cOglCmd {
     virtual ~cOglCmdDrawRectangle(void) {};
     virtual const char *Description(void) { return "DrawRectangle"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void) { return cRect(x, y, width, height); }
 };
 
 class cOglCmdDrawEllipse : public cOglCmd {
@@ -351,6 +448,8 @@ class cOglCmdDrawEllipse : public cOglCmd {
     virtual ~cOglCmdDrawEllipse(void) {};
     virtual const char *Description(void) { return "DrawEllipse"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void) { return cRect(x, y, width, height); }
 };
 
 class cOglCmdDrawSlope : public cOglCmd {
@@ -365,6 +464,8 @@ class cOglCmdDrawSlope : public cOglCmd {
     virtual ~cOglCmdDrawSlope(void) {};
     virtual const char *Description(void) { return "DrawSlope"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void) { return cRect(x, y, width, height); }
 };
 
 class cOglCmdDrawText : public cOglCmd {
@@ -372,8 +473,7 @@ class cOglCmdDrawText : public cOglCmd {
     GLint x, y;
     GLint limitX;
     GLint colorText;
-    cString fontName;
-    int fontSize;
+    cOglFont *font;
     unsigned int *symbols;
 
   public:
@@ -382,6 +482,7 @@ class cOglCmdDrawText : public cOglCmd {
     virtual ~cOglCmdDrawText(void);
     virtual const char *Description(void) { return "DrawText"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
 };
 
 class cOglCmdDrawImage : public cOglCmd {
@@ -397,6 +498,8 @@ class cOglCmdDrawImage : public cOglCmd {
     virtual ~cOglCmdDrawImage(void);
     virtual const char *Description(void) { return "Draw Image"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void) { return cRect(x, y, width * scaleX, height * scaleY); }
 };
 
 class cOglCmdDrawTexture : public cOglCmd {
@@ -410,6 +513,8 @@ class cOglCmdDrawTexture : public cOglCmd {
     virtual ~cOglCmdDrawTexture(void) {};
     virtual const char *Description(void) { return "Draw Texture"; }
     virtual bool Execute(void);
+    virtual cOglFb *Target(void) { return fb; }
+    virtual cRect Bounds(void) { return cRect(x, y, imageRef->width * scaleX, imageRef->height * scaleY); }
 };
 
 class cOglCmdStoreImage : public cOglCmd {
@@ -440,18 +545,22 @@ class cOglCmdDropImage : public cOglCmd {
  * cOglThread
  ******************************************************************************/
 #define OGL_MAX_OSDIMAGES 256
-#define OGL_CMDQUEUE_SIZE 100
+#define OGL_CMDQUEUE_SIZE 256
 
 class cOglThread : public cThread {
   private:
     cCondWait *startWait;
-    cCondWait *wait;
-    bool stalled;
-    std::queue<cOglCmd *> commands;
+    cMutex cmdMutex;
+    cCondVar cmdCond;
+    cOglCmd *commands[OGL_CMDQUEUE_SIZE];
+    int cmdFirst;
+    int cmdCount;
     GLint maxTextureSize;
     sOglImage imageCache[OGL_MAX_OSDIMAGES];
     long memCached;
     long maxCacheSize;
+    clockid_t cpuClock;
+    bool cpuClockValid;
     bool InitOpenGL(void);
     bool InitShaders(void);
     void DeleteShaders(void);
@@ -459,6 +568,7 @@ class cOglThread : public cThread {
     bool InitVertexBuffers(void);
     void DeleteVertexBuffers(void);
     void Cleanup(void);
+    void Coalesce(cOglCmd *cmd);
     int GetFreeSlot(void);
     void ClearSlot(int slot);
 
@@ -474,6 +584,8 @@ class cOglThread : public cThread {
     void DropImageData(int imageHandle);
     sOglImage *GetImageRef(int slot);
     int MaxTextureSize(void) { return maxTextureSize; };
+    int QueueLength(void) { return cmdCount; };
+    long CpuTime(void);
 };
 
 /****************************************************************************************
@@ -493,7 +605,11 @@ class cOglPixmap : public cPixmap {
     int X(void) { return ViewPort().X(); };
     int Y(void) { return ViewPort().Y(); };
     virtual bool IsDirty(void) { return dirty; }
-    virtual void SetDirty(bool dirty = true) { this->dirty = dirty; }
+    virtual void SetDirty(bool dirty = true) {
+        this->dirty = dirty;
+        if (!dirty)
+            SetClean();
+    }
     virtual void SetAlpha(int Alpha);
     virtual void SetTile(bool Tile);
     virtual void SetViewPort(const cRect &Rect);
@@ -529,6 +645,7 @@ class cOglOsd : public cOsd {
     std::shared_ptr<cOglThread> oglThread;
     cVector<cOglPixmap *> oglPixmaps;
     bool isSubtitleOsd;
+    cRect damage;
 
   protected:
   public:
@@ -542,6 +659,7 @@ class cOglOsd : public cOsd {
     virtual void DrawScaledBitmap(int x, int y, const cBitmap &Bitmap, double FactorX, double FactorY,
                                   bool AntiAlias = false);
     static cOglOutputFb *oFb;
+    static cOglOsd *lastFlushed;
 };
 
 #endif //__SOFTHDDEVICE_OPENGLOSD_H
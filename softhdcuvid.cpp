@@ -29,6 +29,7 @@
 #include <vdr/plugin.h>
 #include <vdr/shutdown.h>
 #include <vdr/tools.h>
+#include <vdr/transfer.h>
 
 #ifdef HAVE_CONFIG
 #include "config.h"
@@ -96,7 +97,7 @@ static uint32_t ConfigVideoBackground;    ///< config video background color
 static int ConfigOsdWidth;                ///< config OSD width
 static int ConfigOsdHeight;               ///< config OSD height
 static char ConfigVideoStudioLevels;      ///< config use studio levels
-static char ConfigVideo60HzMode;          ///< config use 60Hz display mode
+static char ConfigVideoRefreshMatch;      ///< config match display refresh
 static char ConfigVideoSoftStartSync;     ///< config use softstart sync
 static char ConfigVideoBlackPicture;      ///< config enable black picture mode
 char ConfigVideoClearOnSwitch;            ///< config enable Clear on channel switch
@@ -148,6 +149,7 @@ static char ConfigAudioCompression;   ///< config use volume compression
 static int ConfigAudioMaxCompression; ///< config max volume compression
 static int ConfigAudioStereoDescent;  ///< config reduce stereo loudness
 int ConfigAudioBufferTime;            ///< config size ms of audio buffer
+static int ConfigAudioAdaptiveBuffer; ///< config adaptive audio buffer size
 static int ConfigAudioAutoAES;        ///< config automatic AES handling
 
 static char *ConfigX11Display;        ///< config x11 display
@@ -859,6 +861,7 @@ class cSoftOsdProvider : public cOsdProvider {
     static void StopOpenGlThread(void);
     static const cImage *GetImageData(int ImageHandle);
     static void OsdSizeChanged(void);
+    static bool GetOglThreadStats(int &, long &);
 #endif
     cSoftOsdProvider(void);      ///< OSD provider constructor
     virtual ~cSoftOsdProvider(); ///< OSD provider destructor
@@ -947,6 +950,23 @@ bool cSoftOsdProvider::StartOpenGlThread(void) {
     return false;
 }
 
+/**
+**  Get OpenGL worker thread statistics.
+**
+**  @param[out] queue	number of queued osd commands
+**  @param[out] cpu	cpu time of worker thread in ms
+**
+**  @returns false, if the worker thread isn't running.
+*/
+bool cSoftOsdProvider::GetOglThreadStats(int &queue, long &cpu) {
+    if (!oglThread.get() || !oglThread->Active()) {
+        return false;
+    }
+    queue = oglThread->QueueLength();
+    cpu = oglThread->CpuTime();
+    return true;
+}
+
 void cSoftOsdProvider::StopOpenGlThread(void) {
     dsyslog("[softhddev]stopping OpenGL Worker Thread ");
     if (oglThread) {
@@ -1011,10 +1031,11 @@ class cMenuSetupSoft : public cMenuSetupPage {
     uint32_t Background;
     uint32_t BackgroundAlpha;
     int StudioLevels;
-    int _60HzMode;
+    int RefreshMatch;
     int SoftStartSync;
     int BlackPicture;
     int ClearOnSwitch;
+    int SoftwareDecoder;
 
     int Brightness;
     int Contrast;
@@ -1052,6 +1073,7 @@ class cMenuSetupSoft : public cMenuSetupPage {
     int AudioMaxCompression;
     int AudioStereoDescent;
     int AudioBufferTime;
+    int AudioAdaptiveBuffer;
     int AudioAutoAES;
 
 #ifdef USE_PIP
@@ -1134,6 +1156,7 @@ void cMenuSetupSoft::Create(void) {
     };
     static const char *const video_display_formats_4_3[] = {"pan&scan", "letterbox", "center cut-out", "original"};
     static const char *const video_display_formats_16_9[] = {"pan&scan", "pillarbox", "center cut-out", "original"};
+    static const char *software_decoder[3]; // the menu item keeps the pointer
 #ifdef YADIF
     static const char *const deinterlace[] = {
         "Cuda",
@@ -1178,6 +1201,10 @@ void cMenuSetupSoft::Create(void) {
     }
 #endif
 
+    software_decoder[0] = tr("never");
+    software_decoder[1] = tr("fallback");
+    software_decoder[2] = tr("always");
+
     current = Current(); // get current menu item index
     Clear();             // clear the menu
 
@@ -1230,10 +1257,11 @@ void cMenuSetupSoft::Create(void) {
 #ifdef PLACEBO
         Add(new cMenuEditBoolItem(tr("Color Range"), &StudioLevels, trVDR("limited RGB"), trVDR("Full RGB")));
 #endif
-        Add(new cMenuEditBoolItem(tr("60hz display mode"), &_60HzMode, trVDR("no"), trVDR("yes")));
+        Add(new cMenuEditBoolItem(tr("Match display refresh rate"), &RefreshMatch, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Soft start a/v sync"), &SoftStartSync, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Black during channel switch"), &BlackPicture, trVDR("no"), trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Clear decoder on channel switch"), &ClearOnSwitch, trVDR("no"), trVDR("yes")));
+        Add(new cMenuEditStraItem(tr("Software decoder"), &SoftwareDecoder, 3, software_decoder));
 
 #if PLACEBO
         Add(new cMenuEditStraItem(tr("Scaler Test"), &ConfigScalerTest, scalers + 1, scalingtest));
@@ -1308,6 +1336,8 @@ void cMenuSetupSoft::Create(void) {
         Add(new cMenuEditIntItem(tr("  Max compression factor (/1000)"), &AudioMaxCompression, 0, 10000));
         Add(new cMenuEditIntItem(tr("Reduce stereo volume (/1000)"), &AudioStereoDescent, 0, 1000));
         Add(new cMenuEditIntItem(tr("Audio buffer size (ms)"), &AudioBufferTime, 0, 1000));
+        Add(new cMenuEditBoolItem(tr("  Adapt buffer size to jitter"), &AudioAdaptiveBuffer, trVDR("no"),
+                                  trVDR("yes")));
         Add(new cMenuEditBoolItem(tr("Enable automatic AES"), &AudioAutoAES, trVDR("no"), trVDR("yes")));
     }
 #ifdef USE_PIP
@@ -1435,10 +1465,11 @@ cMenuSetupSoft::cMenuSetupSoft(void) {
     Background = ConfigVideoBackground >> 8;
     BackgroundAlpha = ConfigVideoBackground & 0xFF;
     StudioLevels = ConfigVideoStudioLevels;
-    _60HzMode = ConfigVideo60HzMode;
+    RefreshMatch = ConfigVideoRefreshMatch;
     SoftStartSync = ConfigVideoSoftStartSync;
     BlackPicture = ConfigVideoBlackPicture;
     ClearOnSwitch = ConfigVideoClearOnSwitch;
+    SoftwareDecoder = CodecSoftwareDecoder;
 
     Brightness = ConfigVideoBrightness;
     Contrast = ConfigVideoContrast;
@@ -1481,6 +1512,7 @@ cMenuSetupSoft::cMenuSetupSoft(void) {
     AudioMaxCompression = ConfigAudioMaxCompression;
     AudioStereoDescent = ConfigAudioStereoDescent;
     AudioBufferTime = ConfigAudioBufferTime;
+    AudioAdaptiveBuffer = ConfigAudioAdaptiveBuffer;
     AudioAutoAES = ConfigAudioAutoAES;
 
 #ifdef USE_PIP
@@ -1561,13 +1593,14 @@ void cMenuSetupSoft::Store(void) {
     VideoSetBackground(ConfigVideoBackground);
     SetupStore("StudioLevels", ConfigVideoStudioLevels = StudioLevels);
     VideoSetStudioLevels(ConfigVideoStudioLevels);
-    SetupStore("60HzMode", ConfigVideo60HzMode = _60HzMode);
-    VideoSet60HzMode(ConfigVideo60HzMode);
+    SetupStore("RefreshMatch", ConfigVideoRefreshMatch = RefreshMatch);
+    VideoSetRefreshMatch(ConfigVideoRefreshMatch);
     SetupStore("SoftStartSync", ConfigVideoSoftStartSync = SoftStartSync);
     VideoSetSoftStartSync(ConfigVideoSoftStartSync);
     SetupStore("BlackPicture", ConfigVideoBlackPicture = BlackPicture);
     VideoSetBlackPicture(ConfigVideoBlackPicture);
     SetupStore("ClearOnSwitch", ConfigVideoClearOnSwitch = ClearOnSwitch);
+    SetupStore("SoftwareDecoder", CodecSoftwareDecoder = SoftwareDecoder);
 
     SetupStore("Brightness", ConfigVideoBrightness = Brightness);
     VideoSetBrightness(ConfigVideoBrightness);
@@ -1653,6 +1686,8 @@ void cMenuSetupSoft::Store(void) {
     SetupStore("AudioStereoDescent", ConfigAudioStereoDescent = AudioStereoDescent);
     AudioSetStereoDescent(ConfigAudioStereoDescent);
     SetupStore("AudioBufferTime", ConfigAudioBufferTime = AudioBufferTime);
+    SetupStore("AudioAdaptiveBuffer", ConfigAudioAdaptiveBuffer = AudioAdaptiveBuffer);
+    AudioSetAdaptiveBuffer(ConfigAudioAdaptiveBuffer);
     SetupStore("AudioAutoAES", ConfigAudioAutoAES = AudioAutoAES);
     AudioSetAutoAES(ConfigAudioAutoAES);
 
@@ -1771,6 +1806,189 @@ cSoftHdControl::~cSoftHdControl() {
 extern "C" void DelPip(void); ///< remove PIP
 static int PipAltPosition;    ///< flag alternative position
 
+/// number of PES buffers of the PIP receiver
+#define PIP_PES_BUFFERS 4
+/// first size of a PIP PES buffer
+#define PIP_PES_MIN_SIZE (64 * 1024)
+/// limit of a PIP PES packet, bigger packets are dropped
+#define PIP_PES_MAX_SIZE (4 * 1024 * 1024)
+
+///
+/// PES buffer of the PIP receiver.
+///
+struct PipPesBuffer {
+    uint8_t *Data; ///< buffer data
+    int Size;      ///< buffer size
+    int Index;     ///< bytes used
+};
+
+static PipPesBuffer PipPes[PIP_PES_BUFFERS]; ///< pool of PES buffers
+static int PipPesQueue[PIP_PES_BUFFERS];     ///< complete PES packets
+static int PipPesQueued;                     ///< number of complete packets
+static int PipPesCurrent = -1;               ///< packet in reassembly
+static int PipPesMaxSize;                    ///< biggest PES packet seen
+
+static int PipPesPackets;  ///< PES packets played
+static int PipPesDropped;  ///< PES packets dropped, video too slow
+static int PipPesOversize; ///< PES packets dropped, too big
+static int PipPesInvalid;  ///< invalid PES packets
+
+///
+/// Play queued PES packets, until video buffer is full.
+///
+static void PipPesFlush(void) {
+    while (PipPesQueued) {
+        PipPesBuffer *pes;
+
+        pes = &PipPes[PipPesQueue[0]];
+        if (!PipPlayVideo(pes->Data, pes->Index)) {
+            break; // video buffer full, try again with next packet
+        }
+        ++PipPesPackets;
+        pes->Index = 0;
+        memmove(PipPesQueue, PipPesQueue + 1, --PipPesQueued * sizeof(*PipPesQueue));
+    }
+}
+
+///
+/// Get free PES buffer for a new packet.
+///
+/// If all buffers are queued, the oldest packet is dropped.
+///
+static int PipPesGet(void) {
+    int i;
+
+    for (i = 0; i < PIP_PES_BUFFERS; ++i) {
+        int j;
+
+        for (j = 0; j < PipPesQueued; ++j) {
+            if (PipPesQueue[j] == i) {
+                break;
+            }
+        }
+        if (j == PipPesQueued) {
+            break;
+        }
+    }
+    if (i == PIP_PES_BUFFERS) {
+        ++PipPesDropped;
+        i = PipPesQueue[0];
+        memmove(PipPesQueue, PipPesQueue + 1, --PipPesQueued * sizeof(*PipPesQueue));
+    }
+    PipPes[i].Index = 0;
+    return i;
+}
+
+///
+/// Free all PES buffers of the PIP receiver.
+///
+static void PipPesExit(void) {
+    int i;
+
+    if (PipPesPackets || PipPesDropped || PipPesOversize || PipPesInvalid) {
+        dsyslog("[softhddev]pip: %d PES packets, %d dropped, %d too big, %d invalid, max %d bytes\n", PipPesPackets,
+                PipPesDropped, PipPesOversize, PipPesInvalid, PipPesMaxSize);
+    }
+    for (i = 0; i < PIP_PES_BUFFERS; ++i) {
+        free(PipPes[i].Data);
+        PipPes[i].Data = NULL;
+        PipPes[i].Size = 0;
+        PipPes[i].Index = 0;
+    }
+    PipPesQueued = 0;
+    PipPesCurrent = -1;
+    PipPesMaxSize = 0;
+    PipPesPackets = 0;
+    PipPesDropped = 0;
+    PipPesOversize = 0;
+    PipPesInvalid = 0;
+}
+
+///
+/// Parse packetized elementary stream.
+///
+/// The PES packets are reassembled in a small pool of buffers.  A
+/// complete packet waits in the pool, while the PIP video buffer is
+/// full.  New buffers are allocated with the biggest packet size seen.
+///
+/// @param data payload data of transport stream
+/// @param size number of payload data bytes
+/// @param is_start flag, start of pes packet
+///
+static void PipPesParse(const uint8_t *data, int size, int is_start) {
+    PipPesBuffer *pes;
+
+    if (is_start) { // start of pes packet
+        if (PipPesCurrent >= 0) {
+            pes = &PipPes[PipPesCurrent];
+            if (0) {
+                fprintf(stderr, "pip: PES packet %8d %02x%02x\n", pes->Index, pes->Data[2], pes->Data[3]);
+            }
+            if (pes->Index < 4 || pes->Data[0] || pes->Data[1] || pes->Data[2] != 0x01) {
+                ++PipPesInvalid;
+                esyslog(tr("[softhddev]pip: invalid PES packet %d\n"), pes->Index);
+                pes->Index = 0;
+            } else {
+                if (pes->Index > PipPesMaxSize) {
+                    PipPesMaxSize = pes->Index;
+                }
+                PipPesQueue[PipPesQueued++] = PipPesCurrent;
+            }
+        }
+        PipPesFlush();
+        PipPesCurrent = PipPesGet();
+    }
+    if (PipPesCurrent < 0) { // wait for first packet start
+        return;
+    }
+
+    pes = &PipPes[PipPesCurrent];
+    if (pes->Index + size > pes->Size) {
+        int n;
+
+        if (pes->Index + size > PIP_PES_MAX_SIZE) { // broken stream, skip until next packet
+            ++PipPesOversize;
+            esyslog(tr("[softhddev]pip: PES packet too big\n"));
+            pes->Index = 0;
+            PipPesCurrent = -1;
+            return;
+        }
+        n = pes->Size ? pes->Size * 2 : PIP_PES_MIN_SIZE;
+        if (n < PipPesMaxSize) {
+            n = PipPesMaxSize;
+        }
+        if (n < pes->Index + size) {
+            n = pes->Index + size;
+        }
+        if (n > PIP_PES_MAX_SIZE) {
+            n = PIP_PES_MAX_SIZE;
+        }
+        uint8_t *buf = (uint8_t *)realloc(pes->Data, n);
+        if (!buf) { // out of memory, should never happen
+            pes->Index = 0;
+            PipPesCurrent = -1;
+            return;
+        }
+        pes->Data = buf;
+        pes->Size = n;
+    }
+    memcpy(pes->Data + pes->Index, data, size);
+    pes->Index += size;
+}
+
+///
+/// Video payload handler of the PIP transport stream demuxer.
+///
+/// @param opaque unused
+/// @param data payload data of transport stream
+/// @param size number of payload data bytes
+/// @param is_start flag, start of pes packet
+///
+static void PipTsPayload(void *opaque, const uint8_t *data, int size, int is_start) {
+    (void)opaque;
+    PipPesParse(data, size, is_start);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //  cReceiver
 //////////////////////////////////////////////////////////////////////////////
@@ -1781,6 +1999,9 @@ static int PipAltPosition;    ///< flag alternative position
 **  Receiver class for PIP mode.
 */
 class cSoftReceiver : public cReceiver {
+  private:
+    TsDemux *demux; ///< transport stream demuxer
+
   protected:
     virtual void Activate(bool);
     virtual void Receive(const uchar *, int);
@@ -1799,12 +2020,25 @@ cSoftReceiver::cSoftReceiver(const cChannel *channel) : cReceiver(NULL, MINPRIOR
     // cReceiver::channelID not setup, this can cause trouble
     // we want video only
     AddPid(channel->Vpid());
+    if ((demux = TsDemuxNew())) {
+        TsDemuxAddPid(demux, channel->Vpid(), PipTsPayload, NULL);
+    }
 }
 
 /**
 **  Receiver destructor.
 */
-cSoftReceiver::~cSoftReceiver() { Detach(); }
+cSoftReceiver::~cSoftReceiver() {
+    Detach();
+    if (demux) {
+        char buf[256];
+
+        if (TsDemuxStats(demux, buf, sizeof(buf))) {
+            dsyslog("[softhddev]pip: %s", buf);
+        }
+        TsDemuxDel(demux);
+    }
+}
 
 /**
 **  Called before the receiver gets attached or detached.
@@ -1837,118 +2071,15 @@ void cSoftReceiver::Activate(bool on) {
     }
 }
 
-///
-/// Parse packetized elementary stream.
-///
-/// @param data payload data of transport stream
-/// @param size number of payload data bytes
-/// @param is_start flag, start of pes packet
-///
-static void PipPesParse(const uint8_t *data, int size, int is_start) {
-    static uint8_t *pes_buf;
-    static int pes_size;
-    static int pes_index;
-
-    // FIXME: quick&dirty
-
-    if (!pes_buf) {
-        pes_size = 500 * 1024 * 1024;
-        pes_buf = (uint8_t *)malloc(pes_size);
-        if (!pes_buf) { // out of memory, should never happen
-            return;
-        }
-        pes_index = 0;
-    }
-    if (is_start) { // start of pes packet
-        if (pes_index) {
-            if (0) {
-                fprintf(stderr, "pip: PES packet %8d %02x%02x\n", pes_index, pes_buf[2], pes_buf[3]);
-            }
-            if (pes_buf[0] || pes_buf[1] || pes_buf[2] != 0x01) {
-                // FIXME: first should always fail
-                esyslog(tr("[softhddev]pip: invalid PES packet %d\n"), pes_index);
-            } else {
-                PipPlayVideo(pes_buf, pes_index);
-                // FIXME: buffer full: pes packet is dropped
-            }
-            pes_index = 0;
-        }
-    }
-
-    if (pes_index + size > pes_size) {
-        esyslog(tr("[softhddev]pip: pes buffer too small\n"));
-        pes_size *= 2;
-        if (pes_index + size > pes_size) {
-            pes_size = (pes_index + size) * 2;
-        }
-        pes_buf = (uint8_t *)realloc(pes_buf, pes_size);
-        if (!pes_buf) { // out of memory, should never happen
-            return;
-        }
-    }
-    memcpy(pes_buf + pes_index, data, size);
-    pes_index += size;
-}
-
-/// Transport stream packet size
-#define TS_PACKET_SIZE 188
-/// Transport stream packet sync byte
-#define TS_PACKET_SYNC 0x47
-
 /**
 **  Receive TS packet from device.
 **
 **  @param data ts packet
-**  @param size size (#TS_PACKET_SIZE=188) of tes packet
+**  @param size size of ts packets (n * 188)
 */
 void cSoftReceiver::Receive(const uchar *data, int size) {
-    const uint8_t *p;
-
-    p = data;
-    while (size >= TS_PACKET_SIZE) {
-        int payload;
-
-        if (p[0] != TS_PACKET_SYNC) {
-            esyslog(tr("[softhddev]tsdemux: transport stream out of sync\n"));
-            // FIXME: kill all buffers
-            return;
-        }
-        if (p[1] & 0x80) { // error indicatord
-            dsyslog("[softhddev]tsdemux: transport error\n");
-            // FIXME: kill all buffers
-            goto next_packet;
-        }
-        if (0) {
-            int pid;
-
-            pid = (p[1] & 0x1F) << 8 | p[2];
-            fprintf(stderr, "tsdemux: PID: %#04x%s%s\n", pid, p[1] & 0x40 ? " start" : "",
-                    p[3] & 0x10 ? " payload" : "");
-        }
-        // skip adaptation field
-        switch (p[3] & 0x30) { // adaption field
-            case 0x00:         // reserved
-            case 0x20:         // adaptation field only
-            default:
-                goto next_packet;
-            case 0x10: // only payload
-                payload = 4;
-                break;
-            case 0x30: // skip adapation field
-                payload = 5 + p[4];
-                // illegal length, ignore packet
-                if (payload >= TS_PACKET_SIZE) {
-                    dsyslog("[softhddev]tsdemux: illegal adaption field length\n");
-                    goto next_packet;
-                }
-                break;
-        }
-
-        PipPesParse(p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40);
-
-    next_packet:
-        p += TS_PACKET_SIZE;
-        size -= TS_PACKET_SIZE;
+    if (demux) {
+        TsDemuxer(demux, data, size);
     }
 }
 
@@ -1966,6 +2097,7 @@ extern "C" void DelPip(void) {
 
     PipReceiver = NULL;
     PipChannel = NULL;
+    PipPesExit(); // receiver is detached, give memory back
 }
 
 /**
@@ -2641,6 +2773,14 @@ bool cSoftHdDevice::SetPlayMode(ePlayMode play_mode) {
     }
     if (!cDevice::IsMute())
         SetVolume(cDevice::CurrentVolume(), true);
+    if (play_mode != pmNone) { // each source learns its own audio buffer size
+        if (Transferring()) {
+            AudioSetSource(strcmp(cTransferControl::ReceiverDevice()->DeviceType(), "DVB") ? AUDIO_SOURCE_NETWORK
+                                                                                           : AUDIO_SOURCE_LIVE);
+        } else {
+            AudioSetSource(AUDIO_SOURCE_REPLAY);
+        }
+    }
     return ::SetPlayMode(play_mode);
 }
 
@@ -3203,8 +3343,11 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value) {
         VideoSetStudioLevels(ConfigVideoStudioLevels = atoi(value));
         return true;
     }
-    if (!strcasecmp(name, "60HzMode")) {
-        VideoSet60HzMode(ConfigVideo60HzMode = atoi(value));
+    if (!strcasecmp(name, "RefreshMatch")) {
+        VideoSetRefreshMatch(ConfigVideoRefreshMatch = atoi(value));
+        return true;
+    }
+    if (!strcasecmp(name, "60HzMode")) { // obsolete, frames follow the display cadence
         return true;
     }
     if (!strcasecmp(name, "SoftStartSync")) {
@@ -3219,6 +3362,10 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value) {
         ConfigVideoClearOnSwitch = atoi(value);
         return true;
     }
+    if (!strcasecmp(name, "SoftwareDecoder")) {
+        CodecSoftwareDecoder = atoi(value);
+        return true;
+    }
     if (!strcasecmp(name, "Brightness")) {
         int i;
 
@@ -3394,6 +3541,11 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value) {
         AudioSetBufferTime(ConfigAudioBufferTime);
         return true;
     }
+    if (!strcasecmp(name, "AudioAdaptiveBuffer")) {
+        ConfigAudioAdaptiveBuffer = atoi(value);
+        AudioSetAdaptiveBuffer(ConfigAudioAdaptiveBuffer);
+        return true;
+    }
     if (!strcasecmp(name, "AudioAutoAES")) {
         ConfigAudioAutoAES = atoi(value);
         AudioSetAutoAES(ConfigAudioAutoAES);
@@ -3623,6 +3775,20 @@ static const char *SVDRPHelpText[] = {"SUSP\n"
                                       "\040   Raise softhddevice window\n\n"
                                       "	 If Xserver is not started by softhddevice, the window which\n"
                                       "    contains the softhddevice frontend will be raised to the front.\n",
+                                      "PERF\n"
+                                      "\040   Display performance counters.\n\n"
+                                      "    One 'name value' pair per line: video packet ring fill and\n"
+                                      "    high-water mark, audio ring fill, output surface queue, osd\n"
+                                      "    command queue, thread cpu times in ms and decode/render/display\n"
+                                      "    latency histograms with buckets <1ms, <2ms, <4ms ... >=64ms.\n",
+                                      "SYNC [on|off|dump <file>|<n>]\n"
+                                      "    Trace audio/video synchronisation.\n\n"
+                                      "    on\t\tstart recording the a/v sync of every displayed frame\n"
+                                      "    off\t\tstop recording\n"
+                                      "    dump file\twrite the recorded trace to a binary file\n"
+                                      "    n\t\tshow the last n recorded frames (default 20)\n"
+                                      "    Columns: display time ms, video pts, audio - video ms,\n"
+                                      "    audio delay ms, filled surfaces, frame time and decision.\n",
                                       NULL};
 
 /**
@@ -3815,6 +3981,104 @@ cString cPluginSoftHdDevice::SVDRPCommand(const char *command, const char *optio
         return "Window raised";
     }
 
+    if (!strcasecmp(command, "PERF")) {
+        static const char *const latency_names[] = {"decode", "render", "display"};
+        VideoPerf perf;
+        cString reply;
+        int filled;
+        int size;
+        int high;
+        int bytes;
+        int budget;
+        int high_bytes;
+        int i;
+
+        GetPacketStats(&filled, &size, &high, &bytes, &budget, &high_bytes);
+        VideoGetPerf(&perf);
+        reply = cString::sprintf("video.packets %d/%d\n"
+                                 "video.packets.high %d\n"
+                                 "video.bytes %d/%d\n"
+                                 "video.bytes.high %d\n"
+                                 "audio.ring %d/%d\n"
+                                 "video.surfaces %d\n",
+                                 filled, size, high, bytes, budget, high_bytes, AudioUsedBytes(),
+                                 AudioUsedBytes() + AudioFreeBytes(), perf.SurfacesFilled);
+#ifdef USE_OPENGLOSD
+        int queue;
+        long cpu;
+
+        if (cSoftOsdProvider::GetOglThreadStats(queue, cpu)) {
+            reply = cString::sprintf("%sosd.queue %d\ncpu.osd %ld\n", *reply, queue, cpu);
+        }
+#endif
+        reply = cString::sprintf("%scpu.decode %lld\ncpu.display %lld\ncpu.audio %lld", *reply,
+                                 (long long)perf.DecodeCpu, (long long)perf.DisplayCpu,
+                                 (long long)AudioGetCpuTime());
+        for (i = 0; i < 3; ++i) {
+            const unsigned *histogram;
+            int j;
+
+            histogram = i == 0 ? perf.DecodeLatency : i == 1 ? perf.RenderLatency : perf.DisplayLatency;
+            reply = cString::sprintf("%s\nlatency.%s", *reply, latency_names[i]);
+            for (j = 0; j < VIDEO_LATENCY_BUCKETS; ++j) {
+                reply = cString::sprintf("%s %u", *reply, histogram[j]);
+            }
+        }
+        return reply;
+    }
+    if (!strcasecmp(command, "SYNC")) {
+        static const char *const decisions[] = {"show", "nosync", "hold", "dup", "drop", "delay", "underrun"};
+        VideoSyncTrace trace[100];
+        cString reply;
+        int i;
+        int n;
+
+        option = skipspace(option);
+        if (!strcasecmp(option, "on")) {
+            VideoSetSyncTrace(1);
+            return "a/v sync trace on";
+        }
+        if (!strcasecmp(option, "off")) {
+            VideoSetSyncTrace(0);
+            return "a/v sync trace off";
+        }
+        if (!strncasecmp(option, "dump", 4)) {
+            option = skipspace(option + 4);
+            if (!*option) {
+                reply_code = 501;
+                return "missing file name";
+            }
+            if ((n = VideoDumpSyncTrace(option)) < 0) {
+                reply_code = 550;
+                return cString::sprintf("can't write a/v sync trace to '%s'", option);
+            }
+            return cString::sprintf("%d a/v sync trace entries written to '%s'", n, option);
+        }
+        n = *option ? strtol(option, NULL, 0) : 20;
+        if (n <= 0 || n > (int)(sizeof(trace) / sizeof(*trace))) {
+            n = sizeof(trace) / sizeof(*trace);
+        }
+        n = VideoGetSyncTrace(trace, n);
+        if (!n) {
+            return "no a/v sync trace recorded";
+        }
+        reply = "";
+        for (i = 0; i < n; ++i) {
+            int diff;
+
+            diff = trace[i].AudioClock == (int64_t)AV_NOPTS_VALUE || trace[i].VideoClock == (int64_t)AV_NOPTS_VALUE
+                       ? 0
+                       : (int)(trace[i].AudioClock - trace[i].VideoClock) / 90;
+            reply = cString::sprintf("%s%s%10u %12lld %+6d %5d %2d %6.2f %s", *reply, i ? "\n" : "",
+                                     trace[i].Tick, (long long)trace[i].VideoClock, diff, trace[i].AudioDelay / 90,
+                                     trace[i].Filled, trace[i].FrameTime,
+                                     (unsigned)trace[i].Decision < sizeof(decisions) / sizeof(*decisions)
+                                         ? decisions[trace[i].Decision]
+                                         : "?");
+        }
+        return reply;
+    }
+
     return NULL;
 }
 
@@ -24,14 +24,17 @@
 #define noUSE_PIP         ///< include PIP support + new API
 #define noDUMP_TRICKSPEED ///< dump raw trickspeed packets
 
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #ifdef __FreeBSD__
 #include <signal.h>
 #endif
+#include <errno.h>
 #include <fcntl.h>
 
 #include <inttypes.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,6 +62,7 @@
 #include "video.h"
 #include "codec.h"
 // clang-format on
+#include "startcode.h"
 
 #if 0
 static int DumpH264(const uint8_t *data, int size);
@@ -458,6 +462,156 @@ static int AdtsCheck(const uint8_t *data, int size) {
     return 0;
 }
 
+///
+/// Audio codec probe cache entry.
+///
+/// Remembers the header of the last frame found in a stream.  The
+/// masked bits contain sync, layout, sample rate and channel fields,
+/// which don't change inside a stream.
+///
+typedef struct _audio_probe_ {
+    unsigned CodecID;  ///< codec of last frame, AV_CODEC_ID_NONE unknown
+    uint8_t Header[5]; ///< header of last frame
+    uint8_t Mask[5];   ///< header bits, which must match
+} AudioProbe;
+
+///
+/// Audio probe allowed codecs.
+///
+enum {
+    AUDIO_PROBE_MPEG = 1, ///< allow mpeg, LATM and ADTS audio
+    AUDIO_PROBE_AC3 = 2,  ///< allow (E-)AC-3 audio
+};
+
+static unsigned AudioProbeHits;   ///< frames found with cached header
+static unsigned AudioProbeMisses; ///< frames found with full probing
+
+///
+/// Fill audio probe cache entry.
+///
+/// @param probe    probe cache entry
+/// @param codec_id codec of the frame
+/// @param data     start of the frame
+///
+static void AudioProbeStore(AudioProbe *probe, unsigned codec_id, const uint8_t *data) {
+    static const uint8_t mpeg_mask[5] = {0xFF, 0xFE, 0x0C, 0xC0, 0x00};
+    static const uint8_t latm_mask[5] = {0xFF, 0xE0, 0x00, 0x00, 0x00};
+    static const uint8_t ac3_mask[5] = {0xFF, 0xFF, 0x00, 0x00, 0xC0};
+    static const uint8_t adts_mask[5] = {0xFF, 0xFE, 0xFD, 0xC0, 0x00};
+    const uint8_t *mask;
+
+    switch (codec_id) {
+        case AV_CODEC_ID_MP2:
+            mask = mpeg_mask;
+            break;
+        case AV_CODEC_ID_AAC_LATM:
+            mask = latm_mask;
+            break;
+        case AV_CODEC_ID_AC3:
+        case AV_CODEC_ID_EAC3:
+            mask = ac3_mask;
+            break;
+        default:
+            mask = adts_mask;
+            break;
+    }
+    if (probe->CodecID != codec_id) {
+        Debug(3, "audio/probe: codec %#06x -> %#06x\n", probe->CodecID, codec_id);
+    }
+    probe->CodecID = codec_id;
+    memcpy(probe->Header, data, sizeof(probe->Header));
+    memcpy(probe->Mask, mask, sizeof(probe->Mask));
+}
+
+///
+/// Check for next audio frame.
+///
+/// If the header matches the cached header of the stream, only the
+/// parser of the cached codec is tried, otherwise all allowed parsers.
+///
+/// @param probe    probe cache entry of the stream
+/// @param data     incomplete PES packet, at least 5 bytes
+/// @param size     number of bytes
+/// @param allow    AUDIO_PROBE_MPEG and/or AUDIO_PROBE_AC3
+/// @param[out] codec_id    codec of found frame
+///
+/// @retval <0	possible audio frame, but need more data
+/// @retval 0	no valid audio frame
+/// @retval >0	size of valid audio frame
+///
+static int AudioProbeCheck(AudioProbe *probe, const uint8_t *data, int size, int allow, unsigned *codec_id) {
+    int r;
+
+    // fast path: same header as last frame of this stream, codec still allowed
+    if (probe->CodecID != AV_CODEC_ID_NONE &&
+        (allow & (probe->CodecID == AV_CODEC_ID_AC3 || probe->CodecID == AV_CODEC_ID_EAC3 ? AUDIO_PROBE_AC3
+                                                                                         : AUDIO_PROBE_MPEG)) &&
+        !((data[0] ^ probe->Header[0]) & probe->Mask[0]) &&
+        !((data[1] ^ probe->Header[1]) & probe->Mask[1]) && !((data[2] ^ probe->Header[2]) & probe->Mask[2]) &&
+        !((data[3] ^ probe->Header[3]) & probe->Mask[3]) && !((data[4] ^ probe->Header[4]) & probe->Mask[4])) {
+        *codec_id = probe->CodecID;
+        switch (probe->CodecID) {
+            case AV_CODEC_ID_MP2:
+                r = MpegCheck(data, size);
+                break;
+            case AV_CODEC_ID_AAC_LATM:
+                r = LatmCheck(data, size);
+                break;
+            case AV_CODEC_ID_AC3:
+            case AV_CODEC_ID_EAC3:
+                r = Ac3Check(data, size);
+                if (r > 0) {
+                    *codec_id = data[5] > (10 << 3) ? AV_CODEC_ID_EAC3 : AV_CODEC_ID_AC3;
+                }
+                break;
+            default:
+                r = AdtsCheck(data, size);
+                break;
+        }
+        if (r > 0) {
+            ++AudioProbeHits;
+            probe->CodecID = *codec_id;
+            return r;
+        }
+        if (r < 0) { // need more bytes
+            return r;
+        }
+    }
+
+    // 4 bytes 0xFFExxxxx Mpeg audio
+    // 5 bytes 0x0B77xxxxxx AC-3 audio
+    // 6 bytes 0x0B77xxxxxxxx E-AC-3 audio
+    // 3 bytes 0x56Exxx AAC LATM audio
+    // 7/9 bytes 0xFFFxxxxxxxxxxx ADTS audio
+    // PCM audio can't be found
+    r = 0;
+    *codec_id = AV_CODEC_ID_NONE;
+    if ((allow & AUDIO_PROBE_MPEG) && FastMpegCheck(data)) {
+        r = MpegCheck(data, size);
+        *codec_id = AV_CODEC_ID_MP2;
+    }
+    if ((allow & AUDIO_PROBE_AC3) && !r && FastAc3Check(data)) {
+        r = Ac3Check(data, size);
+        *codec_id = AV_CODEC_ID_AC3;
+        if (r > 0 && data[5] > (10 << 3)) {
+            *codec_id = AV_CODEC_ID_EAC3;
+        }
+    }
+    if ((allow & AUDIO_PROBE_MPEG) && !r && FastLatmCheck(data)) {
+        r = LatmCheck(data, size);
+        *codec_id = AV_CODEC_ID_AAC_LATM;
+    }
+    if ((allow & AUDIO_PROBE_MPEG) && !r && FastAdtsCheck(data)) {
+        r = AdtsCheck(data, size);
+        *codec_id = AV_CODEC_ID_AAC;
+    }
+    if (r > 0) {
+        ++AudioProbeMisses;
+        AudioProbeStore(probe, *codec_id, data);
+    }
+    return r;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //  PES Demux
 //////////////////////////////////////////////////////////////////////////////
@@ -524,6 +678,8 @@ typedef struct _pes_demux_ {
 
     uint8_t StartCode; ///< pes packet start code
 
+    AudioProbe Probe[256]; ///< audio probe cache per PES stream id
+
     int64_t PTS; ///< presentation time stamp
     int64_t DTS; ///< decode time stamp
 } PesDemux;
@@ -629,35 +785,11 @@ static void PesParse(PesDemux *pesdx, const uint8_t *data, int size, int is_star
                 q = pesdx->Buffer + pesdx->Skip;
                 n = pesdx->Index - pesdx->Skip;
                 while (n >= 5) {
-                    int r = 0;
-                    unsigned codec_id = AV_CODEC_ID_NONE;
-
-                    // 4 bytes 0xFFExxxxx Mpeg audio
-                    // 5 bytes 0x0B77xxxxxx AC-3 audio
-                    // 6 bytes 0x0B77xxxxxxxx E-AC-3 audio
-                    // 3 bytes 0x56Exxx AAC LATM audio
-                    // 7/9 bytes 0xFFFxxxxxxxxxxx ADTS audio
-                    // PCM audio can't be found
-                    // FIXME: simple+faster detection, if codec already known
-                    if (FastMpegCheck(q)) {
-                        r = MpegCheck(q, n);
-                        codec_id = AV_CODEC_ID_MP2;
-                    }
-                    if (!r && FastAc3Check(q)) {
-                        r = Ac3Check(q, n);
-                        codec_id = AV_CODEC_ID_AC3;
-                        if (r > 0 && q[5] > (10 << 3)) {
-                            codec_id = AV_CODEC_ID_EAC3;
-                        }
-                    }
-                    if (!r && FastLatmCheck(q)) {
-                        r = LatmCheck(q, n);
-                        codec_id = AV_CODEC_ID_AAC_LATM;
-                    }
-                    if (!r && FastAdtsCheck(q)) {
-                        r = AdtsCheck(q, n);
-                        codec_id = AV_CODEC_ID_AAC;
-                    }
+                    int r;
+                    unsigned codec_id;
+
+                    r = AudioProbeCheck(&pesdx->Probe[pesdx->StartCode], q, n,
+                                        AUDIO_PROBE_MPEG | AUDIO_PROBE_AC3, &codec_id);
                     if (r < 0) { // need more bytes
                         break;
                     }
@@ -865,6 +997,8 @@ static void PesParse(PesDemux *pesdx, const uint8_t *data, int size, int is_star
     } while (size > 0);
 }
 
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 //  Transport stream demux
 //////////////////////////////////////////////////////////////////////////////
@@ -873,38 +1007,131 @@ static void PesParse(PesDemux *pesdx, const uint8_t *data, int size, int is_star
 #define TS_PACKET_SIZE 188
 /// Transport stream packet sync byte
 #define TS_PACKET_SYNC 0x47
+/// Number of PIDs of one transport stream demuxer
+#define TS_DEMUX_PIDS 8
 
 ///
-/// transport stream demuxer typedef.
+/// transport stream PID of demuxer.
 ///
-typedef struct _ts_demux_ TsDemux;
+typedef struct _ts_pid_ {
+    int Pid;                   ///< packet id or #TS_PID_ANY
+    int LastPid;               ///< last packet id of #TS_PID_ANY
+    TsPayloadHandler *Handler; ///< payload handler
+    void *Opaque;              ///< private data of payload handler
+    int CC;                    ///< last continuity counter, -1 unknown
+    int64_t PCR;               ///< last program clock reference (90kHz)
+    unsigned Packets;          ///< packets received
+    unsigned Errors;           ///< packets with transport error
+    unsigned Discontinuities;  ///< continuity counter errors
+} TsPid;
 
 ///
 /// transport stream demuxer structure.
 ///
 struct _ts_demux_ {
-    int Packets; ///< packets between PCR
+    int Packets;              ///< packets between PCR
+    int Pids;                 ///< number of used PID entries
+    int Last;                 ///< last used PID entry
+    unsigned Unknown;         ///< packets without handler
+    TsPid Pid[TS_DEMUX_PIDS]; ///< PID dispatch table
 };
 
-static PesDemux PesDemuxAudio[1]; ///< audio demuxer
+///
+/// Allocate a new transport stream demuxer.
+///
+TsDemux *TsDemuxNew(void) {
+    TsDemux *tsdx;
+
+    if (!(tsdx = calloc(1, sizeof(*tsdx)))) {
+        Error(_("tsdemux: out of memory\n"));
+    }
+    return tsdx;
+}
+
+///
+/// Free a transport stream demuxer.
+///
+/// @param tsdx transport stream demuxer
+///
+void TsDemuxDel(TsDemux *tsdx) { free(tsdx); }
+
+///
+/// Add a PID handler to the transport stream demuxer.
+///
+/// @param tsdx transport stream demuxer
+/// @param pid packet id or #TS_PID_ANY for all not handled packets
+/// @param handler payload handler
+/// @param opaque private data of payload handler
+///
+/// @retval 0 okay
+/// @retval -1 dispatch table full
+///
+int TsDemuxAddPid(TsDemux *tsdx, int pid, TsPayloadHandler *handler, void *opaque) {
+    TsPid *tsp;
+
+    if (tsdx->Pids == TS_DEMUX_PIDS) {
+        Error(_("tsdemux: too many pids\n"));
+        return -1;
+    }
+    tsp = &tsdx->Pid[tsdx->Pids++];
+    memset(tsp, 0, sizeof(*tsp));
+    tsp->Pid = pid;
+    tsp->LastPid = -1;
+    tsp->Handler = handler;
+    tsp->Opaque = opaque;
+    tsp->CC = -1;
+    tsp->PCR = AV_NOPTS_VALUE;
+    return 0;
+}
+
+///
+/// Lookup the PID entry of a packet.
+///
+/// @param tsdx transport stream demuxer
+/// @param pid packet id
+///
+static TsPid *TsDemuxPid(TsDemux *tsdx, int pid) {
+    TsPid *any;
+    int i;
+
+    if (tsdx->Last < tsdx->Pids && tsdx->Pid[tsdx->Last].Pid == pid) { // same pid as last packet
+        return &tsdx->Pid[tsdx->Last];
+    }
+    any = NULL;
+    for (i = 0; i < tsdx->Pids; ++i) {
+        if (tsdx->Pid[i].Pid == pid) {
+            tsdx->Last = i;
+            return &tsdx->Pid[i];
+        }
+        if (tsdx->Pid[i].Pid == TS_PID_ANY && !any) {
+            any = &tsdx->Pid[i];
+        }
+    }
+    if (any && any->LastPid != pid) { // new stream
+        any->LastPid = pid;
+        any->CC = -1;
+    }
+    return any;
+}
 
 ///
 /// Transport stream demuxer.
 ///
+/// Dispatches the payload of a batch of packets to the PID handlers.
+///
 /// @param tsdx transport stream demuxer
 /// @param data buffer of transport stream packets
 /// @param size size of buffer
 ///
 /// @returns number of bytes consumed from buffer.
 ///
-static int TsDemuxer(TsDemux *tsdx, const uint8_t *data, int size) {
+int TsDemuxer(TsDemux *tsdx, const uint8_t *data, int size) {
     const uint8_t *p;
 
     p = data;
     while (size >= TS_PACKET_SIZE) {
-#ifdef DEBUG
+        TsPid *tsp;
         int pid;
-#endif
         int payload;
 
         if (p[0] != TS_PACKET_SYNC) {
@@ -913,46 +1140,53 @@ static int TsDemuxer(TsDemux *tsdx, const uint8_t *data, int size) {
             return size;
         }
         ++tsdx->Packets;
+        pid = (p[1] & 0x1F) << 8 | p[2];
+        Debug(4, "tsdemux: PID: %#04x%s%s\n", pid, p[1] & 0x40 ? " start" : "", p[3] & 0x10 ? " payload" : "");
+        if (!(tsp = TsDemuxPid(tsdx, pid))) {
+            ++tsdx->Unknown;
+            goto next_packet;
+        }
+        ++tsp->Packets;
         if (p[1] & 0x80) { // error indicator
             Debug(3, "tsdemux: transport error\n");
-            // FIXME: kill all buffers
+            ++tsp->Errors;
+            tsp->CC = -1;
             goto next_packet;
         }
-#ifdef DEBUG
-        pid = (p[1] & 0x1F) << 8 | p[2];
-        Debug(4, "tsdemux: PID: %#04x%s%s\n", pid, p[1] & 0x40 ? " start" : "", p[3] & 0x10 ? " payload" : "");
-#endif
-        // skip adaptation field
-        switch (p[3] & 0x30) { // adaption field
-            case 0x00:         // reserved
-            case 0x20:         // adaptation field only
-            default:
+
+        payload = 4;
+        if (p[3] & 0x20) { // adaptation field
+            payload = 5 + p[4];
+            // illegal length, ignore packet
+            if (payload > TS_PACKET_SIZE) {
+                Debug(3, "tsdemux: illegal adaption field length\n");
                 goto next_packet;
-            case 0x10: // only payload
-                payload = 4;
-                break;
-            case 0x30: // skip adapation field
-                payload = 5 + p[4];
-                // illegal length, ignore packet
-                if (payload >= TS_PACKET_SIZE) {
-                    Debug(3, "tsdemux: illegal adaption field length\n");
-                    goto next_packet;
+            }
+            if (p[4]) {
+                if (p[5] & 0x80) { // discontinuity indicator
+                    tsp->CC = -1;
                 }
-                break;
+                if ((p[5] & 0x10) && p[4] >= 7) { // program clock reference
+                    tsp->PCR = (int64_t)p[6] << 25 | p[7] << 17 | p[8] << 9 | p[9] << 1 | p[10] >> 7;
+                    tsdx->Packets = 0;
+                }
+            }
+        }
+        if (!(p[3] & 0x10) || payload == TS_PACKET_SIZE) { // no payload
+            goto next_packet;
+        }
+        // check continuity, counter only increments with payload
+        if (tsp->CC >= 0 && (p[3] & 0x0F) != ((tsp->CC + 1) & 0x0F)) {
+            if ((p[3] & 0x0F) == tsp->CC) { // duplicate packet
+                goto next_packet;
+            }
+            Debug(3, "tsdemux: pid %d discontinuity (received %d, expected %d)\n", pid, p[3] & 0x0F,
+                  (tsp->CC + 1) & 0x0F);
+            ++tsp->Discontinuities;
         }
+        tsp->CC = p[3] & 0x0F;
 
-        PesParse(PesDemuxAudio, p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40);
-#if 0
-	int tmp;
-
-	// check continuity
-	tmp = p[3] & 0x0F;		// continuity counter
-	if (((tsdx->CC + 1) & 0x0F) != tmp) {
-	    Debug(3, "tsdemux: OUT OF SYNC: %d %d\n", tmp, tsdx->CC);
-	    // TS discontinuity (received 8, expected 0) for PID
-	}
-	tsdx->CC = tmp;
-#endif
+        tsp->Handler(tsp->Opaque, p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40);
 
     next_packet:
         p += TS_PACKET_SIZE;
@@ -962,8 +1196,69 @@ static int TsDemuxer(TsDemux *tsdx, const uint8_t *data, int size) {
     return p - data;
 }
 
+///
+/// Get statistics of the transport stream demuxer.
+///
+/// @param tsdx transport stream demuxer
+/// @param buf buffer for the statistics, one line per PID
+/// @param size size of buffer
+///
+/// @returns length of the statistics.
+///
+int TsDemuxStats(const TsDemux *tsdx, char *buf, int size) {
+    int n;
+    int i;
+
+    n = 0;
+    buf[0] = '\0';
+    for (i = 0; i < tsdx->Pids && n < size; ++i) {
+        const TsPid *tsp;
+
+        tsp = &tsdx->Pid[i];
+        n += snprintf(buf + n, size - n, "pid %4d: %u packets, %u errors, %u discontinuities, pcr %s\n",
+                      tsp->Pid == TS_PID_ANY ? tsp->LastPid : tsp->Pid, tsp->Packets, tsp->Errors,
+                      tsp->Discontinuities, Timestamp2String(tsp->PCR));
+    }
+    if (n < size && tsdx->Unknown) {
+        n += snprintf(buf + n, size - n, "unknown: %u packets\n", tsdx->Unknown);
+    }
+    return n < size ? n : size - 1;
+}
+
+#ifndef NO_TS_AUDIO
+
+static PesDemux PesDemuxAudio[1]; ///< audio demuxer
+static TsDemux TsDemuxAudio[1];   ///< audio transport stream demuxer
+
+///
+/// Reset the continuity check of the transport stream demuxer.
+///
+/// @param tsdx transport stream demuxer
+///
+static void TsDemuxReset(TsDemux *tsdx) {
+    int i;
+
+    for (i = 0; i < tsdx->Pids; ++i) {
+        tsdx->Pid[i].CC = -1;
+    }
+}
+
+///
+/// Audio payload handler of transport stream demuxer.
+///
+/// @param opaque PES demuxer
+/// @param data payload data of transport stream
+/// @param size number of payload data bytes
+/// @param is_start flag, start of pes packet
+///
+static void TsAudioPayload(void *opaque, const uint8_t *data, int size, int is_start) {
+    PesParse(opaque, data, size, is_start);
+}
+
 #endif
 
+static AudioProbe PlayAudioProbe[256]; ///< PlayAudio probe cache per PES stream id
+
 /**
 **  Play audio packet.
 **
@@ -974,6 +1269,7 @@ static int TsDemuxer(TsDemux *tsdx, const uint8_t *data, int size) {
 int PlayAudio(const uint8_t *data, int size, uint8_t id) {
     int n;
     const uint8_t *p;
+    int allow;
 
     // channel switch: SetAudioChannelDevice: SetDigitalAudioDevice:
 
@@ -1115,42 +1411,18 @@ int PlayAudio(const uint8_t *data, int size, uint8_t id) {
 
     n = AudioAvPkt->stream_index;
     p = AudioAvPkt->data;
+    allow = 0;
+    if (id != 0xbd) {
+        allow |= AUDIO_PROBE_MPEG;
+    }
+    if (id == 0xbd || (id & 0xF0) == 0x80) {
+        allow |= AUDIO_PROBE_AC3;
+    }
     while (n >= 5) {
         int r;
         unsigned codec_id;
 
-        // 4 bytes 0xFFExxxxx Mpeg audio
-        // 3 bytes 0x56Exxx AAC LATM audio
-        // 5 bytes 0x0B77xxxxxx AC-3 audio
-        // 6 bytes 0x0B77xxxxxxxx E-AC-3 audio
-        // 7/9 bytes 0xFFFxxxxxxxxxxx ADTS audio
-        // PCM audio can't be found
-        r = 0;
-        codec_id = AV_CODEC_ID_NONE; // keep compiler happy
-        if (id != 0xbd && FastMpegCheck(p)) {
-            r = MpegCheck(p, n);
-            codec_id = AV_CODEC_ID_MP2;
-        }
-        if (id != 0xbd && !r && FastLatmCheck(p)) {
-            r = LatmCheck(p, n);
-            codec_id = AV_CODEC_ID_AAC_LATM;
-        }
-        if ((id == 0xbd || (id & 0xF0) == 0x80) && !r && FastAc3Check(p)) {
-            r = Ac3Check(p, n);
-            codec_id = AV_CODEC_ID_AC3;
-            if (r > 0 && p[5] > (10 << 3)) {
-                codec_id = AV_CODEC_ID_EAC3;
-            }
-            /* faster ac3 detection at end of pes packet (no improvemnts)
-               if (AudioCodecID == codec_id && -r - 2 == n) {
-               r = n;
-               }
-             */
-        }
-        if (id != 0xbd && !r && FastAdtsCheck(p)) {
-            r = AdtsCheck(p, n);
-            codec_id = AV_CODEC_ID_AAC;
-        }
+        r = AudioProbeCheck(&PlayAudioProbe[id], p, n, allow, &codec_id);
         if (r < 0) { // need more bytes
             break;
         }
@@ -1209,8 +1481,6 @@ int PlayAudio(const uint8_t *data, int size, uint8_t id) {
 **  @returns number of bytes consumed;
 */
 int PlayTsAudio(const uint8_t *data, int size) {
-    static TsDemux tsdx[1];
-
     if (SkipAudio || !MyAudioDecoder) { // skip audio
         return size;
     }
@@ -1228,6 +1498,7 @@ int PlayTsAudio(const uint8_t *data, int size) {
         AudioChannelID = -1;
         NewAudioStream = 0;
         PesReset(PesDemuxAudio);
+        TsDemuxReset(TsDemuxAudio);
     }
     // hard limit buffer full: don't overrun audio buffers on replay
     if (AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE) {
@@ -1243,9 +1514,9 @@ int PlayTsAudio(const uint8_t *data, int size) {
         Debug(3, "AudioDelay %dms\n", AudioDelay);
         usleep(AudioDelay * 1000);
         AudioDelay = 0;
-        // TsDemuxer(tsdx, data, size);	  // insert dummy audio
+        // TsDemuxer(TsDemuxAudio, data, size);	  // insert dummy audio
     }
-    return TsDemuxer(tsdx, data, size);
+    return TsDemuxer(TsDemuxAudio, data, size);
 }
 
 #endif
@@ -1269,8 +1540,13 @@ void ResetChannelId(void) {
 //  Video
 //////////////////////////////////////////////////////////////////////////////
 
-#define VIDEO_BUFFER_SIZE (1024 * 1024) ///< video PES buffer default size  512 * 1024
-#define VIDEO_PACKET_MAX 256            ///< max number of video packets  192
+#define VIDEO_PACKET_CHUNK (16 * 1024)         ///< smallest pooled video packet buffer
+#define VIDEO_PACKET_POOLS 10                  ///< packet buffer pools 16k .. 8M
+#define VIDEO_PACKET_MAX 256                   ///< max number of video packets  192
+#define VIDEO_PACKET_BUDGET (64 * 1024 * 1024) ///< default packet byte budget
+
+static int VideoPacketLimit = VIDEO_PACKET_MAX;     ///< packet count limit
+static int VideoPacketBudget = VIDEO_PACKET_BUDGET; ///< packet byte budget
 
 /**
 **  Video output stream device structure.   Parser, decoder, display.
@@ -1295,19 +1571,26 @@ struct __video_stream__ {
 
     int InvalidPesCounter; ///< counter of invalid PES packets
 
-    enum AVCodecID CodecIDRb[VIDEO_PACKET_MAX]; ///< codec ids in ring buffer
-    AVPacket PacketRb[VIDEO_PACKET_MAX];        ///< PES packet ring buffer
-    int StartCodeState;                         ///< last three bytes start code state
+    enum AVCodecID CodecIDRb[VIDEO_PACKET_MAX];   ///< codec ids in ring buffer
+    AVPacket PacketRb[VIDEO_PACKET_MAX];          ///< PES packet ring buffer
+    int PacketBytesRb[VIDEO_PACKET_MAX];          ///< buffer bytes in ring buffer
+    AVBufferPool *PacketPool[VIDEO_PACKET_POOLS]; ///< refcounted packet buffers
+    int PacketSizeHint;                           ///< size of last packet
+    int StartCodeState;                           ///< last three bytes start code state
 
     int PacketWrite;        ///< ring buffer write pointer
     int PacketRead;         ///< ring buffer read pointer
     atomic_t PacketsFilled; ///< how many of the ring buffer is used
+    atomic_t BytesFilled;   ///< buffer bytes of the used packets
+    int PacketsHighWater;   ///< most packets used
+    int BytesHighWater;     ///< most buffer bytes used
+    int WakeupFd;           ///< eventfd, signaled on new packet or command
 };
 
-static VideoStream MyVideoStream[1]; ///< normal video stream
+static VideoStream MyVideoStream[1] = {{.WakeupFd = -1}}; ///< normal video stream
 
 #ifdef USE_PIP
-static VideoStream PipVideoStream[1];         ///< pip video stream
+static VideoStream PipVideoStream[1] = {{.WakeupFd = -1}}; ///< pip video stream
 static int PiPActive = 0, mwx, mwy, mww, mwh; ///< main window frame for PiP
 #endif
 
@@ -1328,22 +1611,27 @@ static volatile char Usr1Signal; ///< true got usr1 signal
 /**
 **  Initialize video packet ringbuffer.
 **
+**  The packet payload is taken from refcounted buffer pools on demand,
+**  the buffers are handed to the decoder without copy.
+**
 **  @param stream   video stream
 */
 static void VideoPacketInit(VideoStream *stream) {
     int i;
 
     for (i = 0; i < VIDEO_PACKET_MAX; ++i) {
-        AVPacket *avpkt;
-
-        avpkt = &stream->PacketRb[i];
-        // build a clean ffmpeg av packet
-        if (av_new_packet(avpkt, VIDEO_BUFFER_SIZE)) {
-            Fatal(_("[softhddev] out of memory\n"));
-        }
+        // build a clean ffmpeg av packet, without payload
+        av_packet_unref(&stream->PacketRb[i]);
+    }
+    for (i = 0; i < VIDEO_PACKET_POOLS; ++i) {
+        stream->PacketPool[i] = NULL; // created on first use
     }
+    stream->PacketSizeHint = 0;
 
     atomic_set(&stream->PacketsFilled, 0);
+    atomic_set(&stream->BytesFilled, 0);
+    stream->PacketsHighWater = 0;
+    stream->BytesHighWater = 0;
     stream->PacketRead = stream->PacketWrite = 0;
 }
 
@@ -1356,10 +1644,96 @@ static void VideoPacketExit(VideoStream *stream) {
     int i;
 
     atomic_set(&stream->PacketsFilled, 0);
+    atomic_set(&stream->BytesFilled, 0);
 
     for (i = 0; i < VIDEO_PACKET_MAX; ++i) {
         av_packet_unref(&stream->PacketRb[i]);
     }
+    // pools are freed, when the decoder releases the last buffer
+    for (i = 0; i < VIDEO_PACKET_POOLS; ++i) {
+        av_buffer_pool_uninit(&stream->PacketPool[i]);
+    }
+}
+
+/**
+**  Check if the video packet ringbuffer is full.
+**
+**  Full is either the packet count limit or the byte budget of the
+**  buffered packets.
+**
+**  @param stream   video stream
+**  @param reserve  number of packets kept free
+*/
+static int VideoPacketsFull(VideoStream *stream, int reserve) {
+    return atomic_read(&stream->PacketsFilled) >= VideoPacketLimit - reserve ||
+           atomic_read(&stream->BytesFilled) >= VideoPacketBudget;
+}
+
+/**
+**  Clear the video packet ringbuffer.
+**
+**  Only the decoder thread is allowed to call this.
+**
+**  @param stream   video stream
+*/
+static void VideoPacketClear(VideoStream *stream) {
+    atomic_set(&stream->PacketsFilled, 0);
+    atomic_set(&stream->BytesFilled, 0);
+    stream->PacketRead = stream->PacketWrite;
+}
+
+/**
+**  Set video packet ringbuffer limits.
+**
+**  @param limit    packets[:MB] maximal number of packets and buffered
+**		    megabytes
+**
+**  @returns -1 for bad formated limit.
+*/
+static int VideoSetPacketLimit(const char *limit) {
+    char *end;
+    long packets;
+    long mbytes;
+
+    packets = strtol(limit, &end, 10);
+    mbytes = VideoPacketBudget / (1024 * 1024);
+    if (*end == ':') {
+        mbytes = strtol(end + 1, &end, 10);
+    }
+    if (*end || packets < 16 || packets > VIDEO_PACKET_MAX || mbytes < 1 || mbytes > 1024) {
+        return -1;
+    }
+    VideoPacketLimit = packets;
+    VideoPacketBudget = mbytes * 1024 * 1024;
+    return 0;
+}
+
+/**
+**  Get video packet buffer from the pools.
+**
+**  @param stream   video stream
+**  @param size     needed payload size
+**
+**  @returns refcounted buffer, with room for size bytes + padding.
+*/
+static AVBufferRef *VideoPacketBuffer(VideoStream *stream, int size) {
+    int i;
+
+    size += AV_INPUT_BUFFER_PADDING_SIZE;
+    for (i = 0; i < VIDEO_PACKET_POOLS; ++i) {
+        if (size <= VIDEO_PACKET_CHUNK << i) {
+            if (!stream->PacketPool[i]) {
+                stream->PacketPool[i] = av_buffer_pool_init(VIDEO_PACKET_CHUNK << i, NULL);
+                if (!stream->PacketPool[i]) {
+                    return NULL;
+                }
+            }
+            return av_buffer_pool_get(stream->PacketPool[i]);
+        }
+    }
+    // bigger than the biggest pool buffer
+    Warning(_("video: packet buffer too small for %d\n"), size);
+    return av_buffer_alloc(size);
 }
 
 /**
@@ -1372,6 +1746,7 @@ static void VideoPacketExit(VideoStream *stream) {
 */
 static void VideoEnqueue(VideoStream *stream, int64_t pts, int64_t dts, const void *data, int size) {
     AVPacket *avpkt;
+    int n;
 
     // Debug(3, "video: enqueue %d\n", size);
 
@@ -1379,23 +1754,28 @@ static void VideoEnqueue(VideoStream *stream, int64_t pts, int64_t dts, const vo
     if (!avpkt->stream_index) { // add pts only for first added
         avpkt->pts = pts;
         avpkt->dts = dts;
+        // buffer still used by the decoder, get a new one
+        if (avpkt->buf && !av_buffer_is_writable(avpkt->buf)) {
+            av_buffer_unref(&avpkt->buf);
+        }
     }
 
-    if (avpkt->stream_index + size >= avpkt->size) {
-
-        // Warning(_("video: packet buffer too small for %d\n"),
-        // avpkt->stream_index + size);
+    if (!avpkt->buf || avpkt->stream_index + size > avpkt->size) {
+        AVBufferRef *buf;
 
-        // new + grow reserves FF_INPUT_BUFFER_PADDING_SIZE
-        av_grow_packet(avpkt, ((size + VIDEO_BUFFER_SIZE / 2) / (VIDEO_BUFFER_SIZE / 2)) * (VIDEO_BUFFER_SIZE / 2));
-        // FIXME: out of memory!
-#ifdef DEBUG
-        if (avpkt->size <= avpkt->stream_index + size) {
-            fprintf(stderr, "%d %d %d\n", avpkt->size, avpkt->stream_index, size);
-            fflush(stderr);
-            abort();
+        // start with the size of the last packet, grow to the next pool
+        n = avpkt->stream_index + size;
+        if (!(buf = VideoPacketBuffer(stream, n < stream->PacketSizeHint ? stream->PacketSizeHint : n))) {
+            Error(_("video: out of memory\n"));
+            return;
         }
-#endif
+        if (avpkt->stream_index) { // only the already collected part
+            memcpy(buf->data, avpkt->data, avpkt->stream_index);
+        }
+        av_buffer_unref(&avpkt->buf);
+        avpkt->buf = buf;
+        avpkt->data = buf->data;
+        avpkt->size = buf->size - AV_INPUT_BUFFER_PADDING_SIZE;
     }
 
     memcpy(avpkt->data + avpkt->stream_index, data, size);
@@ -1408,6 +1788,38 @@ static void VideoEnqueue(VideoStream *stream, int64_t pts, int64_t dts, const vo
 #endif
 }
 
+/**
+**  Create the wakeup event of a video stream.
+**
+**  @returns eventfd, -1 if it can't be created.
+*/
+static int VideoStreamWakeupOpen(void) {
+    int fd;
+
+    if ((fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        Error(_("softhddev: can't create video wakeup event: %s\n"), strerror(errno));
+    }
+    return fd;
+}
+
+/**
+**  Wakeup the decoder thread waiting in VideoWaitInput().
+**
+**  @param stream   video stream
+*/
+static void VideoStreamWakeup(VideoStream *stream) {
+    uint64_t one;
+
+    if (stream->WakeupFd < 0) {
+        return;
+    }
+    one = 1;
+    // EAGAIN: counter overflow, decoder is woken anyway
+    if (write(stream->WakeupFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        Debug(3, "softhddev: %s: %s\n", __FUNCTION__, strerror(errno));
+    }
+}
+
 /**
 **  Reset current packet.
 **
@@ -1433,6 +1845,8 @@ static void VideoResetPacket(VideoStream *stream) {
 */
 static void VideoNextPacket(VideoStream *stream, int codec_id) {
     AVPacket *avpkt;
+    int bytes;
+    int n;
 
     avpkt = &stream->PacketRb[stream->PacketWrite];
     if (!avpkt->stream_index) { // ignore empty packets
@@ -1442,7 +1856,7 @@ static void VideoNextPacket(VideoStream *stream, int codec_id) {
         Debug(3, "video: possible stream change loss\n");
     }
 
-    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 1) {
+    if (atomic_read(&stream->PacketsFilled) >= VideoPacketLimit - 1) {
         // no free slot available drop last packet
         Error(_("video: no empty slot in packet ringbuffer\n"));
         avpkt->stream_index = 0;
@@ -1452,14 +1866,25 @@ static void VideoNextPacket(VideoStream *stream, int codec_id) {
         return;
     }
     // clear area for decoder, always enough space allocated
-    memset(avpkt->data + avpkt->stream_index, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    if (avpkt->buf) {
+        memset(avpkt->data + avpkt->stream_index, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        stream->PacketSizeHint = avpkt->stream_index;
+    }
 
     stream->CodecIDRb[stream->PacketWrite] = codec_id;
+    bytes = avpkt->buf ? avpkt->buf->size : 0;
+    stream->PacketBytesRb[stream->PacketWrite] = bytes;
     // DumpH264(avpkt->data, avpkt->stream_index);
 
     // advance packet write
     stream->PacketWrite = (stream->PacketWrite + 1) % VIDEO_PACKET_MAX;
-    atomic_inc(&stream->PacketsFilled);
+    if ((bytes = atomic_add(bytes, &stream->BytesFilled)) > stream->BytesHighWater) {
+        stream->BytesHighWater = bytes;
+    }
+    if ((n = atomic_inc(&stream->PacketsFilled)) > stream->PacketsHighWater) {
+        stream->PacketsHighWater = n;
+    }
+    VideoStreamWakeup(stream);
     VideoDisplayWakeup();
 
     // intialize next package to use
@@ -1475,8 +1900,6 @@ static void VideoNextPacket(VideoStream *stream, int codec_id) {
 **  Split the packet into single picture packets.
 **  Nick/CC, Viva, MediaShop, Deutsches Music Fernsehen
 **
-**  FIXME: this code can be written much faster
-**
 **  @param stream   video stream
 **  @param pts	presentation timestamp of pes packet
 **  @param data data of pes packet
@@ -1560,12 +1983,20 @@ static void VideoMpegEnqueue(VideoStream *stream, int64_t pts, int64_t dts, cons
     // b3 b4 b8 00 b5 ... 00 b5 ...
 
     while (n > 3) {
-        if (0 && !p[0] && !p[1] && p[2] == 0x01) {
-            fprintf(stderr, " %02x", p[3]);
+        const uint8_t *code;
+
+        // next start code, with its following byte inside packet
+        code = StartCodeScanUsed->Find(p, p + n - 1);
+        if (code == p + n - 1) { // none, keep last bytes for border check
+            p += n - 3;
+            n = 3;
+            break;
         }
+        n -= code - p;
+        p = code;
         // scan for picture header 0x00000100
         // FIXME: not perfect, must split at 0xb3 also
-        if (!p[0] && !p[1] && p[2] == 0x01 && !p[3]) {
+        if (!p[3]) {
             if (first) {
                 first = 0;
                 n -= 4;
@@ -1592,11 +2023,8 @@ static void VideoMpegEnqueue(VideoStream *stream, int64_t pts, int64_t dts, cons
             p += 4;
             continue;
         }
-        if (!p[0] && !p[1] && p[2] == 0x01 && p[3] == 0xb3) {
-            // printf("aspectratio %02x\n",p[7]>>4);
-        }
-        --n;
-        ++p;
+        n -= 3;
+        p += 3;
     }
 
     stream->StartCodeState = 0;
@@ -1659,13 +2087,22 @@ static void FixPacketForFFMpeg(VideoDecoder *vdecoder, AVPacket *avpkt) {
 #endif
 
     while (n > 3) {
+        uint8_t *code;
+
+        // next start code, with its following byte inside packet
+        code = (uint8_t *)StartCodeScanUsed->Find(p, p + n - 1);
+        if (code == p + n - 1) {
+            break;
+        }
+        n -= code - p;
+        p = code;
 #if STILL_DEBUG > 1
-        if (InStillPicture && !p[0] && !p[1] && p[2] == 0x01) {
+        if (InStillPicture) {
             fprintf(stderr, " %02x", p[3]);
         }
 #endif
         // scan for picture header 0x00000100
-        if (!p[0] && !p[1] && p[2] == 0x01 && !p[3]) {
+        if (!p[3]) {
             if (first) {
                 first = 0;
                 n -= 4;
@@ -1687,8 +2124,8 @@ static void FixPacketForFFMpeg(VideoDecoder *vdecoder, AVPacket *avpkt) {
             tmp->data = p;
             tmp->size = n;
         }
-        --n;
-        ++p;
+        n -= 3;
+        p += 3;
     }
 
 #if STILL_DEBUG > 1
@@ -1753,6 +2190,43 @@ static void VideoStreamClose(VideoStream *stream, int delhw) {
     stream->InvalidPesCounter = 0;
 }
 
+/**
+**  Wait for new video input.
+**
+**  Blocks until a PES packet or a command (clear, close, play) was
+**  queued for one of the streams, or the timeout expired.
+**
+**  @param streams  video streams to wait for
+**  @param n        number of streams
+**  @param timeout  maximum wait time in ms
+**
+**  @retval 1	new input
+**  @retval 0	timeout
+*/
+int VideoWaitInput(VideoStream *const *streams, int n, int timeout) {
+    struct pollfd fds[2];
+    uint64_t count;
+    int i;
+
+    if (n > 2) {
+        n = 2;
+    }
+    for (i = 0; i < n; ++i) {
+        fds[i].fd = streams[i]->WakeupFd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    if (poll(fds, n, timeout) <= 0) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        if (fds[i].revents & POLLIN && read(fds[i].fd, &count, sizeof(count)) < 0) {
+            Debug(3, "softhddev: %s: %s\n", __FUNCTION__, strerror(errno));
+        }
+    }
+    return 1;
+}
+
 /**
 **  Poll PES packet ringbuffer.
 **
@@ -1777,8 +2251,7 @@ int VideoPollInput(VideoStream *stream) {
         return 1;
     }
     if (stream->ClearBuffers) { // clear buffer request
-        atomic_set(&stream->PacketsFilled, 0);
-        stream->PacketRead = stream->PacketWrite;
+        VideoPacketClear(stream);
         // FIXME: ->Decoder already checked
         Debug(3, "Clear buffer request in Poll\n");
         if (stream->Decoder && stream->HwDecoder) {
@@ -1806,7 +2279,6 @@ int VideoPollInput(VideoStream *stream) {
 int VideoDecodeInput(VideoStream *stream, int trick) {
     int filled;
     AVPacket *avpkt;
-    int saved_size;
 
     if (!stream->Decoder) { // closing
 #ifdef DEBUG
@@ -1824,8 +2296,7 @@ int VideoDecodeInput(VideoStream *stream, int trick) {
         stream->ClearBuffers = 0;
 
     if (stream->ClearBuffers) { // clear buffer request
-        atomic_set(&stream->PacketsFilled, 0);
-        stream->PacketRead = stream->PacketWrite;
+        VideoPacketClear(stream);
         // FIXME: ->Decoder already checked
         if (stream->Decoder) {
             CodecVideoFlushBuffers(stream->Decoder);
@@ -1908,8 +2379,7 @@ int VideoDecodeInput(VideoStream *stream, int trick) {
             break;
     }
 
-    // avcodec_decode_video2 needs size
-    saved_size = avpkt->size;
+    // avcodec_decode_video2 needs size, the buffer is passed by reference
     avpkt->size = avpkt->stream_index;
     avpkt->stream_index = 0;
 
@@ -1937,10 +2407,12 @@ int VideoDecodeInput(VideoStream *stream, int trick) {
     }
 #endif
 
-    avpkt->size = saved_size;
-
 skip:
+    // give buffer back to the pool, if the decoder didn't keep it
+    av_packet_unref(avpkt);
+
     // advance packet read
+    atomic_sub(stream->PacketBytesRb[stream->PacketRead], &stream->BytesFilled);
     stream->PacketRead = (stream->PacketRead + 1) % VIDEO_PACKET_MAX;
     atomic_dec(&stream->PacketsFilled);
 
@@ -2118,7 +2590,7 @@ int PlayVideo3(VideoStream *stream, const uint8_t *data, int size) {
     }
     if (stream->NewStream) { // channel switched
         Debug(3, "video: new stream %dms\n", GetMsTicks() - VideoSwitch);
-        if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 1) {
+        if (atomic_read(&stream->PacketsFilled) >= VideoPacketLimit - 1) {
             Debug(3, "video: new video stream lost\n");
             return 0;
         }
@@ -2156,7 +2628,7 @@ int PlayVideo3(VideoStream *stream, const uint8_t *data, int size) {
         return size;
     }
     // hard limit buffer full: needed for replay
-    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10) {
+    if (VideoPacketsFull(stream, 10)) {
         // Debug(3, "video: video buffer full\n");
         return 0;
     }
@@ -2532,6 +3004,7 @@ void TrickSpeed(int speed) {
     }
     StreamFreezed = 0;
     MyVideoStream->Freezed = 0;
+    VideoStreamWakeup(MyVideoStream);
 }
 
 /**
@@ -2542,6 +3015,7 @@ void Clear(void) {
 
     VideoResetPacket(MyVideoStream); // terminate work
     MyVideoStream->ClearBuffers = 1;
+    VideoStreamWakeup(MyVideoStream);
     if (!SkipAudio) {
         AudioFlushBuffers();
         // NewAudioStream = 1;
@@ -2723,7 +3197,7 @@ int Poll(int timeout) {
         filled = atomic_read(&MyVideoStream->PacketsFilled);
         // soft limit + hard limit
         full = (used > AUDIO_MIN_BUFFER_FREE && filled > 3) || AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE ||
-               filled >= VIDEO_PACKET_MAX - 10;
+               VideoPacketsFull(MyVideoStream, 10);
 
         if (!full || !timeout) {
             return !full;
@@ -2813,6 +3287,8 @@ void OsdDrawARGB(int xi, int yi, int height, int width, int pitch, const uint8_t
 const char *CommandLineHelp(void) {
     return "  -a device\taudio device (fe. alsa: hw:0,0 oss: /dev/dsp)\n"
            "  -p device\taudio device for pass-through (hw:0,1 or /dev/dsp1)\n"
+           "  -B ms[:ms]\talsa buffer[:period] time (default 96)\n"
+           "  -P n[:MB]\tvideo packet ring limit packets[:megabytes] (default 256:64)\n"
            "  -c channel\taudio mixer channel name (fe. PCM)\n"
            "	-d display\tdisplay of x11 server (fe. :0.0)\n"
            "  -f\t\tstart with fullscreen window (only with window manager)\n"
@@ -2857,10 +3333,16 @@ int ProcessArgs(int argc, char *const argv[]) {
 #endif
 
     for (;;) {
-        switch (getopt(argc, argv, "-a:c:C:r:d:fg:p:S:sv:w:xDX:")) {
+        switch (getopt(argc, argv, "-a:B:c:C:r:d:fg:p:P:S:sv:w:xDX:")) {
             case 'a': // audio device for pcm
                 AudioSetDevice(optarg);
                 continue;
+            case 'B': // alsa buffer and period time
+                if (AudioSetAlsaBuffer(optarg) < 0) {
+                    fprintf(stderr, _("Bad formated alsa buffer time please use: <buffer ms>[:<period ms>]\n"));
+                    return 0;
+                }
+                continue;
             case 'c': // channel of audio mixer
                 AudioSetChannel(optarg);
                 continue;
@@ -2879,6 +3361,12 @@ int ProcessArgs(int argc, char *const argv[]) {
             case 'p': // pass-through audio device
                 AudioSetPassthroughDevice(optarg);
                 continue;
+            case 'P': // video packet ring limits
+                if (VideoSetPacketLimit(optarg) < 0) {
+                    fprintf(stderr, _("Bad formated video packet limit please use: <packets>[:<MB>]\n"));
+                    return 0;
+                }
+                continue;
             case 'd': // x11 display name
                 X11DisplayName = optarg;
                 continue;
@@ -3122,8 +3610,12 @@ void SoftHdDeviceExit(void) {
     pthread_mutex_destroy(&SuspendLockMutex);
 #ifdef USE_PIP
     pthread_mutex_destroy(&PipVideoStream->DecoderLockMutex);
+    close(PipVideoStream->WakeupFd);
+    PipVideoStream->WakeupFd = -1;
 #endif
     pthread_mutex_destroy(&MyVideoStream->DecoderLockMutex);
+    close(MyVideoStream->WakeupFd);
+    MyVideoStream->WakeupFd = -1;
 }
 
 /**
@@ -3138,10 +3630,13 @@ int Start(void) {
         StartXServer();
     }
     CodecInit();
+    Info(_("[softhddev] '%s' start code scanner used\n"), StartCodeInit());
 
     pthread_mutex_init(&MyVideoStream->DecoderLockMutex, NULL);
+    MyVideoStream->WakeupFd = VideoStreamWakeupOpen();
 #ifdef USE_PIP
     pthread_mutex_init(&PipVideoStream->DecoderLockMutex, NULL);
+    PipVideoStream->WakeupFd = VideoStreamWakeupOpen();
 #endif
     pthread_mutex_init(&SuspendLockMutex, NULL);
 
@@ -3164,6 +3659,9 @@ int Start(void) {
 
 #ifndef NO_TS_AUDIO
     PesInit(PesDemuxAudio);
+    if (!TsDemuxAudio->Pids) { // VDR sends only the audio pid
+        TsDemuxAddPid(TsDemuxAudio, TS_PID_ANY, TsAudioPayload, PesDemuxAudio);
+    }
 #endif
     Info(_("[softhddev] ready%s\n"),
          ConfigStartSuspended ? ConfigStartSuspended == -1 ? " detached" : " suspended" : "");
@@ -3180,6 +3678,7 @@ void Stop(void) {
 #ifdef DEBUG
     Debug(3, "video: max used PES packet size: %d\n", VideoMaxPacketSize);
 #endif
+    Debug(3, "audio: codec probe cache %u hits, %u misses\n", AudioProbeHits, AudioProbeMisses);
 }
 
 /**
@@ -3322,6 +3821,25 @@ void GetStats(int *missed, int *duped, int *dropped, int *counter, float *framet
     }
 }
 
+/**
+**  Get video packet ring statistics.
+**
+**  @param[out] filled	number of filled video packets
+**  @param[out] size	packet count limit of video packet ring
+**  @param[out] high	most filled video packets
+**  @param[out] bytes	buffer bytes of filled video packets
+**  @param[out] budget	byte budget of video packet ring
+**  @param[out] high_bytes	most buffer bytes of filled video packets
+*/
+void GetPacketStats(int *filled, int *size, int *high, int *bytes, int *budget, int *high_bytes) {
+    *filled = atomic_read(&MyVideoStream->PacketsFilled);
+    *size = VideoPacketLimit;
+    *high = MyVideoStream->PacketsHighWater;
+    *bytes = atomic_read(&MyVideoStream->BytesFilled);
+    *budget = VideoPacketBudget;
+    *high_bytes = MyVideoStream->BytesHighWater;
+}
+
 /**
 **  Scale the currently shown video.
 **
@@ -3421,6 +3939,7 @@ void PipStop(void) {
     ScaleVideo(0, 0, 0, 0);
 
     PipVideoStream->Close = 1;
+    VideoStreamWakeup(PipVideoStream);
     for (i = 0; PipVideoStream->Close && i < 50; ++i) {
         usleep(1 * 1000);
     }
@@ -3438,3 +3957,595 @@ void PipStop(void) {
 int PipPlayVideo(const uint8_t *data, int size) { return PlayVideo3(PipVideoStream, data, size); }
 
 #endif
+
+#ifdef SOFTHDDEV_TEST
+
+//////////////////////////////////////////////////////////////////////////////
+//  Test
+//////////////////////////////////////////////////////////////////////////////
+
+//
+//  Offline benchmark: a recorded transport stream is fed through the real
+//  PES demux, video packet ringbuffer and ffmpeg software decoder.  The
+//  video output is replaced by the stand-ins below, audio uses the noop
+//  module.  No vdr, tuner, x11 or gpu is needed.
+//
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <libavutil/pixdesc.h>
+
+#include "frameconv.h"
+
+int SysLogLevel;                       ///< show additional debug informations
+int ConfigAudioBufferTime;             ///< config size ms of audio buffer
+char ConfigVideoClearOnSwitch;         ///< config enable Clear on channel switch
+signed char VideoHardwareDecoder = -1; ///< flag use hardware decoder
+char VideoIgnoreRepeatPict;            ///< disable repeat pict warning
+int VideoAudioDelay;                   ///< audio/video delay
+AVBufferRef *HwDeviceContext;          ///< none, use software decoder
+
+///
+/// Latency samples of one benchmark stage.
+///
+typedef struct _bench_stage_ {
+    const char *Name;  ///< stage name
+    uint32_t *Samples; ///< latency samples in us
+    int Count;         ///< number of samples
+    int Max;           ///< number of allocated samples
+} BenchStage;
+
+static BenchStage BenchPlayVideo[1] = {{"PlayVideo", NULL, 0, 0}};        ///< pes to ringbuffer
+static BenchStage BenchPlayAudio[1] = {{"PlayTsAudio", NULL, 0, 0}};      ///< ts audio demux+decode
+static BenchStage BenchDecode[1] = {{"VideoDecodeInput", NULL, 0, 0}};    ///< packet decode
+static BenchStage BenchPesToFrame[1] = {{"PES to frame", NULL, 0, 0}};    ///< pes in, frame out
+static BenchStage BenchConvert[1] = {{"FrameConvConvert", NULL, 0, 0}};   ///< nv12/p010 conversion
+
+static volatile char BenchStop; ///< all input data played
+static int BenchFrames;         ///< number of decoded video frames
+static int BenchVideoFull;      ///< video ringbuffer full retries
+static int BenchAudioFull;      ///< audio buffer full retries
+static FrameConv *BenchConv;    ///< frame converter, NULL no conversion
+static AVFrame *BenchConvFrame; ///< converted frame
+
+#define BENCH_PTS_MAX 256 ///< size of pts to input time table
+
+static pthread_mutex_t BenchPtsMutex;         ///< lock pts table
+static int64_t BenchPts[BENCH_PTS_MAX];       ///< pts of played pes packet
+static uint64_t BenchPtsTicks[BENCH_PTS_MAX]; ///< time pes packet was played
+static int BenchPtsWrite;                     ///< pts table write index
+
+/**
+**  Get monotonic ticks in ns.
+*/
+static uint64_t BenchTicks(void) {
+    struct timespec tspec;
+
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000 * 1000 * 1000 + tspec.tv_nsec;
+}
+
+/**
+**  Add latency sample to benchmark stage.
+**
+**  @param stage    benchmark stage
+**  @param ns	    latency in ns
+*/
+static void BenchAdd(BenchStage *stage, uint64_t ns) {
+    if (stage->Count >= stage->Max) {
+        stage->Max = stage->Max ? stage->Max * 2 : 64 * 1024;
+        if (!(stage->Samples = realloc(stage->Samples, stage->Max * sizeof(*stage->Samples)))) {
+            Fatal(_("[softhddev] out of memory\n"));
+        }
+    }
+    stage->Samples[stage->Count++] = ns / 1000;
+}
+
+/**
+**  Compare two latency samples for qsort.
+*/
+static int BenchCompare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+**  Print latency percentiles of benchmark stage.
+**
+**  @param stage    benchmark stage
+*/
+static void BenchReport(BenchStage *stage) {
+    const uint32_t *s;
+    int n;
+
+    n = stage->Count;
+    if (!n) {
+        printf("%-18s %9d\n", stage->Name, 0);
+        return;
+    }
+    qsort(stage->Samples, n, sizeof(*stage->Samples), BenchCompare);
+    s = stage->Samples;
+    printf("%-18s %9d %9u %9u %9u %9u\n", stage->Name, n, s[n / 2], s[(n * 90) / 100], s[(n * 99) / 100], s[n - 1]);
+}
+
+//----------------------------------------------------------------------------
+//  Video output stand-in
+//----------------------------------------------------------------------------
+
+///
+/// Benchmark video hardware decoder.
+///
+struct _video_hw_decoder_ {
+    VideoStream *Stream; ///< video stream
+};
+
+static VideoHwDecoder BenchHwDecoder[1];      ///< only one decoder needed
+static const char *BenchVideoDevice = "noop"; ///< video output device
+
+VideoHwDecoder *VideoNewHwDecoder(VideoStream *stream) {
+    BenchHwDecoder->Stream = stream;
+    return BenchHwDecoder;
+}
+
+void VideoDelHwDecoder(__attribute__((unused)) VideoHwDecoder *hw_decoder) {}
+
+/**
+**  Select the first software pixel format offered by the codec.
+*/
+enum AVPixelFormat Video_get_format(__attribute__((unused)) VideoHwDecoder *hw_decoder,
+                                    __attribute__((unused)) AVCodecContext *video_ctx,
+                                    const enum AVPixelFormat *fmt) {
+    for (; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+        if (!(av_pix_fmt_desc_get(*fmt)->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            return *fmt;
+        }
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+/**
+**  Consume decoded frame and record the pes to frame latency.
+*/
+void VideoRenderFrame(__attribute__((unused)) VideoHwDecoder *hw_decoder,
+                      __attribute__((unused)) const AVCodecContext *video_ctx, const AVFrame *frame) {
+    AVFrame *tmp;
+    uint64_t ticks;
+    int i;
+
+    ticks = BenchTicks();
+    if (frame->pts != (int64_t)AV_NOPTS_VALUE) {
+        pthread_mutex_lock(&BenchPtsMutex);
+        for (i = 0; i < BENCH_PTS_MAX; ++i) {
+            if (BenchPts[i] == frame->pts) {
+                BenchAdd(BenchPesToFrame, ticks - BenchPtsTicks[i]);
+                BenchPts[i] = AV_NOPTS_VALUE;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&BenchPtsMutex);
+    }
+    ++BenchFrames;
+
+    // convert like the upload of the software decoder
+    if (BenchConv) {
+        ticks = BenchTicks();
+        if (FrameConvConvert(BenchConv, BenchConvFrame, frame) < 0) {
+            Fatal(_("[softhddev] can't convert %s frame\n"), av_get_pix_fmt_name(frame->format));
+        }
+        BenchAdd(BenchConvert, BenchTicks() - ticks);
+    }
+
+    tmp = (AVFrame *)frame; // we own the frame
+    av_frame_free(&tmp);
+}
+
+AVFrame *VideoGetFrame(__attribute__((unused)) VideoHwDecoder *hw_decoder) { return av_frame_alloc(); }
+void VideoPutFrame(__attribute__((unused)) VideoHwDecoder *hw_decoder, AVFrame *frame) { av_frame_free(&frame); }
+
+void *VideoGetHwAccelContext(__attribute__((unused)) VideoHwDecoder *hw_decoder) { return NULL; }
+
+int CuvidTestSurfaces(void) { return 1; }
+int CuvidWaitSurfaces(__attribute__((unused)) int timeout) { return 1; }
+
+#if defined(YADIF) || defined(VAAPI)
+int init_filters(__attribute__((unused)) AVCodecContext *dec_ctx, __attribute__((unused)) void *decoder,
+                 __attribute__((unused)) AVFrame *frame) {
+    return -1;
+}
+
+int push_filters(__attribute__((unused)) AVCodecContext *dec_ctx, __attribute__((unused)) void *decoder,
+                 __attribute__((unused)) AVFrame *frame) {
+    return -1;
+}
+#endif
+
+const char *VideoGetDriverName(void) { return BenchVideoDevice; }
+void VideoSetDevice(const char *device) { BenchVideoDevice = device; }
+void VideoDisplayWakeup(void) {}
+void VideoInit(__attribute__((unused)) const char *display_name) {}
+void VideoExit(void) {}
+void VideoOsdInit(void) {}
+void VideoOsdExit(void) {}
+void VideoOsdClear(void) {}
+
+void VideoOsdDrawARGB(__attribute__((unused)) int xi, __attribute__((unused)) int yi,
+                      __attribute__((unused)) int width, __attribute__((unused)) int height,
+                      __attribute__((unused)) int pitch, __attribute__((unused)) const uint8_t *argb,
+                      __attribute__((unused)) int x, __attribute__((unused)) int y) {}
+
+void VideoGetOsdSize(int *width, int *height) {
+    *width = 1920;
+    *height = 1080;
+}
+
+int64_t VideoGetClock(__attribute__((unused)) const VideoHwDecoder *hw_decoder) { return AV_NOPTS_VALUE; }
+void VideoSetClosing(__attribute__((unused)) VideoHwDecoder *hw_decoder) {}
+void VideoResetStart(__attribute__((unused)) VideoHwDecoder *hw_decoder) {}
+void VideoSetTrickSpeed(__attribute__((unused)) VideoHwDecoder *hw_decoder, __attribute__((unused)) int speed) {}
+
+uint8_t *VideoGrab(__attribute__((unused)) int *size, __attribute__((unused)) int *width,
+                   __attribute__((unused)) int *height, __attribute__((unused)) int write_header) {
+    return NULL;
+}
+
+void VideoGetStats(__attribute__((unused)) VideoHwDecoder *hw_decoder, int *missed, int *duped, int *dropped,
+                   int *counter, float *frametime, int *width, int *height, int *color, int *eotf) {
+    *missed = 0;
+    *duped = 0;
+    *dropped = 0;
+    *counter = BenchFrames;
+    *frametime = 0.0;
+    *width = 0;
+    *height = 0;
+    *color = 0;
+    *eotf = 0;
+}
+
+void VideoGetVideoSize(__attribute__((unused)) VideoHwDecoder *hw_decoder, int *width, int *height,
+                       int *aspect_num, int *aspect_den) {
+    *width = 0;
+    *height = 0;
+    *aspect_num = 1;
+    *aspect_den = 1;
+}
+
+void VideoSetOutputPosition(__attribute__((unused)) VideoHwDecoder *hw_decoder, __attribute__((unused)) int x,
+                            __attribute__((unused)) int y, __attribute__((unused)) int width,
+                            __attribute__((unused)) int height) {}
+
+void VideoSetFullscreen(__attribute__((unused)) int onoff) {}
+int VideoSetGeometry(__attribute__((unused)) const char *geometry) { return 0; }
+int VideoSetShader(__attribute__((unused)) char *shader) { return 0; }
+void VideoSetRefresh(__attribute__((unused)) char *refresh) {}
+void VideoSetConnector(__attribute__((unused)) char *connector) {}
+
+uint8_t *CreateJpeg(__attribute__((unused)) uint8_t *image, __attribute__((unused)) int *size,
+                    __attribute__((unused)) int quality, __attribute__((unused)) int width,
+                    __attribute__((unused)) int height) {
+    return NULL;
+}
+
+void DelPip(void) {}
+
+//----------------------------------------------------------------------------
+//  Benchmark
+//----------------------------------------------------------------------------
+
+/**
+**  Video decoder thread, replaces the video module display handler.
+*/
+static void *BenchDecoderThread(void *dummy) {
+    VideoStream *streams[1] = {MyVideoStream};
+
+    for (;;) {
+        uint64_t ticks;
+
+        ticks = BenchTicks();
+        if (!VideoDecodeInput(MyVideoStream, 0)) {
+            BenchAdd(BenchDecode, BenchTicks() - ticks);
+            continue;
+        }
+        if (BenchStop && !atomic_read(&MyVideoStream->PacketsFilled)) {
+            break;
+        }
+        VideoWaitInput(streams, 1, 10);
+    }
+    return dummy;
+}
+
+/**
+**  Play one complete video PES packet.
+**
+**  @param data data of complete PES packet
+**  @param size size of PES packet
+*/
+static void BenchPlayPes(const uint8_t *data, int size) {
+    uint64_t ticks;
+
+    if (size > 14 && (data[7] & 0x80)) { // remember pts for latency
+        pthread_mutex_lock(&BenchPtsMutex);
+        BenchPts[BenchPtsWrite] = (int64_t)(data[9] & 0x0E) << 29 | data[10] << 22 | (data[11] & 0xFE) << 14 |
+                                  data[12] << 7 | (data[13] & 0xFE) >> 1;
+        BenchPtsTicks[BenchPtsWrite] = BenchTicks();
+        BenchPtsWrite = (BenchPtsWrite + 1) % BENCH_PTS_MAX;
+        pthread_mutex_unlock(&BenchPtsMutex);
+    }
+    for (;;) {
+        ticks = BenchTicks();
+        if (PlayVideo(data, size)) {
+            BenchAdd(BenchPlayVideo, BenchTicks() - ticks);
+            return;
+        }
+        ++BenchVideoFull;
+        usleep(1 * 1000); // decoder behind, wait
+    }
+}
+
+#ifndef NO_TS_AUDIO
+
+/**
+**  Play one audio TS packet.
+**
+**  @param data data of TS packet
+*/
+static void BenchPlayTsAudio(const uint8_t *data) {
+    uint64_t ticks;
+
+    for (;;) {
+        ticks = BenchTicks();
+        if (PlayTsAudio(data, TS_PACKET_SIZE)) {
+            BenchAdd(BenchPlayAudio, BenchTicks() - ticks);
+            return;
+        }
+        ++BenchAudioFull;
+        usleep(1 * 1000); // audio buffer full, wait
+    }
+}
+
+#endif
+
+/**
+**  Print version.
+*/
+static void PrintVersion(void) {
+    printf("softhddev_test: decode benchmark Version " VERSION
+#ifdef GIT_REV
+           "(GIT-" GIT_REV ")"
+#endif
+           ",\n\tLicense AGPLv3: GNU Affero General Public License version 3\n");
+}
+
+/**
+**  Print usage.
+*/
+static void PrintUsage(void) {
+    printf("Usage: softhddev_test [-?dhn] [-a pid] [-p pid] [-c bands] [-t threads] file.ts\n"
+           "\t-a pid\taudio pid (default first audio PES stream)\n"
+           "\t-p pid\tvideo pid (default first video PES stream)\n"
+           "\t-c bands\tconvert frames to nv12/p010 in bands threads\n"
+           "\t-t threads\tvideo decoder threads (default 0 all cpus)\n"
+           "\t-n\tdon't play audio\n"
+           "\t-d\tenable debug, more -d increase the verbosity\n"
+           "\t-? -h\tdisplay this message\n");
+}
+
+/**
+**  Main entry point.
+**
+**  @param argc	number of arguments
+**  @param argv	arguments vector
+**
+**  @returns -1 on failures, 0 clean exit.
+*/
+int main(int argc, char *const argv[]) {
+    static uint8_t buf[TS_PACKET_SIZE * 1024];
+    pthread_t thread;
+    struct rusage usage;
+    uint8_t *pes;
+    int pes_size;
+    int pes_max;
+    int video_pid;
+    int audio_pid;
+    int no_audio;
+    int conv_bands;
+    int ts_packets;
+    int pes_packets;
+    int fill;
+    int fd;
+    uint64_t start;
+    double secs;
+
+    video_pid = -1;
+    audio_pid = -1;
+    no_audio = 0;
+    conv_bands = 0;
+
+    //
+    //	Parse command line arguments
+    //
+    for (;;) {
+        switch (getopt(argc, argv, "hn?-a:c:dp:t:")) {
+            case 'a': // audio pid
+                audio_pid = strtol(optarg, NULL, 0);
+                continue;
+            case 'p': // video pid
+                video_pid = strtol(optarg, NULL, 0);
+                continue;
+            case 'c': // frame conversion bands
+                conv_bands = strtol(optarg, NULL, 0);
+                continue;
+            case 't': // decoder threads
+                CodecSoftwareThreads = strtol(optarg, NULL, 0);
+                continue;
+            case 'n': // no audio
+                no_audio = 1;
+                continue;
+            case 'd': // enabled debug
+                ++SysLogLevel;
+                continue;
+            case EOF:
+                break;
+            case '?':
+            case 'h': // help usage
+                PrintVersion();
+                PrintUsage();
+                return 0;
+            default:
+                PrintVersion();
+                PrintUsage();
+                return -1;
+        }
+        break;
+    }
+    if (optind + 1 != argc) {
+        PrintVersion();
+        PrintUsage();
+        return -1;
+    }
+    if ((fd = open(argv[optind], O_RDONLY)) < 0) {
+        fprintf(stderr, "softhddev_test: can't open '%s'\n", argv[optind]);
+        return -1;
+    }
+
+    pthread_mutex_init(&BenchPtsMutex, NULL);
+    for (fill = 0; fill < BENCH_PTS_MAX; ++fill) {
+        BenchPts[fill] = AV_NOPTS_VALUE;
+    }
+    if (conv_bands > 0) {
+        if (!(BenchConv = FrameConvNew(conv_bands)) || !(BenchConvFrame = av_frame_alloc())) {
+            Fatal(_("[softhddev] out of memory\n"));
+        }
+    }
+    AudioSetDevice("noop");
+    Start();
+    pthread_create(&thread, NULL, BenchDecoderThread, NULL);
+
+    pes_max = 512 * 1024;
+    if (!(pes = malloc(pes_max))) {
+        Fatal(_("[softhddev] out of memory\n"));
+    }
+    pes_size = 0;
+    ts_packets = 0;
+    pes_packets = 0;
+    fill = 0;
+    start = BenchTicks();
+
+    for (;;) {
+        const uint8_t *p;
+        int n;
+
+        n = read(fd, buf + fill, sizeof(buf) - fill);
+        if (n <= 0) {
+            break;
+        }
+        fill += n;
+        p = buf;
+        while (fill >= TS_PACKET_SIZE) {
+            const uint8_t *payload;
+            int pid;
+            int size;
+
+            if (p[0] != TS_PACKET_SYNC) { // resync
+                ++p;
+                --fill;
+                continue;
+            }
+            ++ts_packets;
+            pid = (p[1] & 0x1F) << 8 | p[2];
+            payload = p + 4;
+            if (p[3] & 0x20) { // adaptation field
+                payload += p[4] + 1;
+            }
+            size = p + TS_PACKET_SIZE - payload;
+            if ((p[1] & 0x80) || !(p[3] & 0x10) || size <= 0) { // error or no payload
+                goto next;
+            }
+            // auto detect pids from the PES stream ids
+            if ((p[1] & 0x40) && size > 3 && !payload[0] && !payload[1] && payload[2] == 0x01) {
+                if (video_pid < 0 && (payload[3] & 0xF0) == 0xE0) {
+                    video_pid = pid;
+                    printf("softhddev_test: video pid %d\n", pid);
+                } else if (audio_pid < 0 && ((payload[3] & 0xE0) == 0xC0 || payload[3] == PES_PRIVATE_STREAM1)) {
+                    audio_pid = pid;
+                    printf("softhddev_test: audio pid %d\n", pid);
+                }
+            }
+
+            if (pid == video_pid) {
+                if (p[1] & 0x40) { // start of new PES packet
+                    if (pes_size) {
+                        BenchPlayPes(pes, pes_size);
+                        ++pes_packets;
+                    }
+                    pes_size = 0;
+                } else if (!pes_size) { // wait for start
+                    goto next;
+                }
+                if (pes_size + size > pes_max) {
+                    pes_max *= 2;
+                    if (!(pes = realloc(pes, pes_max))) {
+                        Fatal(_("[softhddev] out of memory\n"));
+                    }
+                }
+                memcpy(pes + pes_size, payload, size);
+                pes_size += size;
+#ifndef NO_TS_AUDIO
+            } else if (pid == audio_pid && !no_audio) {
+                BenchPlayTsAudio(p);
+#endif
+            }
+          next:
+            p += TS_PACKET_SIZE;
+            fill -= TS_PACKET_SIZE;
+        }
+        memmove(buf, p, fill);
+    }
+    close(fd);
+
+    if (pes_size) {
+        BenchPlayPes(pes, pes_size);
+        ++pes_packets;
+    }
+    free(pes);
+    // flush the last, still open, packet
+    if (MyVideoStream->PacketRb[MyVideoStream->PacketWrite].stream_index) {
+        VideoNextPacket(MyVideoStream, MyVideoStream->CodecID);
+    }
+    BenchStop = 1;
+    pthread_join(thread, NULL);
+
+    secs = (BenchTicks() - start) / 1e9;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("softhddev_test: %d ts packets, %d video pes packets, %d frames in %.3fs\n", ts_packets, pes_packets,
+           BenchFrames, secs);
+    printf("%.0f ts packets/s, %.0f pes packets/s, %.1f frames/s\n", ts_packets / secs, pes_packets / secs,
+           BenchFrames / secs);
+    printf("cpu %.3fs user %.3fs system, peak rss %ld kB\n", usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6, usage.ru_maxrss);
+    printf("buffer full retries: video %d audio %d\n", BenchVideoFull, BenchAudioFull);
+    printf("decoder threads %d, conversion bands %d\n", CodecSoftwareThreads,
+           BenchConv ? FrameConvThreads(BenchConv) : 0);
+    printf("%-18s %9s %9s %9s %9s %9s\n", "stage [us]", "count", "p50", "p90", "p99", "max");
+    BenchReport(BenchPlayVideo);
+    BenchReport(BenchPlayAudio);
+    BenchReport(BenchDecode);
+    BenchReport(BenchPesToFrame);
+    BenchReport(BenchConvert);
+
+    StopVideo();
+    AudioExit();
+    CodecExit();
+    if (BenchConv) {
+        FrameConvDel(BenchConv);
+        av_frame_free(&BenchConvFrame);
+    }
+
+    return 0;
+}
+
+#endif
@@ -94,6 +94,8 @@ extern void Resume(void);
 
 /// Get decoder statistics
 extern void GetStats(int *, int *, int *, int *, float *, int *, int *, int *, int *);
+/// Get video packet ring statistics
+extern void GetPacketStats(int *, int *, int *, int *, int *, int *);
 /// C plugin scale video
 extern void ScaleVideo(int, int, int, int);
 
@@ -106,6 +108,24 @@ extern void PipStop(void);
 /// Pip play video packet
 extern int PipPlayVideo(const uint8_t *, int);
 
+/// transport stream demuxer typedef
+typedef struct _ts_demux_ TsDemux;
+/// transport stream payload handler typedef
+typedef void TsPayloadHandler(void *, const uint8_t *, int, int);
+/// packet id of a handler for all not handled pids
+#define TS_PID_ANY -1
+
+/// Allocate transport stream demuxer
+extern TsDemux *TsDemuxNew(void);
+/// Free transport stream demuxer
+extern void TsDemuxDel(TsDemux *);
+/// Add pid handler to transport stream demuxer
+extern int TsDemuxAddPid(TsDemux *, int, TsPayloadHandler *, void *);
+/// Demux transport stream packets
+extern int TsDemuxer(TsDemux *, const uint8_t *, int);
+/// Get transport stream demuxer statistics
+extern int TsDemuxStats(const TsDemux *, char *, int);
+
 extern const char *X11DisplayName; ///< x11 display name
 #ifdef __cplusplus
 }
@@ -0,0 +1,446 @@
+///
+/// @file startcode.c	@brief Start code scanner module
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+/// @defgroup StartCode The start code scanner module.
+///
+/// Finds the 0x00 0x00 0x01 start code prefix in MPEG-2, H.264 and
+/// HEVC elementary streams.
+///
+/// The vector scanners work like memchr() on the middle zero byte of
+/// the prefix: a block without any zero byte is skipped with one
+/// compare, only blocks with zero bytes are checked for the complete
+/// prefix.  All scanners must find the same start code as the plain C
+/// scanner.  The fastest scanner supported by the cpu is selected at
+/// runtime by StartCodeInit().
+///
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_START_CODE_X86 ///< build SSE2 and AVX2 scanners
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#define USE_START_CODE_NEON ///< build NEON scanner
+#include <arm_neon.h>
+#endif
+
+#include "startcode.h"
+
+//----------------------------------------------------------------------------
+//  C
+//----------------------------------------------------------------------------
+
+/**
+**	Find first start code prefix.
+**
+**	@param data	begin of buffer
+**	@param end	end of buffer
+**
+**	@returns pointer to the prefix, @a end if no complete prefix found.
+*/
+static const uint8_t *StartCodeFindC(const uint8_t *data, const uint8_t *end) {
+    for (; end - data >= 3; ++data) {
+        if (!data[0] && !data[1] && data[2] == 0x01) {
+            return data;
+        }
+    }
+    return end;
+}
+
+///
+///	Plain C start code scanner.
+///
+static const StartCodeScan StartCodeCScan = {
+    .Name = "c",
+    .Find = StartCodeFindC,
+};
+
+#ifdef USE_START_CODE_X86
+
+//----------------------------------------------------------------------------
+//  SSE2
+//----------------------------------------------------------------------------
+
+/**
+**	Find first start code prefix (SSE2).
+**
+**	A prefix starting at data[i] needs a zero at data[i + 1], a block
+**	of 16 start positions is skipped, when data[1] ... data[16] has no
+**	zero.
+**
+**	@param data	begin of buffer
+**	@param end	end of buffer
+**
+**	@returns pointer to the prefix, @a end if no complete prefix found.
+*/
+static __attribute__((target("sse2"))) const uint8_t *StartCodeFindSse2(const uint8_t *data, const uint8_t *end) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(0x01);
+
+    while (end - data >= 16 + 2) {
+        __m128i z;
+        unsigned mask;
+
+        z = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 1)), zero);
+        if (_mm_movemask_epi8(z)) {
+            z = _mm_and_si128(z, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)data), zero));
+            z = _mm_and_si128(z, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + 2)), one));
+            if ((mask = _mm_movemask_epi8(z))) {
+                return data + __builtin_ctz(mask);
+            }
+        }
+        data += 16;
+    }
+    return StartCodeFindC(data, end);
+}
+
+///
+///	SSE2 start code scanner.
+///
+static const StartCodeScan StartCodeSse2Scan = {
+    .Name = "sse2",
+    .Find = StartCodeFindSse2,
+};
+
+//----------------------------------------------------------------------------
+//  AVX2
+//----------------------------------------------------------------------------
+
+/**
+**	Find first start code prefix (AVX2).
+**
+**	@param data	begin of buffer
+**	@param end	end of buffer
+**
+**	@returns pointer to the prefix, @a end if no complete prefix found.
+*/
+static __attribute__((target("avx2"))) const uint8_t *StartCodeFindAvx2(const uint8_t *data, const uint8_t *end) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(0x01);
+
+    while (end - data >= 32 + 2) {
+        __m256i z;
+        unsigned mask;
+
+        z = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + 1)), zero);
+        if (_mm256_movemask_epi8(z)) {
+            z = _mm256_and_si256(z, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)data), zero));
+            z = _mm256_and_si256(z, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + 2)), one));
+            if ((mask = _mm256_movemask_epi8(z))) {
+                return data + __builtin_ctz(mask);
+            }
+        }
+        data += 32;
+    }
+    return StartCodeFindSse2(data, end);
+}
+
+///
+///	AVX2 start code scanner.
+///
+static const StartCodeScan StartCodeAvx2Scan = {
+    .Name = "avx2",
+    .Find = StartCodeFindAvx2,
+};
+
+#endif
+
+#ifdef USE_START_CODE_NEON
+
+//----------------------------------------------------------------------------
+//  NEON
+//----------------------------------------------------------------------------
+
+/**
+**	Check if any byte of vector is set.
+*/
+static inline int StartCodeAnyNeon(uint8x16_t v) {
+#ifdef __aarch64__
+    return vmaxvq_u8(v);
+#else
+    uint8x8_t t;
+
+    t = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    return vget_lane_u64(vreinterpret_u64_u8(t), 0) != 0;
+#endif
+}
+
+/**
+**	Find first start code prefix (NEON).
+**
+**	NEON has no byte mask move, the position inside a matching block
+**	is searched with the C scanner.
+**
+**	@param data	begin of buffer
+**	@param end	end of buffer
+**
+**	@returns pointer to the prefix, @a end if no complete prefix found.
+*/
+static const uint8_t *StartCodeFindNeon(const uint8_t *data, const uint8_t *end) {
+    const uint8x16_t zero = vdupq_n_u8(0x00);
+    const uint8x16_t one = vdupq_n_u8(0x01);
+
+    while (end - data >= 16 + 2) {
+        uint8x16_t z;
+
+        z = vceqq_u8(vld1q_u8(data + 1), zero);
+        if (StartCodeAnyNeon(z)) {
+            z = vandq_u8(z, vceqq_u8(vld1q_u8(data), zero));
+            z = vandq_u8(z, vceqq_u8(vld1q_u8(data + 2), one));
+            if (StartCodeAnyNeon(z)) {
+                return StartCodeFindC(data, data + 16 + 2);
+            }
+        }
+        data += 16;
+    }
+    return StartCodeFindC(data, end);
+}
+
+///
+///	NEON start code scanner.
+///
+static const StartCodeScan StartCodeNeonScan = {
+    .Name = "neon",
+    .Find = StartCodeFindNeon,
+};
+
+#endif
+
+//----------------------------------------------------------------------------
+//  Scanner selection
+//----------------------------------------------------------------------------
+
+const StartCodeScan *StartCodeScanUsed = &StartCodeCScan; ///< selected start code scanner
+
+/**
+**	Select the fastest start code scanner supported by the cpu.
+**
+**	Setting the environment variable SOFTHD_START_CODE to "c" forces
+**	the plain C scanner.
+**
+**	@returns name of the selected scanner.
+*/
+const char *StartCodeInit(void) {
+    const char *env;
+
+    StartCodeScanUsed = &StartCodeCScan;
+    env = getenv("SOFTHD_START_CODE");
+    if (env && !strcmp(env, "c")) {
+        return StartCodeScanUsed->Name;
+    }
+#ifdef USE_START_CODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        StartCodeScanUsed = &StartCodeAvx2Scan;
+    } else if (__builtin_cpu_supports("sse2")) {
+        StartCodeScanUsed = &StartCodeSse2Scan;
+    }
+#endif
+#ifdef USE_START_CODE_NEON
+    StartCodeScanUsed = &StartCodeNeonScan;
+#endif
+    return StartCodeScanUsed->Name;
+}
+
+#ifdef STARTCODE_TEST
+
+//----------------------------------------------------------------------------
+//  Test
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+
+/**
+**	Fill buffer with random bytes and some start codes.
+**
+**	Zero bytes are made frequent, to hit all the partial prefixes.
+*/
+static void StartCodeTestFill(uint8_t *data, int n) {
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        switch (random() % 16) {
+            case 0:
+            case 1:
+            case 2:
+                data[i] = 0x00;
+                break;
+            case 3:
+                data[i] = 0x01;
+                break;
+            default:
+                data[i] = random();
+                break;
+        }
+    }
+}
+
+/**
+**	Count all start codes of buffer.
+**
+**	@param scan	scanner to use
+**	@param data	begin of buffer
+**	@param end	end of buffer
+*/
+static int StartCodeTestCount(const StartCodeScan *scan, const uint8_t *data, const uint8_t *end) {
+    int count;
+
+    count = 0;
+    while ((data = scan->Find(data, end)) != end) {
+        ++count;
+        data += 3;
+    }
+    return count;
+}
+
+/**
+**	Compare a scanner with the plain C scanner.
+**
+**	@param scan	scanner to check
+**
+**	@returns number of found differences.
+*/
+static int StartCodeTestCompare(const StartCodeScan *scan) {
+    uint8_t buf[256];
+    int errors;
+    int loop;
+
+    errors = 0;
+    for (loop = 0; loop < 200000; ++loop) {
+        const uint8_t *end;
+        int o;
+        int n;
+
+        o = random() % 32; // unaligned buffers
+        n = random() % (sizeof(buf) - o);
+        StartCodeTestFill(buf, sizeof(buf));
+        end = buf + o + n;
+        if (StartCodeCScan.Find(buf + o, end) != scan->Find(buf + o, end)) {
+            printf("%s: %d bytes at offset %d differ\n", scan->Name, n, o);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/**
+**	Time a scanner on a buffer.
+**
+**	@param scan	scanner to measure
+**	@param data	begin of buffer
+**	@param size	size of buffer
+*/
+static void StartCodeTestBench(const StartCodeScan *scan, const uint8_t *data, size_t size) {
+    struct timespec start;
+    struct timespec end;
+    double ms;
+    int count;
+    int loop;
+
+    count = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (loop = 0; loop < 20; ++loop) {
+        count += StartCodeTestCount(scan, data, data + size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    printf("%-5s: %8.3f ms per pass %8.1f MiB/s %d start codes\n", scan->Name, ms / 20,
+           (size * 20.0) / (1024.0 * 1024.0) / (ms / 1000.0), count / 20);
+}
+
+/**
+**	Check and benchmark all scanners, which the cpu supports.
+**
+**	Without argument the scanners are timed on random data, a
+**	recorded stream (f.e. a .ts or .es file) gives real numbers.
+**
+**	@param argc	number of arguments
+**	@param argv	arguments vector
+*/
+int main(int argc, char *const argv[]) {
+    const StartCodeScan *scans[4];
+    uint8_t *data;
+    size_t size;
+    int errors;
+    int n;
+    int i;
+
+    n = 0;
+    scans[n++] = &StartCodeCScan;
+#ifdef USE_START_CODE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        scans[n++] = &StartCodeSse2Scan;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        scans[n++] = &StartCodeAvx2Scan;
+    }
+#endif
+#ifdef USE_START_CODE_NEON
+    scans[n++] = &StartCodeNeonScan;
+#endif
+    printf("selected: %s\n", StartCodeInit());
+
+    errors = 0;
+    for (i = 1; i < n; ++i) {
+        errors += StartCodeTestCompare(scans[i]);
+    }
+
+    size = 64 * 1024 * 1024;
+    if (!(data = malloc(size))) {
+        printf("out of memory\n");
+        return 1;
+    }
+    if (argc > 1) {
+        FILE *file;
+
+        if (!(file = fopen(argv[1], "rb"))) {
+            printf("can't open '%s'\n", argv[1]);
+            return 1;
+        }
+        size = fread(data, 1, size, file);
+        fclose(file);
+        printf("%zu bytes of '%s'\n", size, argv[1]);
+    } else {
+        srandom(1); // same data for all scanners
+        for (i = 0; i < (int)size; ++i) {
+            data[i] = random();
+        }
+        printf("%zu random bytes\n", size);
+    }
+    for (i = 0; i < n; ++i) {
+        StartCodeTestBench(scans[i], data, size);
+    }
+    free(data);
+
+    if (errors) {
+        printf("%d differences\n", errors);
+        return 1;
+    }
+    printf("all scanners match\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,53 @@
+///
+/// @file startcode.h	@brief Start code scanner module headerfile
+///
+/// Contributor(s):
+///
+/// License: AGPLv3
+///
+/// This program is free software: you can redistribute it and/or modify
+/// it under the terms of the GNU Affero General Public License as
+/// published by the Free Software Foundation, either version 3 of the
+/// License.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU Affero General Public License for more details.
+///
+/// $Id$
+//////////////////////////////////////////////////////////////////////////////
+
+/// @addtogroup StartCode
+/// @{
+
+//----------------------------------------------------------------------------
+//  Typedefs
+//----------------------------------------------------------------------------
+
+///
+///	Start code scanner.
+///
+///	Find returns the first 0x00 0x00 0x01 prefix, which lies completely
+///	inside the buffer, or the end of the buffer if there is none.
+///
+typedef struct _start_code_scan_ {
+    const char *Name; ///< scanner name
+
+    /// find first start code prefix in data ... end
+    const uint8_t *(*const Find)(const uint8_t *, const uint8_t *);
+} StartCodeScan;
+
+//----------------------------------------------------------------------------
+//  Variables
+//----------------------------------------------------------------------------
+
+extern const StartCodeScan *StartCodeScanUsed; ///< selected start code scanner
+
+//----------------------------------------------------------------------------
+//  Prototypes
+//----------------------------------------------------------------------------
+
+extern const char *StartCodeInit(void); ///< select scanner for this cpu
+
+/// @}
@@ -101,6 +101,9 @@
 #include <xcb/dpms.h>
 #include <xcb/screensaver.h>
 #endif
+#ifdef USE_XRANDR
+#include <xcb/randr.h>
+#endif
 
 // #include <xcb/shm.h>
 // #include <xcb/xv.h>
@@ -210,6 +213,7 @@ GLenum glewInit(void);
 #include "video.h"
 #include "audio.h"
 #include "codec.h"
+#include "frameconv.h"
 // clang-format on
 
 #if defined(APIVERSNUM) && APIVERSNUM < 20400
@@ -338,6 +342,10 @@ typedef struct {
 
 #define VIDEO_SURFACES_MAX 6 ///< video output surfaces for queue
 
+#define VIDEO_FRAME_POOL CODEC_SURFACES_MAX ///< free AVFrame shells kept
+
+#define VIDEO_REFRESH_FRAMES 50 ///< frames with stable rate before refresh switch
+
 #define NUM_SHADERS 5 // Number of supported user shaders with placebo
 
 #if defined VAAPI
@@ -426,7 +434,7 @@ static char *DRMConnector = NULL;
 /// Default Value for DRM Refreshrate
 static unsigned int DRMRefresh = 50;
 
-static char Video60HzMode;      ///< handle 60hz displays
+static char VideoRefreshMatch;  ///< match display refresh to video
 static char VideoSoftStartSync; ///< soft start sync audio/video
 // static const int VideoSoftStartFrames = 100; ///< soft start frames
 static char VideoShowBlackPicture; ///< flag show black picture
@@ -541,6 +549,7 @@ EGLContext OSDcontext;
 void VideoThreadLock(void);        ///< lock video thread
 void VideoThreadUnlock(void);      ///< unlock video thread
 static void VideoThreadExit(void); ///< exit/kill video thread
+static void VideoMatchRefresh(int); ///< match display refresh to video
 
 #if defined(USE_SCREENSAVER) && !defined(USE_DRM)
 static void X11SuspendScreenSaver(xcb_connection_t *, int);
@@ -605,45 +614,94 @@ char *eglErrorString(EGLint error) {
 #include "hdr.c"
 #endif
 
+///
+/// Get frame duration from the stream info.
+///
+/// @param video_ctx	ffmpeg video codec context
+/// @param frame    decoded frame
+///
+/// @returns duration in 1/90000s, 0 if unknown.
+///
+static int VideoFrameDuration(const AVCodecContext *video_ctx, const AVFrame *frame) {
+    int64_t frame_duration;
+    int64_t duration;
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 30, 100)
+    frame_duration = frame->duration;
+#else
+    frame_duration = frame->pkt_duration;
+#endif
+    duration = 0;
+    if (frame_duration > 0 && video_ctx->pkt_timebase.num && video_ctx->pkt_timebase.den) {
+        duration = av_rescale_q(frame_duration, video_ctx->pkt_timebase, (AVRational){1, 90000});
+    } else if (video_ctx->framerate.num > 0 && video_ctx->framerate.den > 0) {
+        duration = av_rescale(90000, video_ctx->framerate.den, video_ctx->framerate.num);
+    }
+    // 10 - 200 Hz
+    if (duration < 5 * 90 || duration > 100 * 90) {
+        return 0;
+    }
+    return duration;
+}
+
 ///
 /// Update video pts.
 ///
 /// @param pts_p    pointer to pts
+/// @param duration_p	pointer to frame duration (1/90000s)
+/// @param lastpts_p	pointer to pts of last frame
+/// @param lastdelta_p	pointer to pts step to last frame
 /// @param interlaced	interlaced flag (frame isn't right)
 /// @param frame    frame to display
 ///
 /// @note frame->interlaced_frame can't be used for interlace detection
 ///
-static void VideoSetPts(int64_t *pts_p, int interlaced, const AVCodecContext *video_ctx, const AVFrame *frame) {
+static void VideoSetPts(int64_t *pts_p, int *duration_p, int64_t *lastpts_p, int64_t *lastdelta_p, int interlaced,
+                        const AVCodecContext *video_ctx, const AVFrame *frame) {
     int64_t pts;
     int duration;
-    static int64_t lastpts;
+
+    // av_opt_ptr(avcodec_get_frame_class(), frame, "best_effort_timestamp");
+    // pts = frame->best_effort_timestamp;
+    // pts = frame->pkt_pts;
+    pts = frame->pts;
+    if (pts == (int64_t)AV_NOPTS_VALUE || !pts) {
+        // libav: 0.8pre didn't set pts
+        pts = frame->pkt_dts;
+    }
 
     //
     //	Get duration for this frame.
-    //	FIXME: using framerate as workaround for av_frame_get_pkt_duration
+    //	Two equal pts steps win over the stream info, the deinterlace
+    //	filter doubles the frame rate and keeps the stream info.
     //
+    duration = 0;
+    if (pts && pts != (int64_t)AV_NOPTS_VALUE && *lastpts_p && *lastpts_p != (int64_t)AV_NOPTS_VALUE) {
+        int64_t delta;
 
-    // if (video_ctx->framerate.num && video_ctx->framerate.den) {
-    // duration = 1000 * video_ctx->framerate.den / video_ctx->framerate.num;
-    // } else {
-    duration = interlaced ? 40 : 20; // 50Hz -> 20ms default
-    // }
-    Debug(4, "video: Framerate %d/%d \n", video_ctx->framerate.den, video_ctx->framerate.num);
+        delta = pts - *lastpts_p;
+        if (delta >= 5 * 90 && delta <= 100 * 90 && delta - *lastdelta_p <= 90 && *lastdelta_p - delta <= 90) {
+            duration = delta;
+        }
+        *lastdelta_p = delta;
+    }
+    if (!duration) {
+        duration = *duration_p;
+    }
+    if (!duration && !(duration = VideoFrameDuration(video_ctx, frame))) {
+        duration = interlaced ? 40 * 90 : 20 * 90; // 50Hz -> 20ms default
+    }
+    if (duration != *duration_p) {
+        Debug(4, "video: Framerate %d/%d duration %dus\n", video_ctx->framerate.num, video_ctx->framerate.den,
+              duration * 100 / 9);
+        *duration_p = duration;
+    }
 
     // update video clock
     if (*pts_p != (int64_t)AV_NOPTS_VALUE) {
-        *pts_p += duration * 90;
+        *pts_p += duration;
         // Info("video: %s +pts\n", Timestamp2String(*pts_p));
     }
-    // av_opt_ptr(avcodec_get_frame_class(), frame, "best_effort_timestamp");
-    // pts = frame->best_effort_timestamp;
-    // pts = frame->pkt_pts;
-    pts = frame->pts;
-    if (pts == (int64_t)AV_NOPTS_VALUE || !pts) {
-        // libav: 0.8pre didn't set pts
-        pts = frame->pkt_dts;
-    }
     // libav: sets only pkt_dts which can be 0
     if (pts && pts != (int64_t)AV_NOPTS_VALUE) {
         // build a monotonic pts
@@ -664,12 +722,12 @@ static void VideoSetPts(int64_t *pts_p, int interlaced, const AVCodecContext *vi
             Debug(3, "++++++++++++++++++++++++++++++++++++starte audio\n");
             AudioVideoReady(pts);
         }
-        if (*pts_p != pts && lastpts != pts) {
+        if (*pts_p != pts && *lastpts_p != pts) {
             Debug(4, "video: %#012" PRIx64 "->%#012" PRIx64 " delta=%4" PRId64 " pts\n", *pts_p, pts, pts - *pts_p);
             *pts_p = pts;
         }
     }
-    lastpts = pts;
+    *lastpts_p = pts;
 }
 
 int CuvidMessage(int level, const char *format, ...);
@@ -1319,6 +1377,177 @@ static VideoResolutions VideoResolutionGroup(int width, int height, __attribute_
     return VideoResolution1080i;
 }
 
+//----------------------------------------------------------------------------
+//  A/V sync trace
+//----------------------------------------------------------------------------
+
+#define VIDEO_SYNC_TRACE_SIZE 4096 ///< number of trace entries (power of 2)
+
+static volatile char VideoSyncTraceEnabled; ///< flag record sync trace
+
+/// Sync trace ring, written only by the video display thread.
+static VideoSyncTrace VideoSyncTraceRing[VIDEO_SYNC_TRACE_SIZE];
+static atomic_t VideoSyncTraceWrite; ///< number of written trace entries
+
+///
+/// Add an entry to the sync trace.
+///
+/// @param video_clock	video clock of displayed frame
+/// @param audio_clock	audio clock
+/// @param filled   number of filled decoder surfaces
+/// @param decision sync decision taken for this frame
+/// @param frametime	frame processing time
+///
+static void VideoSyncTraceAdd(int64_t video_clock, int64_t audio_clock, int filled, int decision, float frametime) {
+    VideoSyncTrace *trace;
+    unsigned n;
+
+    n = (unsigned)atomic_read(&VideoSyncTraceWrite);
+    trace = &VideoSyncTraceRing[n & (VIDEO_SYNC_TRACE_SIZE - 1)];
+
+    trace->VideoClock = video_clock;
+    trace->AudioClock = audio_clock;
+    trace->Tick = GetMsTicks();
+    trace->AudioDelay = AudioGetDelay();
+    trace->FrameTime = frametime;
+    trace->Filled = filled;
+    trace->Decision = decision;
+
+    atomic_inc(&VideoSyncTraceWrite); // publish entry
+}
+
+///
+/// Enable or disable the sync trace.
+///
+/// @param onoff	-1 toggle, true turn on, false turn off
+///
+void VideoSetSyncTrace(int onoff) {
+    if (onoff < 0) {
+        VideoSyncTraceEnabled ^= 1;
+    } else {
+        VideoSyncTraceEnabled = onoff;
+    }
+}
+
+///
+/// Get the latest sync trace entries.
+///
+/// Lock-free, entries overwritten by the display thread during the copy
+/// are discarded.
+///
+/// @param[out] trace	buffer for the trace entries, oldest first
+/// @param max	    size of trace buffer in entries
+///
+/// @returns number of entries stored in trace.
+///
+int VideoGetSyncTrace(VideoSyncTrace *trace, int max) {
+    unsigned start;
+    unsigned end;
+    unsigned n;
+    unsigned i;
+
+    if (max > VIDEO_SYNC_TRACE_SIZE) {
+        max = VIDEO_SYNC_TRACE_SIZE;
+    }
+    if (max <= 0) {
+        return 0;
+    }
+    end = (unsigned)atomic_read(&VideoSyncTraceWrite);
+    n = end < (unsigned)max ? end : (unsigned)max;
+    start = end - n;
+
+    for (i = 0; i < n; ++i) {
+        trace[i] = VideoSyncTraceRing[(start + i) & (VIDEO_SYNC_TRACE_SIZE - 1)];
+    }
+
+    // writer may have overwritten the oldest entries meanwhile,
+    // slot of entry end is the one it may be writing just now
+    end = (unsigned)atomic_read(&VideoSyncTraceWrite);
+    if (end - start >= VIDEO_SYNC_TRACE_SIZE) {
+        i = end - start - VIDEO_SYNC_TRACE_SIZE + 1;
+        if (i >= n) {
+            return 0;
+        }
+        memmove(trace, trace + i, (n - i) * sizeof(*trace));
+        n -= i;
+    }
+    return n;
+}
+
+///
+/// Dump the sync trace as binary file.
+///
+/// The file is a plain array of #VideoSyncTrace entries in host byte
+/// order, oldest entry first.
+///
+/// @param filename	name of the dump file
+///
+/// @returns number of entries written, -1 on error.
+///
+int VideoDumpSyncTrace(const char *filename) {
+    VideoSyncTrace *trace;
+    FILE *file;
+    int n;
+
+    if (!(trace = malloc(VIDEO_SYNC_TRACE_SIZE * sizeof(*trace)))) {
+        return -1;
+    }
+    n = VideoGetSyncTrace(trace, VIDEO_SYNC_TRACE_SIZE);
+    if (!(file = fopen(filename, "wb"))) {
+        Error(_("video: can't open sync trace file '%s'\n"), filename);
+        free(trace);
+        return -1;
+    }
+    if (fwrite(trace, sizeof(*trace), n, file) != (size_t)n) {
+        Error(_("video: can't write sync trace file '%s'\n"), filename);
+        n = -1;
+    }
+    if (fclose(file)) {
+        n = -1;
+    }
+    free(trace);
+    return n;
+}
+
+//----------------------------------------------------------------------------
+//  Latency histograms
+//----------------------------------------------------------------------------
+
+static unsigned VideoDecodeLatency[VIDEO_LATENCY_BUCKETS];  ///< fetch + decode
+static unsigned VideoRenderLatency[VIDEO_LATENCY_BUCKETS];  ///< render frame
+static unsigned VideoDisplayLatency[VIDEO_LATENCY_BUCKETS]; ///< display frame
+
+///
+/// Get monotonic time for latency measurement.
+///
+/// @returns time in us.
+///
+static inline uint64_t VideoLatencyTicks(void) {
+    struct timespec tspec;
+
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
+///
+/// Add a latency to a histogram.
+///
+/// Bucket 0 counts latencies below 1ms, bucket n below 2^n ms and the
+/// last bucket all longer latencies.
+///
+/// @param histogram	latency histogram
+/// @param start    start time from VideoLatencyTicks()
+///
+static void VideoLatencyAdd(unsigned *histogram, uint64_t start) {
+    uint64_t us;
+    int i;
+
+    us = VideoLatencyTicks() - start;
+    for (i = 0; i < VIDEO_LATENCY_BUCKETS - 1 && us >= 1000U << i; ++i) {
+    }
+    ++histogram[i];
+}
+
 //----------------------------------------------------------------------------
 //  CUVID
 //----------------------------------------------------------------------------
@@ -1400,6 +1629,16 @@ typedef struct _cuvid_decoder_ {
     int SurfaceRead;         ///< read pointer
     atomic_t SurfacesFilled; ///< how many of the buffer is used
     AVFrame *frames[CODEC_SURFACES_MAX + 1];
+
+    pthread_mutex_t FramePoolMutex;       ///< frame pool lock
+    AVFrame *FramePool[VIDEO_FRAME_POOL]; ///< free frame shells
+    int FramePoolN;                       ///< number of free frame shells
+#if defined(VAAPI) && defined(PLACEBO)
+    AVFrame *TransferFrame;               ///< frame for copy via RAM
+#endif
+    FrameConv *Conv;                      ///< software frame converter
+    AVFrame *SoftFrame;                   ///< converted software frame
+    AVBufferRef *UploadFramesCtx;         ///< hw frames for software upload
 #ifdef CUVID
     CUarray cu_array[CODEC_SURFACES_MAX + 1][2];
     CUgraphicsResource cu_res[CODEC_SURFACES_MAX + 1][2];
@@ -1423,6 +1662,12 @@ typedef struct _cuvid_decoder_ {
     int Closing;               ///< flag about closing current stream
     int SyncOnAudio;           ///< flag sync to audio
     int64_t PTS;               ///< video PTS clock
+    int FrameDuration;         ///< video frame duration (1/90000s)
+    int64_t LastPts;           ///< pts of last decoded frame
+    int64_t LastPtsDelta;      ///< pts step to last decoded frame
+    int FrameCadence;          ///< display time of current frame (1/90000s)
+    int RefreshRate;           ///< frame rate for display refresh (Hz)
+    int RefreshCount;          ///< frames decoded with this rate
 
 #if defined(YADIF) || defined(VAAPI)
     AVFilterContext *buffersink_ctx;
@@ -1445,6 +1690,11 @@ typedef struct _cuvid_decoder_ {
 static CuvidDecoder *CuvidDecoders[2]; ///< open decoder streams
 static int CuvidDecoderN;              ///< number of decoder streams
 
+/// surface wait mutex
+static pthread_mutex_t CuvidSurfaceMutex = PTHREAD_MUTEX_INITIALIZER;
+/// surface available condition
+static pthread_cond_t CuvidSurfaceCond = PTHREAD_COND_INITIALIZER;
+
 #ifdef CUVID
 static CudaFunctions *cu;
 #endif
@@ -1508,6 +1758,7 @@ GLuint OSDtexture, gl_prog_osd = 0;
 int OSDx, OSDy, OSDxsize, OSDysize;
 
 static struct timespec CuvidFrameTime; ///< time of last display
+static int CuvidDisplayPeriod = 20 * 90; ///< measured display refresh period (1/90000s)
 
 int window_width, window_height;
 
@@ -1571,6 +1822,74 @@ static inline void __checkCudaErrors(CUresult err, const char *file, const int l
 }
 #endif
 
+//  Frames ---------------------------------------------------------------
+
+///
+/// Get a frame shell from the frame pool.
+///
+/// @param decoder  CUVID hw decoder
+///
+/// @returns empty frame, NULL if out of memory.
+///
+static AVFrame *CuvidGetFrame(CuvidDecoder *decoder) {
+    AVFrame *frame;
+
+    frame = NULL;
+    pthread_mutex_lock(&decoder->FramePoolMutex);
+    if (decoder->FramePoolN) {
+        frame = decoder->FramePool[--decoder->FramePoolN];
+    }
+    pthread_mutex_unlock(&decoder->FramePoolMutex);
+
+    return frame ? frame : av_frame_alloc();
+}
+
+///
+/// Give a frame back to the frame pool.
+///
+/// The frame data is unreferenced, only the shell is kept.
+///
+/// @param decoder  CUVID hw decoder
+/// @param frame    frame no longer used, set to NULL
+///
+static void CuvidPutFrame(CuvidDecoder *decoder, AVFrame **frame) {
+    if (!*frame) {
+        return;
+    }
+    av_frame_unref(*frame);
+
+    pthread_mutex_lock(&decoder->FramePoolMutex);
+    if (decoder->FramePoolN < VIDEO_FRAME_POOL) {
+        decoder->FramePool[decoder->FramePoolN++] = *frame;
+        *frame = NULL;
+    }
+    pthread_mutex_unlock(&decoder->FramePoolMutex);
+
+    av_frame_free(frame); // pool full
+}
+
+///
+/// Free all frames of the frame pool.
+///
+/// @param decoder  CUVID hw decoder
+///
+static void CuvidFreeFramePool(CuvidDecoder *decoder) {
+    pthread_mutex_lock(&decoder->FramePoolMutex);
+    while (decoder->FramePoolN) {
+        av_frame_free(&decoder->FramePool[--decoder->FramePoolN]);
+    }
+    pthread_mutex_unlock(&decoder->FramePoolMutex);
+#if defined(VAAPI) && defined(PLACEBO)
+    av_frame_free(&decoder->TransferFrame);
+#endif
+    if (decoder->Conv) {
+        FrameConvDel(decoder->Conv);
+        decoder->Conv = NULL;
+    }
+    av_frame_free(&decoder->SoftFrame);
+    av_buffer_unref(&decoder->UploadFramesCtx);
+}
+
 //  Surfaces -------------------------------------------------------------
 void createTextureDst(CuvidDecoder *decoder, int anz, unsigned int size_x, unsigned int size_y,
                       enum AVPixelFormat PixFmt);
@@ -1632,9 +1951,7 @@ static void CuvidDestroySurfaces(CuvidDecoder *decoder) {
 #endif
 
     for (i = 0; i < decoder->SurfacesNeeded; i++) {
-        if (decoder->frames[i]) {
-            av_frame_free(&decoder->frames[i]);
-        }
+        CuvidPutFrame(decoder, &decoder->frames[i]);
         for (j = 0; j < Planes; j++) {
 #ifdef PLACEBO
             if (decoder->pl_frames[i].planes[j].texture) {
@@ -1730,6 +2047,15 @@ static int CuvidGetVideoSurface0(CuvidDecoder *decoder) {
     return surface;
 }
 
+///
+/// Wakeup the decoder waiting in CuvidWaitSurfaces().
+///
+static void CuvidSurfaceSignal(void) {
+    pthread_mutex_lock(&CuvidSurfaceMutex);
+    pthread_cond_broadcast(&CuvidSurfaceCond);
+    pthread_mutex_unlock(&CuvidSurfaceMutex);
+}
+
 ///
 /// Release a surface.
 ///
@@ -1739,9 +2065,7 @@ static int CuvidGetVideoSurface0(CuvidDecoder *decoder) {
 static void CuvidReleaseSurface(CuvidDecoder *decoder, int surface) {
     int i;
 
-    if (decoder->frames[surface]) {
-        av_frame_free(&decoder->frames[surface]);
-    }
+    CuvidPutFrame(decoder, &decoder->frames[surface]);
 #ifdef PLACEBO
     SharedContext;
     if (p->has_dma_buf) {
@@ -1783,6 +2107,7 @@ static void CuvidReleaseSurface(CuvidDecoder *decoder, int surface) {
             // no problem, with last used
             decoder->SurfacesUsed[i] = decoder->SurfacesUsed[--decoder->SurfaceUsedN];
             decoder->SurfacesFree[decoder->SurfaceFreeN++] = surface;
+            CuvidSurfaceSignal();
             return;
         }
     }
@@ -1813,6 +2138,67 @@ int CuvidTestSurfaces() {
         return 0;
 }
 
+///
+/// Wait until the decoder can output a surface.
+///
+/// Woken by CuvidSurfaceSignal(), when the display thread dequeues a
+/// surface, or a surface is released.
+///
+/// @param timeout  maximal time to wait in ms
+///
+/// @returns true, if a surface is available.
+///
+int CuvidWaitSurfaces(int timeout) {
+    struct timespec abstime;
+    int ret;
+
+    if (CuvidTestSurfaces()) {
+        return 1;
+    }
+    clock_gettime(CLOCK_REALTIME, &abstime);
+    abstime.tv_nsec += (timeout % 1000) * 1000 * 1000;
+    abstime.tv_sec += timeout / 1000 + abstime.tv_nsec / (1000 * 1000 * 1000);
+    abstime.tv_nsec %= 1000 * 1000 * 1000;
+
+    pthread_mutex_lock(&CuvidSurfaceMutex);
+    while (!(ret = CuvidTestSurfaces())) {
+        if (pthread_cond_timedwait(&CuvidSurfaceCond, &CuvidSurfaceMutex, &abstime) == ETIMEDOUT) {
+            ret = CuvidTestSurfaces();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&CuvidSurfaceMutex);
+
+    return ret;
+}
+
+///
+/// Wait until the display dequeues a surface of a full decoder.
+///
+/// @param filled   output queue of a decoder is full with this many surfaces
+/// @param timeout  maximal time to wait in ms
+///
+static void CuvidWaitDisplayQueue(int filled, int timeout) {
+    struct timespec abstime;
+    int i;
+
+    clock_gettime(CLOCK_REALTIME, &abstime);
+    abstime.tv_nsec += (timeout % 1000) * 1000 * 1000;
+    abstime.tv_sec += timeout / 1000 + abstime.tv_nsec / (1000 * 1000 * 1000);
+    abstime.tv_nsec %= 1000 * 1000 * 1000;
+
+    pthread_mutex_lock(&CuvidSurfaceMutex);
+    for (i = 0; i < CuvidDecoderN; ++i) {
+        if (atomic_read(&CuvidDecoders[i]->SurfacesFilled) < filled) {
+            break;
+        }
+    }
+    if (i == CuvidDecoderN) { // all still full
+        pthread_cond_timedwait(&CuvidSurfaceCond, &CuvidSurfaceMutex, &abstime);
+    }
+    pthread_mutex_unlock(&CuvidSurfaceMutex);
+}
+
 #ifdef VAAPI
 struct mp_egl_config_attr {
     int attrib;
@@ -2039,6 +2425,7 @@ static CuvidDecoder *CuvidNewHwDecoder(VideoStream *stream) {
         Error(_("video/cuvid: out of memory\n"));
         return NULL;
     }
+    pthread_mutex_init(&decoder->FramePoolMutex, NULL);
 #if defined(VAAPI)
     VaDisplay = TO_VAAPI_DEVICE_CTX(HwDeviceContext)->display;
     decoder->VaDisplay = VaDisplay;
@@ -2096,6 +2483,7 @@ static void CuvidCleanup(CuvidDecoder *decoder) {
     // reset video surface ring buffer
     //
     atomic_set(&decoder->SurfacesFilled, 0);
+    CuvidSurfaceSignal();
 
     for (i = 0; i < VIDEO_SURFACES_MAX; ++i) {
         decoder->SurfacesRb[i] = -1;
@@ -2142,6 +2530,7 @@ static void CuvidDelHwDecoder(CuvidDecoder *decoder) {
         VideoThreadUnlock();
 
     // glXMakeCurrent(XlibDisplay, None, NULL);
+    VideoThreadLock(); // VideoGetPerf reads the decoder list
     for (i = 0; i < CuvidDecoderN; ++i) {
         if (CuvidDecoders[i] == decoder) {
             CuvidDecoders[i] = NULL;
@@ -2149,6 +2538,7 @@ static void CuvidDelHwDecoder(CuvidDecoder *decoder) {
             if (i < --CuvidDecoderN) {
                 CuvidDecoders[i] = CuvidDecoders[CuvidDecoderN];
             }
+            VideoThreadUnlock();
             // CuvidCleanup(decoder);
             CuvidPrintFrames(decoder);
 #ifdef CUVID
@@ -2156,10 +2546,13 @@ static void CuvidDelHwDecoder(CuvidDecoder *decoder) {
                 cu->cuCtxDestroy(decoder->cuda_ctx);
             }
 #endif
+            CuvidFreeFramePool(decoder);
+            pthread_mutex_destroy(&decoder->FramePoolMutex);
             free(decoder);
             return;
         }
     }
+    VideoThreadUnlock();
     Error(_("video/cuvid: decoder not in decoder list.\n"));
 }
 
@@ -2263,10 +2656,7 @@ void createTextureDst(CuvidDecoder *decoder, int anz, unsigned int size_x, unsig
           PixFmt == AV_PIX_FMT_NV12 ? "NV12" : "P010", size_x, size_y);
 
     for (i = 0; i < anz; i++) { // number of texture
-        if (decoder->frames[i]) {
-            av_frame_free(&decoder->frames[i]);
-            decoder->frames[i] = NULL;
-        }
+        CuvidPutFrame(decoder, &decoder->frames[i]);
         for (n = 0; n < 2; n++) { // number of planes
             bool ok = true;
 
@@ -2673,7 +3063,7 @@ static void CuvidSyncRenderFrame(CuvidDecoder *decoder, const AVCodecContext *vi
 int push_filters(AVCodecContext *dec_ctx, CuvidDecoder *decoder, AVFrame *frame) {
 
     int ret;
-    AVFrame *filt_frame = av_frame_alloc();
+    AVFrame *filt_frame = CuvidGetFrame(decoder);
 
     /* push the decoded frame into the filtergraph */
     if (av_buffersrc_add_frame_flags(decoder->buffersrc_ctx, frame, AV_BUFFERSRC_FLAG_KEEP_REF) < 0) {
@@ -2687,10 +3077,10 @@ int push_filters(AVCodecContext *dec_ctx, CuvidDecoder *decoder, AVFrame *frame)
         filt_frame->pts /= 2;
         decoder->Interlaced = 0;
         CuvidSyncRenderFrame(decoder, dec_ctx, filt_frame);
-        filt_frame = av_frame_alloc(); // get new frame
+        filt_frame = CuvidGetFrame(decoder); // get new frame
     }
-    av_frame_free(&filt_frame);
-    av_frame_free(&frame);
+    CuvidPutFrame(decoder, &filt_frame);
+    CuvidPutFrame(decoder, &frame);
     return ret;
 }
 
@@ -2888,6 +3278,46 @@ error:
     return -1;
 }
 #endif
+
+///
+/// Select software pixel format, the frames are uploaded by CuvidUploadFrame.
+///
+/// A decoder opened for the hw is reopened as software decoder by the
+/// codec module.
+///
+/// @param decoder      CUVID hw decoder
+/// @param video_ctx    ffmpeg video codec context
+/// @param fmt          is the list of formats which are supported by
+///                     the codec, it is terminated by -1
+///
+static enum AVPixelFormat CuvidGetSoftFormat(CuvidDecoder *decoder, AVCodecContext *video_ctx,
+                                             const enum AVPixelFormat *fmt) {
+    VideoDecoder *ist = video_ctx->opaque;
+
+    for (; *fmt != AV_PIX_FMT_NONE; fmt++) {
+        if (!(av_pix_fmt_desc_get(*fmt)->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            break;
+        }
+    }
+    if (*fmt == AV_PIX_FMT_NONE) {
+        Fatal(_("video: no valid pixfmt found\n"));
+    }
+    if (!ist->GetFormatDone) {
+        Info(_("video/cuvid: software decoder %s %dx%d\n"), av_get_pix_fmt_name(*fmt), video_ctx->width,
+             video_ctx->height);
+    }
+    if (video_ctx->hw_device_ctx) { // opened for hw, reopen with frame threads
+        ist->SoftwareFallback = 1;
+    }
+    ist->GetFormatDone = 1;
+    ist->filter = 0;
+    ist->active_hwaccel_id = HWACCEL_NONE;
+    ist->hwaccel_pix_fmt = AV_PIX_FMT_NONE;
+    decoder->InputAspect = video_ctx->sample_aspect_ratio;
+
+    return *fmt;
+}
+
 ///
 /// Callback to negotiate the PixelFormat.
 ///
@@ -2912,6 +3342,15 @@ static enum AVPixelFormat Cuvid_get_format(CuvidDecoder *decoder, AVCodecContext
         if (*fmt_idx == AV_PIX_FMT_P010LE)
             bitformat16 = 1;
     }
+
+    // software decoder: forced or no hw profile for this stream
+    if (CodecSoftwareDecoder) {
+        for (fmt_idx = fmt; *fmt_idx != AV_PIX_FMT_NONE && *fmt_idx != PIXEL_FORMAT; fmt_idx++)
+            ;
+        if (!video_ctx->hw_device_ctx || *fmt_idx == AV_PIX_FMT_NONE) {
+            return CuvidGetSoftFormat(decoder, video_ctx, fmt);
+        }
+    }
 #ifdef VAAPI
 #if (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(62, 11, 100))
     if (video_ctx->profile == AV_PROFILE_HEVC_MAIN_10)
@@ -3504,6 +3943,101 @@ extern void cudaLaunchNV12toARGBDrv(uint32_t * d_srcNV12, size_t nSourcePitch, u
     uint32_t width, uint32_t height, CUstream streamID);
 #endif
 
+///
+/// Match the display refresh to a new video frame rate.
+///
+/// The rate must be stable for some frames, before the display is
+/// switched.
+///
+/// @param decoder  CUVID hw decoder
+///
+static void CuvidMatchRefresh(CuvidDecoder *decoder) {
+    int rate;
+
+    rate = (90000 + decoder->FrameDuration / 2) / decoder->FrameDuration;
+    if (rate != decoder->RefreshRate) {
+        decoder->RefreshRate = rate;
+        decoder->RefreshCount = 0;
+        return;
+    }
+    if (++decoder->RefreshCount == VIDEO_REFRESH_FRAMES) {
+        VideoMatchRefresh(decoder->FrameDuration);
+    }
+}
+
+///
+/// Upload software decoded frame into a hw frame.
+///
+/// The frame is converted to NV12/P010 by the frame converter threads
+/// and transfered into a frame of the hw device, which goes the same way
+/// to the output surfaces as the frames of the hw decoder.
+///
+/// @param decoder  CUVID hw decoder
+/// @param frame    software decoded frame, given back to the frame pool
+///
+/// @returns hw frame, NULL if the upload failed.
+///
+static AVFrame *CuvidUploadFrame(CuvidDecoder *decoder, AVFrame *frame) {
+    AVHWFramesContext *frames;
+    AVFrame *hw_frame;
+    AVFrame *soft;
+
+    if (!HwDeviceContext) {
+        CuvidPutFrame(decoder, &frame);
+        return NULL;
+    }
+    if (!decoder->Conv && !(decoder->Conv = FrameConvNew(0))) {
+        Error(_("video/cuvid: can't create frame converter\n"));
+        CuvidPutFrame(decoder, &frame);
+        return NULL;
+    }
+    if (!decoder->SoftFrame && !(decoder->SoftFrame = av_frame_alloc())) {
+        CuvidPutFrame(decoder, &frame);
+        return NULL;
+    }
+    soft = decoder->SoftFrame;
+    if (FrameConvConvert(decoder->Conv, soft, frame) < 0) {
+        Error(_("video/cuvid: can't convert %s frame\n"), av_get_pix_fmt_name(frame->format));
+        CuvidPutFrame(decoder, &frame);
+        return NULL;
+    }
+    // (re)create the hw frames, if the format has changed
+    frames = decoder->UploadFramesCtx ? (AVHWFramesContext *)decoder->UploadFramesCtx->data : NULL;
+    if (!frames || frames->sw_format != soft->format || frames->width != soft->width ||
+        frames->height != soft->height) {
+        av_buffer_unref(&decoder->UploadFramesCtx);
+        if (!(decoder->UploadFramesCtx = av_hwframe_ctx_alloc(HwDeviceContext))) {
+            CuvidPutFrame(decoder, &frame);
+            return NULL;
+        }
+        frames = (AVHWFramesContext *)decoder->UploadFramesCtx->data;
+        frames->format = PIXEL_FORMAT;
+        frames->sw_format = soft->format;
+        frames->width = soft->width;
+        frames->height = soft->height;
+        frames->initial_pool_size = CODEC_SURFACES_MAX + 2;
+        if (av_hwframe_ctx_init(decoder->UploadFramesCtx) < 0) {
+            Error(_("video/cuvid: can't create %s hw frames for upload\n"), av_get_pix_fmt_name(soft->format));
+            av_buffer_unref(&decoder->UploadFramesCtx);
+            CuvidPutFrame(decoder, &frame);
+            return NULL;
+        }
+    }
+
+    hw_frame = CuvidGetFrame(decoder);
+    if (!hw_frame || av_hwframe_get_buffer(decoder->UploadFramesCtx, hw_frame, 0) < 0 ||
+        av_hwframe_transfer_data(hw_frame, soft, 0) < 0) {
+        Debug(3, "video/cuvid: upload of software frame failed\n");
+        CuvidPutFrame(decoder, &hw_frame);
+        CuvidPutFrame(decoder, &frame);
+        return NULL;
+    }
+    av_frame_copy_props(hw_frame, frame);
+    CuvidPutFrame(decoder, &frame);
+
+    return hw_frame;
+}
+
 ///
 /// Render a ffmpeg frame.
 ///
@@ -3516,12 +4050,21 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
     enum AVColorSpace color;
 
     if (decoder->Closing == 1) {
-        av_frame_free(&frame);
+        CuvidPutFrame(decoder, &frame);
         return;
     }
 
     if (!decoder->Closing) {
-        VideoSetPts(&decoder->PTS, decoder->Interlaced, video_ctx, frame);
+        VideoSetPts(&decoder->PTS, &decoder->FrameDuration, &decoder->LastPts, &decoder->LastPtsDelta,
+                    decoder->Interlaced, video_ctx, frame);
+        if (VideoRefreshMatch && decoder == CuvidDecoders[0]) {
+            CuvidMatchRefresh(decoder);
+        }
+    }
+
+    if (frame->format != PIXEL_FORMAT) { // software decoder
+        decoder->PixFmt =
+            FrameConvFormat(frame->format) == AV_PIX_FMT_P010 ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_NV12;
     }
 
     if ((decoder->InputWidth != frame->width) || (decoder->InputHeight != frame->height)) {
@@ -3589,10 +4132,13 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
 
     //    printf("Patched  colorspace %d Primaries %d TRC
     //    %d\n",frame->colorspace,frame->color_primaries,frame->color_trc);
+    if (frame->format != PIXEL_FORMAT && !(frame = CuvidUploadFrame(decoder, frame))) {
+        return;
+    }
     //
     //	Copy data from frame to image
     //
-    if (video_ctx->pix_fmt == PIXEL_FORMAT) {
+    if (frame->format == PIXEL_FORMAT) {
         int w = decoder->InputWidth;
         int h = decoder->InputHeight;
         decoder->ColorSpace = color; // save colorspace
@@ -3603,7 +4149,7 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
 
         if (surface == -1) { // no free surfaces
             Debug(3, "no more surfaces\n");
-            av_frame_free(&frame);
+            CuvidPutFrame(decoder, &frame);
             return;
         }
 
@@ -3615,9 +4161,14 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
 
             VideoThreadLock();
             vaSyncSurface(decoder->VaDisplay, (VASurfaceID)(uintptr_t)frame->data[3]);
-            output = av_frame_alloc();
+            // keep the transfer buffers, while the format is unchanged
+            if (!(output = decoder->TransferFrame)) {
+                output = decoder->TransferFrame = av_frame_alloc();
+            } else if (output->width != frame->width || output->height != frame->height ||
+                       output->format != ((AVHWFramesContext *)frame->hw_frames_ctx->data)->sw_format) {
+                av_frame_unref(output);
+            }
             av_hwframe_transfer_data(output, frame, 0);
-            av_frame_copy_props(output, frame);
             // printf("Save Surface ID %d %p
             // %p\n",surface,decoder->pl_frames[surface].planes[0].texture,decoder->pl_frames[surface].planes[1].texture);
             (void)pl_tex_upload(p->gpu, &(struct pl_tex_transfer_params){
@@ -3648,7 +4199,6 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
                                             .rc.y1 = h / 2,
                                             .rc.z1 = 0,
                                         });
-            av_frame_free(&output);
             VideoThreadUnlock();
         }
 #else
@@ -3668,7 +4218,7 @@ static void CuvidRenderFrame(CuvidDecoder *decoder, const AVCodecContext *video_
 
     //	 Debug(3,"video/cuvid: pixel format %d not supported\n",
     // video_ctx->pix_fmt);
-    av_frame_free(&frame);
+    CuvidPutFrame(decoder, &frame);
     return;
 }
 
@@ -3750,6 +4300,7 @@ static void CuvidAdvanceDecoderFrame(CuvidDecoder *decoder) {
 
         decoder->SurfaceRead = (decoder->SurfaceRead + 1) % VIDEO_SURFACES_MAX;
         atomic_dec(&decoder->SurfacesFilled);
+        CuvidSurfaceSignal();
         decoder->SurfaceField = !decoder->Interlaced;
         return;
     }
@@ -4360,6 +4911,8 @@ void make_osd_overlay(int x, int y, int width, int height) {
 static void CuvidDisplayFrame(void) {
 
     int i;
+    struct timespec last_time;
+    int64_t period;
 
 #if defined PLACEBO || defined PLACEBO_GL || defined CUVID
     static uint64_t round_time = 0;
@@ -4623,7 +5176,14 @@ static void CuvidDisplayFrame(void) {
 #endif
 
     // FIXME: CLOCK_MONOTONIC_RAW
+    last_time = CuvidFrameTime;
     clock_gettime(CLOCK_MONOTONIC, &CuvidFrameTime);
+    // measure display refresh, ignore pauses
+    period = ((CuvidFrameTime.tv_sec - last_time.tv_sec) * 1000000000LL + CuvidFrameTime.tv_nsec - last_time.tv_nsec) *
+             9 / 100000;
+    if (period >= 4 * 90 && period <= 50 * 90) {
+        CuvidDisplayPeriod += (period - CuvidDisplayPeriod) / 16;
+    }
     for (i = 0; i < CuvidDecoderN; ++i) {
         // remember time of last shown surface
         CuvidDecoders[i]->FrameTime = CuvidFrameTime;
@@ -4655,8 +5215,6 @@ void CuvidSetClock(CuvidDecoder *decoder, int64_t pts) { decoder->PTS = pts; }
 ///
 /// @param decoder  CUVID hw decoder
 ///
-/// FIXME: 20 wrong for 60hz dvb streams
-///
 static int64_t CuvidGetClock(const CuvidDecoder *decoder) {
     // pts is the timestamp of the latest decoded frame
     if (decoder->PTS == (int64_t)AV_NOPTS_VALUE) {
@@ -4671,10 +5229,12 @@ static int64_t CuvidGetClock(const CuvidDecoder *decoder) {
            atomic_read(&decoder->SurfacesFilled));
          */
         // 1 field is future, 2 fields are past, + 2 in driver queue
-        return decoder->PTS - 20 * 90 * (2 * atomic_read(&decoder->SurfacesFilled) - decoder->SurfaceField - 2 + 2);
+        return decoder->PTS -
+               decoder->FrameDuration / 2 * (2 * atomic_read(&decoder->SurfacesFilled) - decoder->SurfaceField - 2 + 2);
     }
     // + 2 in driver queue
-    return decoder->PTS - 20 * 90 * (atomic_read(&decoder->SurfacesFilled) + SWAP_BUFFER_SIZE + 1); // +2
+    return decoder->PTS - decoder->FrameDuration * atomic_read(&decoder->SurfacesFilled) -
+           CuvidDisplayPeriod * (SWAP_BUFFER_SIZE + 1); // +2
 }
 
 ///
@@ -4730,12 +5290,42 @@ void CuvidGetStats(CuvidDecoder *decoder, int *missed, int *duped, int *dropped,
     *eotf = 0;
 }
 
+///
+/// Check if the current frame must be shown again.
+///
+/// The display time of the current frame is summed up, it is shown
+/// until its duration is used up. Gives 2:3 pulldown for 24p on 60Hz,
+/// shows every 12th picture of 24p on 50Hz three times and repeats
+/// every 5th picture of 50p on 60Hz.
+///
+/// @param decoder  CUVID hw decoder
+///
+static int CuvidRepeatFrame(CuvidDecoder *decoder) {
+    int duration;
+
+    duration = decoder->FrameDuration;
+    if (decoder->Interlaced) { // one field each refresh
+        duration /= 2;
+    }
+    // display isn't faster than video
+    if (duration * 10 < CuvidDisplayPeriod * 11) {
+        decoder->FrameCadence = 0;
+        return 0;
+    }
+    decoder->FrameCadence += CuvidDisplayPeriod;
+    if (decoder->FrameCadence < duration) {
+        return 1;
+    }
+    decoder->FrameCadence -= duration;
+    return 0;
+}
+
 ///
 /// Sync decoder output to audio.
 ///
 /// trick-speed show frame <n> times
 /// still-picture   show frame until new frame arrives
-/// 60hz-mode	repeat every 5th picture
+/// cadence	repeat frames, if the display is faster than the video
 /// video>audio slow down video by duplicating frames
 /// video<audio speed up video by skipping frames
 /// soft-start	show every second frame
@@ -4747,6 +5337,7 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
     int filled;
     int64_t audio_clock;
     int64_t video_clock;
+    int decision;
     static int speedup = 3;
 
 #ifdef GAMMA
@@ -4756,33 +5347,38 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
     video_clock = CuvidGetClock(decoder);
 
     filled = atomic_read(&decoder->SurfacesFilled);
+    decision = VIDEO_SYNC_NOSYNC;
 
     if (!decoder->SyncOnAudio) {
         audio_clock = AV_NOPTS_VALUE;
-        // FIXME: 60Hz Mode
+        if (!decoder->TrickSpeed && CuvidRepeatFrame(decoder)) {
+            decision = VIDEO_SYNC_HOLD;
+            goto out;
+        }
         goto skip_sync;
     }
     audio_clock = AudioGetClock();
     //     printf("Diff %d %#012" PRIx64 "	%#012" PRIx64"	 filled %d
     //     \n",(video_clock - audio_clock -
     //     VideoAudioDelay)/90,video_clock,audio_clock,filled);
-    // 60Hz: repeat every 5th field
-    if (Video60HzMode && !(decoder->FramesDisplayed % 6)) {
+    // display faster than video: show frame again
+    if (!decoder->TrickSpeed && CuvidRepeatFrame(decoder)) {
         if (audio_clock == (int64_t)AV_NOPTS_VALUE || video_clock == (int64_t)AV_NOPTS_VALUE) {
+            decision = VIDEO_SYNC_HOLD;
             goto out;
         }
         // both clocks are known
         if (audio_clock + VideoAudioDelay <= video_clock + 25 * 90) {
+            decision = VIDEO_SYNC_HOLD;
             goto out;
         }
         // out of sync: audio before video
-        if (!decoder->TrickSpeed) {
-            goto skip_sync;
-        }
+        goto skip_sync;
     }
     // TrickSpeed
     if (decoder->TrickSpeed) {
         if (decoder->TrickCounter--) {
+            decision = VIDEO_SYNC_HOLD;
             goto out;
         }
         decoder->TrickCounter = decoder->TrickSpeed;
@@ -4807,6 +5403,7 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
         diff = video_clock - audio_clock - VideoAudioDelay;
         //	  diff = (decoder->LastAVDiff + diff) / 2;
         decoder->LastAVDiff = diff;
+        decision = VIDEO_SYNC_SHOW;
 
 #if 0
 	if (abs(diff / 90) > 0) {
@@ -4815,6 +5412,7 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
 #endif
         if (abs(diff) > 5000 * 90) { // more than 5s
             CuvidMessage(2, "video: audio/video difference too big %d\n", diff / 90);
+            decision = VIDEO_SYNC_NOSYNC;
             // decoder->SyncCounter = 1;
             // usleep(10);
             goto skip_sync;
@@ -4823,6 +5421,7 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
 
             CuvidMessage(4, "video: slow down video, duping frame %d\n", diff / 90);
             ++decoder->FramesDuped;
+            decision = VIDEO_SYNC_DUP;
             if ((speedup && --speedup) || VideoSoftStartSync)
                 decoder->SyncCounter = 1;
             else
@@ -4832,16 +5431,19 @@ static void CuvidSyncDecoder(CuvidDecoder *decoder) {
         } else if (diff > 25 * 90) {
             CuvidMessage(3, "video: slow down video, duping frame %d \n", diff / 90);
             ++decoder->FramesDuped;
+            decision = VIDEO_SYNC_DUP;
             decoder->SyncCounter = 1;
             goto out;
         } else if ((diff < -100 * 90)) {
             if (filled > 2) {
                 CuvidMessage(3, "video: speed up video, droping frame %d\n", diff / 90);
                 ++decoder->FramesDropped;
+                decision = VIDEO_SYNC_DROP;
                 CuvidAdvanceDecoderFrame(decoder);
             } else if ((diff < -100 * 90)) { // give it some time to get frames to drop
                 Debug(3, "Delay Audio %d ms\n", abs(diff / 90));
                 AudioDelayms(abs(diff / 90));
+                decision = VIDEO_SYNC_DELAY;
             }
             decoder->SyncCounter = 1;
         } else {
@@ -4864,6 +5466,7 @@ skip_sync:
     if (decoder->SurfaceField && filled <= 1 + 2 * decoder->Interlaced) {
         if (filled < 1 + 2 * decoder->Interlaced) {
             ++decoder->FramesDuped;
+            decision = VIDEO_SYNC_UNDERRUN;
 #if 0
 	    // FIXME: don't warn after stream start, don't warn during pause
 	    err =
@@ -4882,6 +5485,9 @@ skip_sync:
 
     CuvidAdvanceDecoderFrame(decoder);
 out:
+    if (VideoSyncTraceEnabled) {
+        VideoSyncTraceAdd(video_clock, audio_clock, filled, decision, decoder->Frameproc);
+    }
 #if 0
     // defined(DEBUG) || defined(AV_INFO)
     // debug audio/video sync
@@ -4920,8 +5526,11 @@ static void CuvidSyncFrame(void) {
 /// Sync and display surface.
 ///
 static void CuvidSyncDisplayFrame(void) {
+    uint64_t start;
 
+    start = VideoLatencyTicks();
     CuvidDisplayFrame();
+    VideoLatencyAdd(VideoDisplayLatency, start);
     CuvidSyncFrame();
 }
 
@@ -4953,7 +5562,8 @@ static void CuvidSyncRenderFrame(CuvidDecoder *decoder, const AVCodecContext *vi
     }
 
     //	if (!decoder->Closing) {
-    // VideoSetPts(&decoder->PTS, decoder->Interlaced, video_ctx, frame);
+    // VideoSetPts(&decoder->PTS, &decoder->FrameDuration, &decoder->LastPts, &decoder->LastPtsDelta,
+    //             decoder->Interlaced, video_ctx, frame);
     // }
     CuvidRenderFrame(decoder, video_ctx, frame);
 }
@@ -5000,25 +5610,33 @@ static void CuvidDisplayHandlerThread(void) {
     int allfull;
     int decoded;
     int filled;
+    int n;
     struct timespec nowtime;
     CuvidDecoder *decoder;
+    VideoStream *streams[2];
 
     allfull = 1;
     decoded = 0;
 
-    for (i = 0; i < CuvidDecoderN; ++i) {
+    for (n = i = 0; i < CuvidDecoderN; ++i) {
 
         decoder = CuvidDecoders[i];
+        streams[n++] = decoder->Stream;
         //
         // fill frame output ring buffer
         //
         filled = atomic_read(&decoder->SurfacesFilled);
         // if (filled <= 1 +  2 * decoder->Interlaced) {
         if (filled < 5) {
-            // FIXME: hot polling
             // fetch+decode or reopen
+            uint64_t start;
+
             allfull = 0;
+            start = VideoLatencyTicks();
             err = VideoDecodeInput(decoder->Stream, decoder->TrickSpeed);
+            if (!err) {
+                VideoLatencyAdd(VideoDecodeLatency, start);
+            }
         } else {
             err = VideoPollInput(decoder->Stream);
         }
@@ -5032,17 +5650,20 @@ static void CuvidDisplayHandlerThread(void) {
                     decoder->Closing = -1;
                 }
             }
-            usleep(10 * 1000);
             continue;
         }
         decoded = 1;
     }
 
     if (!decoded) { // nothing decoded, sleep
-        // FIXME: sleep on wakeup
-        usleep(1 * 1000);
+        if (allfull) {
+            // wait until the display queue isn't full
+            CuvidWaitDisplayQueue(5, 10);
+        } else {
+            // sleep until a new packet or command arrives
+            VideoWaitInput(streams, n, 10);
+        }
     }
-    usleep(1000);
     // all decoder buffers are full
     // and display is not preempted
     // speed up filling display queue, wait on display queue empty
@@ -6129,6 +6750,8 @@ enum AVPixelFormat Video_get_format(VideoHwDecoder *hw_decoder, AVCodecContext *
 /// @param frame    frame to display
 ///
 void VideoRenderFrame(VideoHwDecoder *hw_decoder, const AVCodecContext *video_ctx, const AVFrame *frame) {
+    uint64_t start;
+
 #if 0
     fprintf(stderr, "video: render frame pts %s closing %d\n", Timestamp2String(frame->pkt_pts),
 	hw_decoder->Cuvid.Closing);
@@ -6136,7 +6759,37 @@ void VideoRenderFrame(VideoHwDecoder *hw_decoder, const AVCodecContext *video_ct
     if (frame->repeat_pict && !VideoIgnoreRepeatPict) {
         Warning(_("video: repeated pict %d found, but not handled\n"), frame->repeat_pict);
     }
+    start = VideoLatencyTicks();
     VideoUsedModule->RenderFrame(hw_decoder, video_ctx, frame);
+    VideoLatencyAdd(VideoRenderLatency, start);
+}
+
+///
+/// Get an empty frame for decoding.
+///
+/// The frame shells are recycled through the decoder frame pool.
+///
+/// @param hw_decoder	video hardware decoder
+///
+AVFrame *VideoGetFrame(VideoHwDecoder *hw_decoder) {
+    if (VideoUsedModule == &CuvidModule) {
+        return CuvidGetFrame(&hw_decoder->Cuvid);
+    }
+    return av_frame_alloc();
+}
+
+///
+/// Give back a frame, which isn't rendered.
+///
+/// @param hw_decoder	video hardware decoder
+/// @param frame    frame from VideoGetFrame()
+///
+void VideoPutFrame(VideoHwDecoder *hw_decoder, AVFrame *frame) {
+    if (VideoUsedModule == &CuvidModule) {
+        CuvidPutFrame(&hw_decoder->Cuvid, &frame);
+        return;
+    }
+    av_frame_free(&frame);
 }
 
 ///
@@ -6368,6 +7021,30 @@ void VideoGetStats(VideoHwDecoder *hw_decoder, int *missed, int *duped, int *dro
     VideoUsedModule->GetStats(hw_decoder, missed, duped, dropped, counter, frametime, width, height, color, eotf);
 }
 
+///
+/// Get video performance counters.
+///
+/// @param[out] perf	video performance counters
+///
+void VideoGetPerf(VideoPerf *perf) {
+    memset(perf, 0, sizeof(*perf));
+    // decoders are created and destroyed by the decoder thread
+    VideoThreadLock();
+    if (VideoUsedModule == &CuvidModule && CuvidDecoderN && CuvidDecoders[0]) {
+        perf->SurfacesFilled = atomic_read(&CuvidDecoders[0]->SurfacesFilled);
+    }
+    VideoThreadUnlock();
+    memcpy(perf->DecodeLatency, VideoDecodeLatency, sizeof(perf->DecodeLatency));
+    memcpy(perf->RenderLatency, VideoRenderLatency, sizeof(perf->RenderLatency));
+    memcpy(perf->DisplayLatency, VideoDisplayLatency, sizeof(perf->DisplayLatency));
+#ifdef USE_VIDEO_THREAD
+    perf->DecodeCpu = GetThreadCpuMs(VideoThread);
+#else
+    perf->DecodeCpu = -1;
+#endif
+    perf->DisplayCpu = GetThreadCpuMs(VideoDisplayThread);
+}
+
 ///
 /// Get decoder video stream size.
 ///
@@ -6509,6 +7186,246 @@ static void X11DPMSReenable(xcb_connection_t *connection) {
 
 #endif
 
+#if defined(USE_XRANDR) && !defined(USE_DRM)
+
+//----------------------------------------------------------------------------
+//  RandR
+//----------------------------------------------------------------------------
+
+static xcb_randr_crtc_t X11RandrCrtc;      ///< crtc with changed refresh
+static xcb_randr_mode_t X11RandrSavedMode; ///< crtc mode before change
+
+///
+/// Refresh rate of a RandR mode in mHz.
+///
+static unsigned X11RandrModeRate(const xcb_randr_mode_info_t *mode) {
+    if (!mode->htotal || !mode->vtotal) {
+        return 0;
+    }
+    return (uint64_t)mode->dot_clock * 1000 / ((uint32_t)mode->htotal * mode->vtotal);
+}
+
+///
+/// Set new mode of a crtc, keep position, rotation and outputs.
+///
+/// @param connection	X11 connection
+/// @param crtc	    crtc to change
+/// @param config_timestamp	timestamp of the screen resources
+/// @param mode	    new mode
+///
+/// @returns true if the mode is set.
+///
+static int X11RandrSetMode(xcb_connection_t *connection, xcb_randr_crtc_t crtc, xcb_timestamp_t config_timestamp,
+                           xcb_randr_mode_t mode) {
+    xcb_randr_get_crtc_info_reply_t *info;
+    xcb_randr_set_crtc_config_reply_t *reply;
+    int ok;
+
+    info = xcb_randr_get_crtc_info_reply(connection, xcb_randr_get_crtc_info(connection, crtc, config_timestamp), NULL);
+    if (!info) {
+        return 0;
+    }
+    reply = xcb_randr_set_crtc_config_reply(
+        connection,
+        xcb_randr_set_crtc_config(connection, crtc, XCB_CURRENT_TIME, config_timestamp, info->x, info->y, mode,
+                                  info->rotation, info->num_outputs, xcb_randr_get_crtc_info_outputs(info)),
+        NULL);
+    ok = reply && reply->status == XCB_RANDR_SET_CONFIG_SUCCESS;
+    free(reply);
+    free(info);
+
+    return ok;
+}
+
+///
+/// Switch the display refresh rate, keep the resolution.
+///
+/// Changes the crtc, which shows the middle of the video window.
+///
+/// @param connection	X11 connection
+/// @param rate	    wanted refresh rate in mHz
+///
+/// @returns true if a mode within 0.5% of rate is set.
+///
+static int X11SetRefresh(xcb_connection_t *connection, unsigned rate) {
+    const xcb_query_extension_reply_t *query_extension_reply;
+    xcb_randr_get_screen_resources_current_reply_t *resources;
+    xcb_randr_get_crtc_info_reply_t *crtc_info;
+    xcb_randr_get_output_info_reply_t *output_info;
+    const xcb_randr_mode_info_t *modes;
+    const xcb_randr_crtc_t *crtcs;
+    const xcb_randr_mode_t *output_modes;
+    const xcb_randr_mode_info_t *current;
+    xcb_randr_crtc_t crtc;
+    xcb_randr_mode_t best;
+    unsigned best_diff;
+    int x;
+    int y;
+    int i;
+    int j;
+    int n;
+    int ok;
+
+    query_extension_reply = xcb_get_extension_data(connection, &xcb_randr_id);
+    if (!query_extension_reply || !query_extension_reply->present) {
+        return 0;
+    }
+    resources = xcb_randr_get_screen_resources_current_reply(
+        connection, xcb_randr_get_screen_resources_current(connection, VideoScreen->root), NULL);
+    if (!resources) {
+        return 0;
+    }
+    modes = xcb_randr_get_screen_resources_current_modes(resources);
+    n = xcb_randr_get_screen_resources_current_modes_length(resources);
+    crtcs = xcb_randr_get_screen_resources_current_crtcs(resources);
+
+    // find crtc of the video window
+    x = VideoWindowX + VideoWindowWidth / 2;
+    y = VideoWindowY + VideoWindowHeight / 2;
+    crtc = 0;
+    crtc_info = NULL;
+    for (i = 0; i < xcb_randr_get_screen_resources_current_crtcs_length(resources); ++i) {
+        xcb_randr_get_crtc_info_reply_t *info;
+
+        info = xcb_randr_get_crtc_info_reply(
+            connection, xcb_randr_get_crtc_info(connection, crtcs[i], resources->config_timestamp), NULL);
+        if (info && info->mode && info->num_outputs && x >= info->x && x < info->x + info->width && y >= info->y &&
+            y < info->y + info->height) {
+            crtc = crtcs[i];
+            crtc_info = info;
+            break;
+        }
+        free(info);
+    }
+    if (!crtc_info) {
+        free(resources);
+        return 0;
+    }
+    output_info = xcb_randr_get_output_info_reply(
+        connection,
+        xcb_randr_get_output_info(connection, xcb_randr_get_crtc_info_outputs(crtc_info)[0],
+                                  resources->config_timestamp),
+        NULL);
+    if (!output_info) {
+        free(crtc_info);
+        free(resources);
+        return 0;
+    }
+
+    current = NULL;
+    for (j = 0; j < n; ++j) {
+        if (modes[j].id == crtc_info->mode) {
+            current = &modes[j];
+            break;
+        }
+    }
+
+    // same size, closest rate, supported by the output
+    best = 0;
+    best_diff = rate / 200;
+    output_modes = xcb_randr_get_output_info_modes(output_info);
+    for (i = 0; current && i < xcb_randr_get_output_info_modes_length(output_info); ++i) {
+        for (j = 0; j < n; ++j) {
+            unsigned diff;
+
+            if (modes[j].id != output_modes[i]) {
+                continue;
+            }
+            if (modes[j].width != current->width || modes[j].height != current->height ||
+                (modes[j].mode_flags & (XCB_RANDR_MODE_FLAG_INTERLACE | XCB_RANDR_MODE_FLAG_DOUBLE_SCAN))) {
+                break;
+            }
+            diff = abs((int)(X11RandrModeRate(&modes[j]) - rate));
+            if (diff <= best_diff) {
+                best = modes[j].id;
+                best_diff = diff;
+            }
+            break;
+        }
+    }
+
+    ok = 0;
+    if (best == crtc_info->mode) {
+        ok = 1;
+    } else if (best) {
+        Debug(3, "video/x11: refresh %u.%03u Hz, mode %#x\n", rate / 1000, rate % 1000, best);
+        if ((ok = X11RandrSetMode(connection, crtc, resources->config_timestamp, best)) && !X11RandrCrtc) {
+            X11RandrCrtc = crtc;
+            X11RandrSavedMode = crtc_info->mode;
+        }
+    }
+
+    free(output_info);
+    free(crtc_info);
+    free(resources);
+
+    return ok;
+}
+
+///
+/// Restore the display refresh changed by X11SetRefresh().
+///
+/// @param connection	X11 connection
+///
+static void X11RestoreRefresh(xcb_connection_t *connection) {
+    xcb_randr_get_screen_resources_current_reply_t *resources;
+
+    if (!X11RandrCrtc) {
+        return;
+    }
+    resources = xcb_randr_get_screen_resources_current_reply(
+        connection, xcb_randr_get_screen_resources_current(connection, VideoScreen->root), NULL);
+    if (resources) {
+        X11RandrSetMode(connection, X11RandrCrtc, resources->config_timestamp, X11RandrSavedMode);
+        free(resources);
+    }
+    X11RandrCrtc = 0;
+}
+
+#else
+
+/// dummy function: Switch X11 display refresh.
+#define X11SetRefresh(connection, rate) 0
+/// dummy function: Restore X11 display refresh.
+#define X11RestoreRefresh(connection)
+
+#endif
+
+//----------------------------------------------------------------------------
+//  Display refresh
+//----------------------------------------------------------------------------
+
+///
+/// Match display refresh to the video frame rate.
+///
+/// Uses the lowest integer multiple of the frame rate, which the
+/// display supports (24p -> 24Hz or 48Hz, 25i -> 50Hz, 30p -> 30Hz or
+/// 60Hz).
+///
+/// @param duration frame duration in 1/90000s
+///
+static void VideoMatchRefresh(int duration) {
+    unsigned rate;
+    unsigned n;
+
+    rate = 90000000U / duration; // mHz
+    for (n = 1; n <= 5; ++n) {
+        if (rate * n < 23000 || rate * n > 121000) {
+            continue;
+        }
+#ifdef USE_DRM
+        if (drm_set_refresh(rate * n)) {
+#else
+        if (X11SetRefresh(Connection, rate * n)) {
+#endif
+            Info(_("video: display refresh %u.%03u Hz for %u.%03u fps\n"), rate * n / 1000, rate * n % 1000,
+                 rate / 1000, rate % 1000);
+            return;
+        }
+    }
+    Debug(3, "video: no display refresh for %u.%03u fps\n", rate / 1000, rate % 1000);
+}
+
 //----------------------------------------------------------------------------
 //  Setup
 //----------------------------------------------------------------------------
@@ -6668,13 +7585,13 @@ int VideoSetGeometry(const char *geometry) {
 }
 
 ///
-/// Set 60hz display mode.
+/// Set display refresh match mode.
 ///
-/// Pull up 50 Hz video for 60 Hz display.
+/// Switch the display refresh to a multiple of the video frame rate.
 ///
-/// @param onoff    enable / disable the 60 Hz mode.
+/// @param onoff    enable / disable the refresh match.
 ///
-void VideoSet60HzMode(int onoff) { Video60HzMode = onoff; }
+void VideoSetRefreshMatch(int onoff) { VideoRefreshMatch = onoff; }
 
 ///
 /// Set soft start audio/video sync.
@@ -7308,6 +8225,7 @@ void VideoExit(void) {
     //
     X11DPMSReenable(Connection);
     X11SuspendScreenSaver(Connection, 0);
+    X11RestoreRefresh(Connection);
 #endif
     VideoUsedModule->Exit();
     VideoUsedModule = &NoopModule;
@@ -36,6 +36,46 @@ typedef struct _video_hw_decoder_ VideoHwDecoder;
 /// Video output stream typedef
 typedef struct __video_stream__ VideoStream;
 
+///
+/// Video sync decision of a displayed frame.
+///
+enum VideoSyncDecision {
+    VIDEO_SYNC_SHOW,     ///< frame shown, a/v in sync
+    VIDEO_SYNC_NOSYNC,   ///< frame shown, no a/v sync done
+    VIDEO_SYNC_HOLD,     ///< frame held (trick-speed, 60Hz mode)
+    VIDEO_SYNC_DUP,      ///< frame duped to slow down video
+    VIDEO_SYNC_DROP,     ///< frame dropped to speed up video
+    VIDEO_SYNC_DELAY,    ///< audio delayed, too few frames to drop
+    VIDEO_SYNC_UNDERRUN, ///< frame duped, decoder buffer empty
+};
+
+///
+/// Video a/v sync trace entry, one per displayed frame.
+///
+typedef struct _video_sync_trace_ {
+    int64_t VideoClock; ///< video clock (90kHz pts)
+    int64_t AudioClock; ///< audio clock (90kHz pts)
+    uint32_t Tick;      ///< display time in ms
+    int32_t AudioDelay; ///< audio output delay (90kHz)
+    float FrameTime;    ///< frame processing time
+    int16_t Filled;     ///< filled decoder surfaces
+    int16_t Decision;   ///< sync decision (enum VideoSyncDecision)
+} VideoSyncTrace;
+
+#define VIDEO_LATENCY_BUCKETS 8 ///< latency buckets <1ms, <2ms, ... >=64ms
+
+///
+/// Video performance counters.
+///
+typedef struct _video_perf_ {
+    int SurfacesFilled;                             ///< queued output surfaces
+    unsigned DecodeLatency[VIDEO_LATENCY_BUCKETS];  ///< fetch + decode latency
+    unsigned RenderLatency[VIDEO_LATENCY_BUCKETS];  ///< render latency
+    unsigned DisplayLatency[VIDEO_LATENCY_BUCKETS]; ///< display latency
+    int64_t DecodeCpu;                              ///< decoder thread cpu ms
+    int64_t DisplayCpu;                             ///< display thread cpu ms
+} VideoPerf;
+
 //----------------------------------------------------------------------------
 //  Variables
 //----------------------------------------------------------------------------
@@ -65,6 +105,12 @@ extern void VideoReleaseSurface(VideoHwDecoder *, unsigned);
 /// Callback to negotiate the PixelFormat.
 extern enum AVPixelFormat Video_get_format(VideoHwDecoder *, AVCodecContext *, const enum AVPixelFormat *);
 
+/// Get an empty frame for decoding.
+extern AVFrame *VideoGetFrame(VideoHwDecoder *);
+
+/// Give back a not rendered frame.
+extern void VideoPutFrame(VideoHwDecoder *, AVFrame *);
+
 /// Render a ffmpeg frame.
 extern void VideoRenderFrame(VideoHwDecoder *, const AVCodecContext *, const AVFrame *);
 
@@ -96,8 +142,8 @@ extern const char *VideoGetDriverName(void);
 /// Set video geometry.
 extern int VideoSetGeometry(const char *);
 
-/// Set 60Hz display mode.
-extern void VideoSet60HzMode(int);
+/// Set display refresh match mode.
+extern void VideoSetRefreshMatch(int);
 
 /// Set soft start audio/video sync.
 extern void VideoSetSoftStartSync(int);
@@ -225,6 +271,18 @@ extern void VideoGetStats(VideoHwDecoder *, int *, int *, int *, int *, float *,
 /// Get video stream size
 extern void VideoGetVideoSize(VideoHwDecoder *, int *, int *, int *, int *);
 
+/// Get video performance counters.
+extern void VideoGetPerf(VideoPerf *);
+
+/// Enable/disable a/v sync trace.
+extern void VideoSetSyncTrace(int);
+
+/// Get latest a/v sync trace entries.
+extern int VideoGetSyncTrace(VideoSyncTrace *, int);
+
+/// Dump a/v sync trace to binary file.
+extern int VideoDumpSyncTrace(const char *);
+
 extern void VideoOsdInit(void); ///< Setup osd.
 extern void VideoOsdExit(void); ///< Cleanup osd.
 
@@ -234,6 +292,9 @@ extern void VideoExit(void);         ///< Cleanup and exit video module.
 /// Poll video input buffers.
 extern int VideoPollInput(VideoStream *);
 
+/// Wait for new video input.
+extern int VideoWaitInput(VideoStream *const *, int, int);
+
 /// Decode video input buffers.
 extern int VideoDecodeInput(VideoStream *, int);
 